@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <utility>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/** This is a whole file mapped read only into memory, so that it is paged in as it is read instead of being copied into a buffer first.*/
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    /** This constructor maps a file, leaving the mapping empty if it cannot be opened.
+     * @param path This is the file to map.*/
+    explicit MappedFile(const std::filesystem::path &path) {
+        open(path);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile &&other) noexcept {
+        *this = std::move(other);
+    }
+
+    MappedFile &operator=(MappedFile &&other) noexcept {
+        if (this != &other) {
+            close();
+            std::swap(bytes, other.bytes);
+            std::swap(length, other.length);
+        }
+        return *this;
+    }
+
+    ~MappedFile() {
+        close();
+    }
+
+    /** This method maps a file in place of whatever was mapped before.
+     * @param path This is the file to map.
+     * @return Whether the file was mapped. Empty files are never mapped.*/
+    bool open(const std::filesystem::path &path) {
+        close();
+#if defined(_WIN32)
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) { return false; }
+        LARGE_INTEGER fileSize{};
+        if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+            HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping != nullptr) {
+                bytes = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                if (bytes != nullptr) { length = static_cast<size_t>(fileSize.QuadPart); }
+                CloseHandle(mapping);
+            }
+        }
+        CloseHandle(file);
+#else
+        int file = ::open(path.c_str(), O_RDONLY);
+        if (file < 0) { return false; }
+        struct stat status{};
+        if (fstat(file, &status) == 0 && status.st_size > 0) {
+            void *view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+            if (view != MAP_FAILED) {
+                bytes = static_cast<const uint8_t *>(view);
+                length = static_cast<size_t>(status.st_size);
+            }
+        }
+        ::close(file);
+#endif
+        return bytes != nullptr;
+    }
+
+    /** This method unmaps the file, if one is mapped.*/
+    void close() {
+        if (bytes == nullptr) { return; }
+#if defined(_WIN32)
+        UnmapViewOfFile(bytes);
+#else
+        munmap(const_cast<uint8_t *>(bytes), length);
+#endif
+        bytes = nullptr;
+        length = 0;
+    }
+
+    [[nodiscard]] const uint8_t *data() const {
+        return bytes;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return length;
+    }
+
+private:
+    const uint8_t *bytes{};
+    size_t length{};
+};
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** This is a work stealing thread pool.
+ * Each worker owns a queue that it pushes to and pops from the back of, and steals from the front of the other workers' queues when its own is empty. Tasks queued from outside the pool are spread over the queues in turn.*/
+class ThreadPool {
+public:
+    /** This method starts the workers.
+     * @param threadCount This is the number of worker threads. Threads that wait on the pool also run its tasks, so zero is valid and runs everything on the waiting thread.*/
+    explicit ThreadPool(unsigned threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1) {
+        queues.reserve(threadCount);
+        for (unsigned i = 0; i < threadCount; ++i) { queues.push_back(std::make_unique<Queue>()); }
+        workers.reserve(threadCount);
+        for (unsigned i = 0; i < threadCount; ++i) { workers.emplace_back([this, i] { workerLoop(i); }); }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /** This method finishes every queued task then joins the workers.*/
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &worker : workers) { worker.join(); }
+    }
+
+    /** This method returns the number of threads that run tasks while a parallelFor is waiting, including the waiting thread.*/
+    [[nodiscard]] unsigned concurrency() const {
+        return (unsigned)workers.size() + 1;
+    }
+
+    /** This method queues a task.
+     * @param task This is the function to run.
+     * @return A future that holds the task's result.*/
+    template<typename Task> auto submit(Task task) -> std::future<decltype(task())> {
+        auto packaged = std::make_shared<std::packaged_task<decltype(task())()>>(std::move(task));
+        std::future<decltype(task())> result = packaged->get_future();
+        push([packaged] { (*packaged)(); });
+        return result;
+    }
+
+    /** This method runs body over [0, count) in chunks of at most grain, and returns once every chunk is done.
+     * The calling thread runs chunks too, so this may be called from inside a task.
+     * @param count This is the number of items.
+     * @param grain This is the most items to give a single task.
+     * @param body This is called with the first and one past the last item of each chunk. If it throws, the chunks not yet started are skipped, and the first exception is rethrown once every chunk has finished.*/
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &body) {
+        if (count == 0) { return; }
+        grain = std::max<size_t>(grain, 1);
+        size_t chunks = (count + grain - 1) / grain;
+        if (chunks == 1 || workers.empty()) {
+            body(0, count);
+            return;
+        }
+        std::atomic<size_t> remaining{chunks};
+        std::atomic<bool> failed{};
+        std::exception_ptr error{};
+        std::mutex errorMutex{};
+        for (size_t chunk = 0; chunk < chunks; ++chunk) {
+            size_t begin = chunk * grain, end = std::min(count, begin + grain);
+            push([&body, &remaining, &failed, &error, &errorMutex, begin, end] {
+                try {
+                    if (!failed.load(std::memory_order_relaxed)) { body(begin, end); }
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error) { error = std::current_exception(); }
+                    failed.store(true, std::memory_order_relaxed);
+                }
+                remaining.fetch_sub(1, std::memory_order_release);
+            });
+        }
+        //every chunk refers to this frame, so it must not be left until they have all finished
+        while (remaining.load(std::memory_order_acquire) != 0) {
+            if (!runOne(ownQueue())) { std::this_thread::yield(); }
+        }
+        if (error) { std::rethrow_exception(error); }
+    }
+
+    /** This method waits for a future, running queued tasks on the calling thread meanwhile, so that a thread waiting on the pool helps it along as parallelFor does.
+     * @param future This is the future to wait for. It is not consumed, so its result can still be taken.*/
+    template<typename Future> void wait(const Future &future) {
+        while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            if (queues.empty() || !runOne(ownQueue())) { future.wait_for(std::chrono::microseconds(100)); }
+        }
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues{};
+    std::vector<std::thread> workers{};
+    std::atomic<size_t> nextQueue{};
+    std::atomic<size_t> queued{};
+    std::mutex sleepMutex{};
+    std::condition_variable wake{};
+    bool stopping{};
+    /** These are the pool and queue of the worker running on this thread, if it is one.*/
+    static inline thread_local const ThreadPool *workerPool{};
+    static inline thread_local size_t workerQueue{};
+
+    /** This method finds the queue the calling thread should push to and pop from first: its own if it is one of this pool's workers, so that nested tasks stay with the worker that queued them, and the next one in turn otherwise.*/
+    size_t ownQueue() {
+        return workerPool == this ? workerQueue : nextQueue++ % queues.size();
+    }
+
+    void push(std::function<void()> task) {
+        if (queues.empty()) {
+            task();
+            return;
+        }
+        Queue &queue = *queues[ownQueue()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            ++queued;
+        }
+        wake.notify_one();
+    }
+
+    /** This method runs one task, preferring the back of queue self and otherwise stealing from the front of the others.
+     * Tasks from submit and parallelFor hand their exceptions back to whoever waits on them, and are the only tasks queued, so nothing is caught here.
+     * @return Whether a task was run.*/
+    bool runOne(size_t self) {
+        std::function<void()> task;
+        for (size_t i = 0; i < queues.size() && !task; ++i) {
+            Queue &queue = *queues[(self + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty()) { continue; }
+            if (i == 0) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            } else {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+        }
+        if (!task) { return false; }
+        --queued;
+        task();
+        return true;
+    }
+
+    void workerLoop(unsigned self) {
+        workerPool = this;
+        workerQueue = self;
+        while (true) {
+            if (runOne(self)) { continue; }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this] { return stopping || queued != 0; });
+            if (stopping && queued == 0) { return; }
+        }
+    }
+};
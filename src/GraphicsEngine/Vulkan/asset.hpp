@@ -1,19 +1,17 @@
 #pragma once
 
-#if defined(_WIN32)
-#define GLSLC "glslc.exe "
-#else
-#define GLSLC "glslc "
-#endif
-
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
-
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include <algorithm>
+#include <chrono>
 #include <fstream>
+#include <cstdlib>
 #include <cstring>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <unordered_map>
 #include <valarray>
 
 #include <glm/glm.hpp>
@@ -23,7 +21,11 @@
 #include "bufferManager.hpp"
 #include "camera.hpp"
 #include "gpuData.hpp"
+#include "meshCache.hpp"
+#include "meshOptimizer.hpp"
+#include "objParser.hpp"
 #include "rasterizationPipelineManager.hpp"
+#include "shaderCache.hpp"
 #include "vertex.hpp"
 
 /** This class holds the methods to manage the window that was created.*/
@@ -48,6 +50,66 @@ public:
         loadShaders(shaderFileNames);
     }
 
+    /** This method sets the variables used in this class and starts loading the model, every texture, and every shader on tasks of their own, returning right away. The asset must stay where it is while it loads, and its vertices, indices, textures, and shaders must not be touched until it is ready. VulkanRenderEngine::uploadAsset may be given it at once, and uploads it on the render thread once it has loaded.
+     * @param threadPool This is the pool to load the files on.
+     * @param initialPosition This variable holds the initial placement of the object.
+     * @param initialRotation This variable holds the initial rotation of the object.
+     * @param initialScale This variable holds the initial scale of the object.
+     * @param modelFileName This is the name of the model file.
+     * @param textureFileNames This is the name of the texture files.
+     * @param shaderFileNames This is the name of the shader files.*/
+    Asset(ThreadPool &threadPool, const char *modelFileName, const std::vector<const char *>& textureFileNames, const std::vector<const char *>& shaderFileNames, glm::vec3 initialPosition = {0, 0, 0}, glm::vec3 initialRotation = {0, 0, 0}, glm::vec3 initialScale = {1, 1, 1}) {
+        position = initialPosition;
+        rotation = initialRotation;
+        scale = initialScale;
+        modelName = modelFileName;
+        textureNames = textureFileNames;
+        shaderNames = shaderFileNames;
+        loadAsync(threadPool);
+    }
+
+    /** This destructor waits for any loads still running, since they write into the asset.*/
+    ~Asset() {
+        for (const std::shared_future<void> &task : loading) { task.wait(); }
+    }
+
+    /** This method tells whether the files have finished loading, without waiting for them. Assets loaded on the calling thread are always ready.
+     * @return Whether the asset is ready.*/
+    [[nodiscard]] bool ready() const {
+        return std::all_of(loading.begin(), loading.end(), [](const std::shared_future<void> &task) { return task.wait_for(std::chrono::seconds(0)) == std::future_status::ready; });
+    }
+
+    /** This method waits for the files to finish loading, running other loads on the calling thread meanwhile, then throws the first error any of them hit.*/
+    void wait() {
+        for (const std::shared_future<void> &task : loading) {
+            loadingPool->wait(task);
+            task.get();
+        }
+        loading.clear();
+    }
+
+    /** This method starts loading the model, textures, and shaders again into a new asset, leaving this one as it is so that it can still be drawn while they load.
+     * @param threadPool This is the pool to load the files on.
+     * @return The asset being loaded, to be handed to adopt once it is ready.*/
+    [[nodiscard]] std::shared_ptr<Asset> reloadAsync(ThreadPool &threadPool) const {
+        return std::shared_ptr<Asset>(new Asset(*this, threadPool));
+    }
+
+    /** This method takes the files of an asset that was loaded in this one's place by reloadAsync, waiting for them if they are still loading.
+     * @param loaded This is the asset returned by reloadAsync. It is left with this asset's old files.*/
+    void adopt(Asset &loaded) {
+        loaded.wait();
+        vertices.swap(loaded.vertices);
+        indices.swap(loaded.indices);
+        textures.swap(loaded.textures);
+        shaderData.swap(loaded.shaderData);
+        std::swap(width, loaded.width);
+        std::swap(height, loaded.height);
+        std::swap(triangleCount, loaded.triangleCount);
+        std::swap(boundsMin, loaded.boundsMin);
+        std::swap(boundsMax, loaded.boundsMax);
+    }
+
     /** This method reloads the model, textures, and shaders.
      * @param modelFileName This is the name of the model file.
      * @param textureFileNames This is the name of the texture files.
@@ -61,6 +123,20 @@ public:
         loadShaders(shaderNames);
     }
 
+    /** This method splits every triangle into four at the middle of its edges, blending every vertex attribute, and keeps doing so whenever the model is reloaded. Edges shared by two triangles share their middle vertex, so the mesh stays joined.
+     * @param levels This is the number of times to split every triangle.*/
+    void subdivide(uint32_t levels) {
+        subdivisionLevels += levels;
+        split(levels);
+    }
+
+    /** This method repeats the model's vertices and indices, after any subdivision, so that it holds copies of the model one after another, and keeps doing so whenever the model is reloaded. With dynamic vertices, every copy can then be moved on its own, as the particles of a fluid are.
+     * @param copies This is the number of copies of the model to hold.*/
+    void repeat(uint32_t copies) {
+        repeatCount = copies;
+        copy(copies);
+    }
+
     /** This method destroys the program and loaded textures.*/
     void destroy() {
         for (ImageManager &textureImage : textureImages) { textureImage.destroy(); }
@@ -69,12 +145,14 @@ public:
     }
 
     /** This method updates/renders the program.
-     * @param camera This is the camera that the user is looking through in the program.*/
-    void update(Camera camera) {
-        uniformBufferObject = {glm::mat4(1.0f), camera.view, camera.proj};
-        glm::quat quaternion = glm::quat(glm::radians(rotation));
-        uniformBufferObject.model = glm::translate(glm::rotate(glm::scale(glm::mat4(1.0f), scale), glm::angle(quaternion), glm::axis(quaternion)), position);
+     * @param camera This is the camera that the user is looking through in the program.
+     * @param instanceTransforms These are the model matrices of the frame being recorded, indexed by instance slot.*/
+    void update(Camera camera, glm::mat4 *instanceTransforms) {
+        uniformBufferObject = {camera.view, camera.proj};
         memcpy(uniformBuffer.data, &uniformBufferObject, sizeof(UniformBufferObject));
+        if (externalTransforms || packedInstances) { return; }
+        glm::quat quaternion = glm::quat(glm::radians(rotation));
+        instanceTransforms[instanceIndex] = glm::translate(glm::rotate(glm::scale(glm::mat4(1.0f), scale), glm::angle(quaternion), glm::axis(quaternion)), position);
     }
 
     /** This variable holds the deletion queue for the destroy() method.*/
@@ -91,6 +169,8 @@ public:
     BufferManager indexBuffer{};
     /** This is a buffer manager named transformationBuffer{}.*/
     BufferManager transformationBuffer{};
+    /** This is the buffer of packed instances, for assets with packedInstances set.*/
+    BufferManager packedInstanceBuffer{};
     /** This variable holds the pipeline managers.*/
     std::vector<RasterizationPipelineManager> pipelineManagers{};
     /** This is a uniform buffer object.*/
@@ -99,8 +179,8 @@ public:
     std::vector<ImageManager> textureImages{};
     /** This variable holds the textures.*/
     std::vector<stbi_uc *> textures{};
-    /** This variable holds the shader data.*/
-    std::vector<std::vector<char>> shaderData{};
+    /** This variable holds the SPIR-V of the shaders, shared with every other asset using the same shaders.*/
+    std::vector<ShaderCache::Spirv> shaderData{};
     /** This variable is used to set the width of the texture.*/
     int width{};
     /** This variable is used to set the height of the texture.*/
@@ -113,81 +193,216 @@ public:
     glm::vec3 rotation{};
     /** This is a vector3 called scale.*/
     glm::vec3 scale{};
+    /** This is the first of this asset's slots in the instance transform buffer. It is assigned when the asset is uploaded, unless its instances are packed.*/
+    uint32_t instanceIndex{};
+    /** This is the number of instance slots reserved for this asset, all of which are drawn unless drawnInstances says otherwise. It must be set before the asset is uploaded.*/
+    uint32_t instanceCount{1};
+    /** This is the number of instances actually drawn, for assets whose instances come and go, such as particles, so that only the first of their slots are drawn, still with one instanced call. Counts past instanceCount draw every slot.*/
+    uint32_t drawnInstances{UINT32_MAX};
+    /** This variable tells the program that something else, such as a physics world, writes this asset's model matrices straight into the instance transform buffer every frame, so position, rotation, and scale are ignored. Otherwise only the first instance is written from them.*/
+    bool externalTransforms{false};
+    /** This variable tells the program that each instance is a position and a size packed into one vec4, as particles are, rather than a model matrix. Such instances are kept in a buffer of the asset's own, created when the asset is first uploaded and holding instanceCount of them for each frame in flight, and are written every frame through VulkanRenderEngine::packedInstances. The asset takes no slots in the instance transform buffer, and its vertex shader must build the model matrix itself, as particleShader.vert does. It must be set before the asset is uploaded.*/
+    bool packedInstances{false};
+    /** This variable tells the program that the vertices change every frame, as the vertices of cloth do. The vertex buffer then gets one region per frame in flight, to be written through VulkanRenderEngine::dynamicVertices. It must be set before the asset is uploaded.*/
+    bool dynamicVertices{false};
     /** This variable tells the program whether or not to render.*/
     bool render{true};
     /** This is the number of triangles.*/
     uint32_t triangleCount{};
+    /** This is the low corner of the box around the model's vertices as loaded, before scaling.*/
+    glm::vec3 boundsMin{};
+    /** This is the high corner of the box around the model's vertices as loaded, before scaling.*/
+    glm::vec3 boundsMax{};
+    /** This variable tells the program to keep the parsed model in a binary cache next to the model file and load it from there while the model file is unchanged. It is static, so turning it off before assets are created turns it off for all of them.*/
+    static inline bool useMeshCache{true};
+    /** This variable tells the program to reorder the triangles and vertices of parsed and subdivided models for the vertex cache, overdraw, and vertex fetching. Mesh caches record whether it was on, so changing it makes the model be parsed again. It is static, so turning it off before assets are created turns it off for all of them.*/
+    static inline bool optimizeMeshes{true};
+    /** This is the pool the asset was loaded on, which its model is also parsed across and its reloads run on, or null if it was loaded on the calling thread.*/
+    ThreadPool *loadingPool{};
     /** This is a Vulkan transformation matrix.*/
     VkTransformMatrixKHR transformationMatrix{1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f};
 
 private:
-    /** This method loads the model that is inputted.
+    /** These are the loads still running for an asset loaded on a thread pool.*/
+    std::vector<std::shared_future<void>> loading{};
+
+    /** This method starts reloading an asset's files on a thread pool, into an asset of its own.
+     * @param original This is the asset whose files are reloaded, with the same subdivision and repetition.
+     * @param threadPool This is the pool to load the files on.*/
+    Asset(const Asset &original, ThreadPool &threadPool) {
+        modelName = original.modelName;
+        textureNames = original.textureNames;
+        shaderNames = original.shaderNames;
+        subdivisionLevels = original.subdivisionLevels;
+        repeatCount = original.repeatCount;
+        loadAsync(threadPool);
+    }
+
+    /** This method queues the loads of the model, every texture, and every shader as tasks of their own.
+     * @param threadPool This is the pool to run the loads on.*/
+    void loadAsync(ThreadPool &threadPool) {
+        loadingPool = &threadPool;
+        loading.clear();
+        textures.assign(textureNames.size(), nullptr);
+        shaderData.assign(shaderNames.size(), {});
+        loading.push_back(threadPool.submit([this] { loadModel(modelName); }).share());
+        for (size_t i = 0; i < textureNames.size(); ++i) { loading.push_back(threadPool.submit([this, i] { loadTexture(textureNames[i], i); }).share()); }
+        for (size_t i = 0; i < shaderNames.size(); ++i) { loading.push_back(threadPool.submit([this, i] { loadShader(shaderNames[i], i, true); }).share()); }
+    }
+
+    /** This method loads the model that is inputted, from its mesh cache when that is still up to date and was built with the same options, and from the model file otherwise, caching the result for next time.
      * @param filename This is the filename of the model.*/
     void loadModel(const char *filename) {
+        uint64_t options = optimizeMeshes ? MeshCache::optimized : 0;
+        if (!useMeshCache || !MeshCache::load(filename, options, vertices, indices, boundsMin, boundsMax)) {
+            parseModel(filename);
+            MeshCache::bounds(vertices, boundsMin, boundsMax);
+            if (useMeshCache) { MeshCache::save(filename, options, vertices, indices, boundsMin, boundsMax); }
+        }
+        triangleCount = static_cast<uint32_t>(indices.size()) / 3;
+        split(subdivisionLevels);
+        copy(repeatCount);
+    }
+
+    /** This method parses a model file, leaving its vertices and indices before any subdivision or repetition, optimized for drawing unless optimizeMeshes is off.
+     * @param filename This is the filename of the model.*/
+    void parseModel(const char *filename) {
         vertices.clear();
         indices.clear();
-        tinyobj::attrib_t attrib;
-        std::vector<tinyobj::shape_t> shapes;
-        std::vector<tinyobj::material_t> materials;
-        std::string warn, err;
-        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename)) { throw std::runtime_error(warn + err); }
-        size_t reserveCount{};
-        for (const auto& shape : shapes) { reserveCount += shape.mesh.indices.size(); }
-        indices.reserve(reserveCount);
-        vertices.reserve(reserveCount * (2 / 3)); // Allocates too much space! Let's procrastinate cutting it down.
-        std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-        uniqueVertices.reserve(reserveCount * (2 / 3)); // Also allocates too much space, but it will be deleted at the end of the function, so we don't care
-        for (const auto& shape : shapes) {
-            for (const auto& index : shape.mesh.indices) {
-                Vertex vertex{};
-                vertex.pos = { attrib.vertices[3 * index.vertex_index], attrib.vertices[3 * index.vertex_index + 1], attrib.vertices[3 * index.vertex_index + 2] };
-                vertex.texCoord = { attrib.texcoords[2 * index.texcoord_index], 1.f - attrib.texcoords[2 * index.texcoord_index + 1] };
-                vertex.normal = { attrib.normals[3 * index.normal_index], attrib.normals[3 * index.normal_index + 1], attrib.normals[3 * index.normal_index + 2] };
-                vertex.color = {1.f, 1.f, 1.f};
-                if (uniqueVertices.find(vertex) == uniqueVertices.end()) {
-                    uniqueVertices.insert({vertex, static_cast<uint32_t>(vertices.size())});
+        ObjParser parser;
+        parser.parse(filename, loadingPool);
+        indices.reserve(parser.corners.size());
+        vertices.reserve(parser.corners.size());
+        //corners are merged into vertices through an open addressing table of vertex numbers, at most half full so probes stay short
+        size_t tableSize = 1;
+        while (tableSize < parser.corners.size() * 2) { tableSize <<= 1; }
+        std::vector<uint32_t> table(tableSize, UINT32_MAX);
+        std::hash<Vertex> hash{};
+        for (const ObjParser::Corner &corner : parser.corners) {
+            Vertex vertex{};
+            vertex.pos = { parser.positions[3 * corner.position], parser.positions[3 * corner.position + 1], parser.positions[3 * corner.position + 2] };
+            if (corner.texCoord >= 0) { vertex.texCoord = { parser.texCoords[2 * corner.texCoord], 1.f - parser.texCoords[2 * corner.texCoord + 1] }; }
+            if (corner.normal >= 0) { vertex.normal = { parser.normals[3 * corner.normal], parser.normals[3 * corner.normal + 1], parser.normals[3 * corner.normal + 2] }; }
+            vertex.color = {1.f, 1.f, 1.f};
+            size_t slot = hash(vertex) & (tableSize - 1);
+            while (table[slot] != UINT32_MAX && !(vertices[table[slot]] == vertex)) { slot = (slot + 1) & (tableSize - 1); }
+            if (table[slot] == UINT32_MAX) {
+                table[slot] = static_cast<uint32_t>(vertices.size());
+                vertices.push_back(vertex);
+            }
+            indices.push_back(table[slot]);
+        }
+        vertices.shrink_to_fit();
+        if (optimizeMeshes) { MeshOptimizer::optimize(vertices, indices); }
+    }
+
+    /** This variable holds the number of times every triangle is split after the model is loaded.*/
+    uint32_t subdivisionLevels{};
+
+    /** This method splits every triangle into four, levels times over.
+     * @param levels This is the number of times to split every triangle.*/
+    void split(uint32_t levels) {
+        for (uint32_t level = 0; level < levels; ++level) {
+            std::unordered_map<uint64_t, uint32_t> middles{};
+            middles.reserve(indices.size());
+            auto middle = [&](uint32_t a, uint32_t b) {
+                auto [found, added] = middles.emplace((uint64_t)std::min(a, b) << 32 | std::max(a, b), static_cast<uint32_t>(vertices.size()));
+                if (added) {
+                    Vertex vertex{};
+                    vertex.pos = (vertices[a].pos + vertices[b].pos) * 0.5f;
+                    vertex.color = (vertices[a].color + vertices[b].color) * 0.5f;
+                    vertex.texCoord = (vertices[a].texCoord + vertices[b].texCoord) * 0.5f;
+                    glm::vec3 normal = vertices[a].normal + vertices[b].normal;
+                    vertex.normal = glm::dot(normal, normal) > 0.0f ? glm::normalize(normal) : vertices[a].normal;
                     vertices.push_back(vertex);
                 }
-                indices.push_back(uniqueVertices[vertex]);
+                return found->second;
+            };
+            std::vector<uint32_t> splitIndices{};
+            splitIndices.reserve(indices.size() * 4);
+            for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+                uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+                uint32_t ab = middle(a, b), bc = middle(b, c), ca = middle(c, a);
+                splitIndices.insert(splitIndices.end(), {a, ab, ca, ab, b, bc, ca, bc, c, ab, bc, ca});
             }
+            indices.swap(splitIndices);
+        }
+        if (levels > 0 && optimizeMeshes) { MeshOptimizer::optimize(vertices, indices); }
+        triangleCount = static_cast<uint32_t>(indices.size()) / 3;
+    }
+
+    /** This variable holds the number of copies of the model held after it is loaded.*/
+    uint32_t repeatCount{1};
+
+    /** This method makes copies copies of the model's vertices and indices, each copy's indices pointing into its own vertices.
+     * @param copies This is the number of copies of the model to hold.*/
+    void copy(uint32_t copies) {
+        if (copies == 1) { return; }
+        size_t vertexCount = vertices.size(), indexCount = indices.size();
+        vertices.resize(vertexCount * copies);
+        indices.resize(indexCount * copies);
+        for (uint32_t repetition = 1; repetition < copies; ++repetition) {
+            std::copy(vertices.begin(), vertices.begin() + (std::ptrdiff_t)vertexCount, vertices.begin() + (std::ptrdiff_t)(vertexCount * repetition));
+            for (size_t i = 0; i < indexCount; ++i) { indices[indexCount * repetition + i] = indices[i] + static_cast<uint32_t>(vertexCount * repetition); }
         }
-        // Remove unneeded space at end of vertices at the last minute
-        std::vector<Vertex> tmp = vertices;
-        vertices.swap(tmp);
         triangleCount = static_cast<uint32_t>(indices.size()) / 3;
     }
 
     /** This method loads the textures that are inputted into the program.
      * @param filenames These are the filenames of the textures that are being loaded.*/
     void loadTextures(const std::vector<const char *>& filenames) {
-        textures.clear();
-        textures.reserve(filenames.size());
-        for (const char *filename : filenames) {
-            int channels{};
-            stbi_uc *pixels = stbi_load(((std::string)filename).c_str(), &width, &height, &channels, STBI_rgb_alpha);
-            if (!pixels) { throw std::runtime_error(("failed to load texture image from file: " + (std::string)filename).c_str()); }
-            textures.push_back(pixels);
+        textures.assign(filenames.size(), nullptr);
+        for (size_t i = 0; i < filenames.size(); ++i) { loadTexture(filenames[i], i); }
+    }
+
+    /** This method loads one texture into its place. The width and height are taken from the last texture.
+     * @param filename This is the filename of the texture.
+     * @param index This is the texture's place among the asset's textures.*/
+    void loadTexture(const char *filename, size_t index) {
+        int textureWidth{}, textureHeight{}, channels{};
+        stbi_uc *pixels = stbi_load(((std::string)filename).c_str(), &textureWidth, &textureHeight, &channels, STBI_rgb_alpha);
+        if (!pixels) { throw std::runtime_error(("failed to load texture image from file: " + (std::string)filename).c_str()); }
+        textures[index] = pixels;
+        if (index + 1 == textures.size()) {
+            width = textureWidth;
+            height = textureHeight;
         }
     }
 
-    /** This method loads the shaders that are inputted into the program
+    /** This method loads the shaders that are inputted into the program, compiling any that are not in the shader cache on the pool the asset was loaded on, if it was.
      * @param filenames These are the filenames of the shaders that are being loaded.
      * @param compile This variable tells the method whether or not to compile the shaders.*/
     void loadShaders(const std::vector<const char *>& filenames, bool compile = true) {
-        shaderData.clear();
-        shaderData.reserve(filenames.size());
-        for (const char *shaderName : shaderNames) {
-            std::string compiledFileName = ((std::string) shaderName).substr(0, sizeof(shaderName) - 4) + "spv";
-            if (compile) { if (system((GLSLC + (std::string)shaderName + " -o " + compiledFileName).c_str()) != 0) { throw std::runtime_error("failed to compile Shaders!"); } }
-            std::ifstream file(compiledFileName, std::ios::ate | std::ios::binary);
-            if (!file.is_open()) { throw std::runtime_error("failed to open file: " + compiledFileName.append("\n as file: " + compiledFileName)); }
-            size_t fileSize = (size_t) file.tellg();
-            std::vector<char> buffer(fileSize);
-            file.seekg(0);
-            file.read(buffer.data(), (std::streamsize)fileSize);
-            file.close();
-            shaderData.push_back(buffer);
+        shaderData.assign(filenames.size(), {});
+        if (loadingPool == nullptr || filenames.size() < 2) {
+            for (size_t i = 0; i < filenames.size(); ++i) { loadShader(filenames[i], i, compile); }
+            return;
+        }
+        std::vector<std::future<void>> shaders{};
+        shaders.reserve(filenames.size());
+        for (size_t i = 0; i < filenames.size(); ++i) { shaders.push_back(loadingPool->submit([this, &filenames, i, compile] { loadShader(filenames[i], i, compile); })); }
+        for (std::future<void> &shader : shaders) { loadingPool->wait(shader); }
+        for (std::future<void> &shader : shaders) { shader.get(); }
+    }
+
+    /** This method loads one shader into its place, through the shader cache so that it is only compiled if it has changed.
+     * @param shaderName This is the filename of the shader.
+     * @param index This is the shader's place among the asset's shaders.
+     * @param compile This variable tells the method whether or not to compile the shader. If not, the SPIR-V is read from the file of the same name with the extension .spv.*/
+    void loadShader(const char *shaderName, size_t index, bool compile) {
+        if (compile) {
+            shaderData[index] = ShaderCache::load(shaderName);
+            return;
         }
+        std::string compiledFileName = std::filesystem::path(shaderName).replace_extension(".spv").string();
+        std::ifstream file(compiledFileName, std::ios::ate | std::ios::binary);
+        if (!file.is_open()) { throw std::runtime_error("failed to open file: " + compiledFileName); }
+        size_t fileSize = (size_t) file.tellg();
+        std::vector<char> buffer(fileSize);
+        file.seekg(0);
+        file.read(buffer.data(), (std::streamsize)fileSize);
+        file.close();
+        shaderData[index] = std::make_shared<const std::vector<char>>(std::move(buffer));
     }
 
     /** This variable holds the shader names.*/
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "../../Core/mappedFile.hpp"
+#include "vertex.hpp"
+
+/** This class keeps the vertices and indices of loaded models in binary files next to them, so that a model only has to be parsed the first time it is loaded. Every cache records the size, modification time, and hash of the file it was built from, and the loader options it was built with, and is only used while they still match.*/
+class MeshCache {
+public:
+    /** This is bumped whenever the loader's output or the file layout changes, which makes every existing cache stale.*/
+    static constexpr uint32_t version = 3;
+    /** This option bit is set in caches of models that were reordered by MeshOptimizer.*/
+    static constexpr uint64_t optimized = 1;
+
+    /** This struct is the start of every cache file. The vertex and index blobs follow it at the offsets it gives.*/
+    struct Header {
+        char magic[4]{'C', 'E', 'M', 'C'};
+        uint32_t version{MeshCache::version};
+        uint32_t vertexSize{sizeof(Vertex)};
+        uint32_t indexSize{sizeof(uint32_t)};
+        uint64_t options{};
+        uint64_t sourceSize{};
+        int64_t sourceModified{};
+        uint64_t sourceHash{};
+        uint64_t vertexCount{};
+        uint64_t indexCount{};
+        uint64_t vertexOffset{};
+        uint64_t indexOffset{};
+        glm::vec3 boundsMin{};
+        glm::vec3 boundsMax{};
+    };
+
+    /** This method finds where the cache of a model is kept.
+     * @param modelFileName This is the name of the model file.
+     * @return The name of the cache file.*/
+    static std::filesystem::path cachePath(const std::filesystem::path &modelFileName) {
+        std::filesystem::path path = modelFileName;
+        return path += ".meshcache";
+    }
+
+    /** This method maps the cache of a model and copies its vertices and indices out, if the cache is intact and was built from the model file as it is now, with the same options. A cache whose source was touched but not changed is brought up to date in place.
+     * @param modelFileName This is the name of the model file.
+     * @param options These are the option bits, such as optimized, that change what the loader makes of the model.
+     * @param vertices This is filled with the cached vertices.
+     * @param indices This is filled with the cached indices.
+     * @param boundsMin This is set to the low corner of the box around the vertices.
+     * @param boundsMax This is set to the high corner of the box around the vertices.
+     * @return Whether the cache was used. Nothing is changed if it was not.*/
+    static bool load(const char *modelFileName, uint64_t options, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices, glm::vec3 &boundsMin, glm::vec3 &boundsMax) {
+        std::error_code error;
+        uint64_t sourceSize = std::filesystem::file_size(modelFileName, error);
+        if (error) { return false; }
+        int64_t sourceModified = modifiedTime(modelFileName);
+        std::filesystem::path path = cachePath(modelFileName);
+        MappedFile file(path);
+        if (file.size() < sizeof(Header)) { return false; }
+        Header header;
+        std::memcpy(&header, file.data(), sizeof(Header));
+        if (!intact(header, file.size()) || header.options != options || header.sourceSize != sourceSize) { return false; }
+        if (header.sourceModified != sourceModified) {
+            //the source was touched, so only its contents can tell whether the cache still holds
+            if (header.sourceHash != hashFile(modelFileName)) { return false; }
+            header.sourceModified = sourceModified;
+            std::fstream out(path, std::ios::binary | std::ios::in | std::ios::out);
+            out.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+        }
+        vertices.resize(header.vertexCount);
+        indices.resize(header.indexCount);
+        if (header.vertexCount != 0) { std::memcpy(vertices.data(), file.data() + header.vertexOffset, header.vertexCount * sizeof(Vertex)); }
+        if (header.indexCount != 0) { std::memcpy(indices.data(), file.data() + header.indexOffset, header.indexCount * sizeof(uint32_t)); }
+        boundsMin = header.boundsMin;
+        boundsMax = header.boundsMax;
+        return true;
+    }
+
+    /** This method writes the cache of a model, replacing any cache there was. The cache is written to a temporary file first and then renamed into place, so that a reader never maps half a cache.
+     * @param modelFileName This is the name of the model file the vertices and indices were loaded from.
+     * @param options These are the option bits the vertices and indices were loaded with.
+     * @param vertices These are the vertices of the model.
+     * @param indices These are the indices of the model.
+     * @param boundsMin This is the low corner of the box around the vertices.
+     * @param boundsMax This is the high corner of the box around the vertices.
+     * @return Whether the cache was written. Failing to write a cache, such as next to a model in a read only folder, only costs the next load its speed. Assets loading the same model at once each write a temporary file of their own, and the last rename wins.*/
+    static bool save(const char *modelFileName, uint64_t options, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, glm::vec3 boundsMin, glm::vec3 boundsMax) {
+        std::error_code error;
+        Header header;
+        header.sourceSize = std::filesystem::file_size(modelFileName, error);
+        if (error) { return false; }
+        header.options = options;
+        header.sourceModified = modifiedTime(modelFileName);
+        header.sourceHash = hashFile(modelFileName);
+        header.vertexCount = vertices.size();
+        header.indexCount = indices.size();
+        header.vertexOffset = align(sizeof(Header));
+        header.indexOffset = align(header.vertexOffset + vertices.size() * sizeof(Vertex));
+        header.boundsMin = boundsMin;
+        header.boundsMax = boundsMax;
+        std::filesystem::path path = cachePath(modelFileName), temporary = path;
+        temporary += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            if (!out) { return false; }
+            const char padding[alignment]{};
+            out.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+            out.write(padding, static_cast<std::streamsize>(header.vertexOffset - sizeof(Header)));
+            out.write(reinterpret_cast<const char *>(vertices.data()), static_cast<std::streamsize>(vertices.size() * sizeof(Vertex)));
+            out.write(padding, static_cast<std::streamsize>(header.indexOffset - header.vertexOffset - vertices.size() * sizeof(Vertex)));
+            out.write(reinterpret_cast<const char *>(indices.data()), static_cast<std::streamsize>(indices.size() * sizeof(uint32_t)));
+            if (!out) {
+                out.close();
+                std::filesystem::remove(temporary, error);
+                return false;
+            }
+        }
+        std::filesystem::rename(temporary, path, error);
+        if (error) { std::filesystem::remove(temporary, error); }
+        return !error;
+    }
+
+    /** This method finds the box around some vertices.
+     * @param vertices These are the vertices.
+     * @param boundsMin This is set to the low corner of the box, or the origin if there are no vertices.
+     * @param boundsMax This is set to the high corner of the box, or the origin if there are no vertices.*/
+    static void bounds(const std::vector<Vertex> &vertices, glm::vec3 &boundsMin, glm::vec3 &boundsMax) {
+        boundsMin = boundsMax = vertices.empty() ? glm::vec3(0.0f) : vertices[0].pos;
+        for (const Vertex &vertex : vertices) {
+            boundsMin = glm::min(boundsMin, vertex.pos);
+            boundsMax = glm::max(boundsMax, vertex.pos);
+        }
+    }
+
+    /** This method hashes the contents of a file with 64 bit FNV-1a, eight bytes at a time.
+     * @param fileName This is the file to hash.
+     * @return The hash, or zero if the file cannot be read.*/
+    static uint64_t hashFile(const std::filesystem::path &fileName) {
+        MappedFile file(fileName);
+        if (file.data() == nullptr) { return 0; }
+        uint64_t hash = 14695981039346656037ull;
+        size_t i = 0;
+        for (; i + 8 <= file.size(); i += 8) {
+            uint64_t word;
+            std::memcpy(&word, file.data() + i, 8);
+            hash = (hash ^ word) * 1099511628211ull;
+        }
+        for (; i < file.size(); ++i) { hash = (hash ^ file.data()[i]) * 1099511628211ull; }
+        return hash;
+    }
+
+private:
+    static constexpr size_t alignment = 16;
+
+    static uint64_t align(uint64_t offset) {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    static int64_t modifiedTime(const char *fileName) {
+        std::error_code error;
+        auto time = std::filesystem::last_write_time(fileName, error);
+        return error ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+    }
+
+    /** This method checks that a header was written by this version of the cache for this vertex layout, and that the blobs it points to lie within the file.*/
+    static bool intact(const Header &header, size_t fileSize) {
+        Header expected;
+        if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != version || header.vertexSize != sizeof(Vertex) || header.indexSize != sizeof(uint32_t)) { return false; }
+        if (header.vertexOffset < sizeof(Header) || header.vertexCount > (fileSize - std::min<uint64_t>(header.vertexOffset, fileSize)) / sizeof(Vertex)) { return false; }
+        if (header.indexOffset < header.vertexOffset + header.vertexCount * sizeof(Vertex) || header.indexCount > (fileSize - std::min<uint64_t>(header.indexOffset, fileSize)) / sizeof(uint32_t)) { return false; }
+        return header.indexOffset % alignof(uint32_t) == 0;
+    }
+};
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "vertex.hpp"
+
+/** This class reorders the triangles and vertices of indexed triangle lists so that the GPU does less work drawing them, without changing what is drawn.
+ * Triangles are ordered for the post transform vertex cache with Tipsify, the clusters that ordering leaves are sorted so that outward facing ones are drawn first to cut overdraw, and vertices are renumbered in the order they are first used so that fetching them walks the vertex buffer forwards.*/
+class MeshOptimizer {
+public:
+    /** This is the number of vertices the orderings assume the post transform cache holds.*/
+    static constexpr uint32_t cacheSize = 16;
+    /** This is how much worse than its hard cluster's miss ratio a run of triangles may be while still being cut into a cluster of its own for overdraw sorting.*/
+    static constexpr float overdrawThreshold = 1.05f;
+
+    /** This method runs every pass over a mesh.
+     * @param vertices These are the vertices. Unused vertices are dropped.
+     * @param indices These are the indices, three per triangle.*/
+    static void optimize(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+        reorderForVertexCache(indices, vertices.size());
+        reorderForOverdraw(indices, vertices);
+        reorderForVertexFetch(vertices, indices);
+    }
+
+    /** This method orders triangles so that consecutive triangles share vertices while they are still in the cache, fanning around the most recently used vertex that still has triangles left. This is Tipsify, from Sander, Nehab, and Barczak's "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw".
+     * @param indices These are the indices, three per triangle.
+     * @param vertexCount This is the number of vertices the indices point into.*/
+    static void reorderForVertexCache(std::vector<uint32_t> &indices, size_t vertexCount) {
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0) { return; }
+        //the triangles around every vertex, found by counting then filling
+        std::vector<uint32_t> liveTriangles(vertexCount), firstTriangle(vertexCount + 1), adjacency(triangleCount * 3);
+        for (size_t i = 0; i < triangleCount * 3; ++i) { ++liveTriangles[indices[i]]; }
+        std::partial_sum(liveTriangles.begin(), liveTriangles.end(), firstTriangle.begin() + 1);
+        std::vector<uint32_t> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; ++i) { adjacency[filled[indices[i]]++] = (uint32_t)(i / 3); }
+        std::vector<uint32_t> cacheTime(vertexCount), deadEnds{}, candidates{}, reordered{};
+        std::vector<bool> emitted(triangleCount);
+        deadEnds.reserve(triangleCount * 3);
+        reordered.reserve(triangleCount * 3);
+        uint32_t time = cacheSize + 1, cursor = 0;
+        int64_t fan = 0;
+        while (fan >= 0) {
+            candidates.clear();
+            for (uint32_t j = firstTriangle[fan]; j < firstTriangle[fan + 1]; ++j) {
+                uint32_t triangle = adjacency[j];
+                if (emitted[triangle]) { continue; }
+                emitted[triangle] = true;
+                for (uint32_t k = 0; k < 3; ++k) {
+                    uint32_t vertex = indices[triangle * 3 + k];
+                    reordered.push_back(vertex);
+                    deadEnds.push_back(vertex);
+                    candidates.push_back(vertex);
+                    --liveTriangles[vertex];
+                    if (time - cacheTime[vertex] > cacheSize) { cacheTime[vertex] = time++; }
+                }
+            }
+            //the next fan is the candidate that will still be cached after its own triangles are drawn and has been cached longest
+            fan = -1;
+            int64_t best = -1;
+            for (uint32_t vertex : candidates) {
+                if (liveTriangles[vertex] == 0) { continue; }
+                int64_t priority = time - cacheTime[vertex] + 2 * liveTriangles[vertex] <= cacheSize ? time - cacheTime[vertex] : 0;
+                if (priority > best) {
+                    best = priority;
+                    fan = vertex;
+                }
+            }
+            while (fan < 0 && !deadEnds.empty()) {
+                uint32_t vertex = deadEnds.back();
+                deadEnds.pop_back();
+                if (liveTriangles[vertex] > 0) { fan = vertex; }
+            }
+            for (; fan < 0 && cursor < vertexCount; ++cursor) { if (liveTriangles[cursor] > 0) { fan = cursor; } }
+        }
+        reordered.insert(reordered.end(), indices.begin() + (std::ptrdiff_t)(triangleCount * 3), indices.end());
+        indices.swap(reordered);
+    }
+
+    /** This method cuts the triangles into clusters where the cache runs cold, and where it is nearly as warm as it gets within them, then draws the clusters that face away from the middle of the mesh first. Triangles keep their order within a cluster, so most of the cache ordering survives.
+     * @param indices These are the indices, three per triangle, best already ordered for the vertex cache.
+     * @param vertices These are the vertices the indices point into.*/
+    static void reorderForOverdraw(std::vector<uint32_t> &indices, const std::vector<Vertex> &vertices) {
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount < 2) { return; }
+        std::vector<uint32_t> cacheTime(vertices.size());
+        uint32_t time = cacheSize + 1;
+        auto misses = [&](size_t triangle) {
+            uint32_t count = 0;
+            for (uint32_t k = 0; k < 3; ++k) {
+                uint32_t vertex = indices[triangle * 3 + k];
+                if (time - cacheTime[vertex] > cacheSize) {
+                    cacheTime[vertex] = time++;
+                    ++count;
+                }
+            }
+            return count;
+        };
+        auto flush = [&] { time += cacheSize + 1; };
+        //a triangle none of whose vertices are cached starts a hard cluster
+        std::vector<size_t> hard{};
+        for (size_t triangle = 0; triangle < triangleCount; ++triangle) { if (misses(triangle) == 3) { hard.push_back(triangle); } }
+        hard.push_back(triangleCount);
+        std::vector<size_t> clusters{};
+        for (size_t i = 0; i + 1 < hard.size(); ++i) {
+            size_t begin = hard[i], end = hard[i + 1];
+            flush();
+            uint32_t clusterMisses = 0;
+            for (size_t triangle = begin; triangle < end; ++triangle) { clusterMisses += misses(triangle); }
+            float limit = (float)clusterMisses / (float)(end - begin) * overdrawThreshold;
+            flush();
+            clusters.push_back(begin);
+            uint32_t softMisses = 0;
+            for (size_t triangle = begin, softBegin = begin; triangle < end; ++triangle) {
+                softMisses += misses(triangle);
+                if (triangle + 1 < end && (float)softMisses / (float)(triangle + 1 - softBegin) <= limit) {
+                    clusters.push_back(triangle + 1);
+                    softBegin = triangle + 1;
+                    softMisses = 0;
+                    flush();
+                }
+            }
+        }
+        clusters.push_back(triangleCount);
+        glm::vec3 meshCentroid{};
+        float meshArea = 0.0f;
+        std::vector<glm::vec3> centroids(clusters.size() - 1), normals(clusters.size() - 1);
+        for (size_t cluster = 0; cluster + 1 < clusters.size(); ++cluster) {
+            glm::vec3 centroid{}, normal{};
+            float area = 0.0f;
+            for (size_t triangle = clusters[cluster]; triangle < clusters[cluster + 1]; ++triangle) {
+                const glm::vec3 &a = vertices[indices[triangle * 3]].pos, &b = vertices[indices[triangle * 3 + 1]].pos, &c = vertices[indices[triangle * 3 + 2]].pos;
+                glm::vec3 cross = glm::cross(b - a, c - a);
+                float triangleArea = glm::length(cross);
+                centroid += (a + b + c) * (triangleArea / 3.0f);
+                normal += cross;
+                area += triangleArea;
+            }
+            meshCentroid += centroid;
+            meshArea += area;
+            centroids[cluster] = area > 0.0f ? centroid / area : vertices[indices[clusters[cluster] * 3]].pos;
+            normals[cluster] = glm::dot(normal, normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f);
+        }
+        if (meshArea > 0.0f) { meshCentroid /= meshArea; }
+        std::vector<float> outwardness(centroids.size());
+        for (size_t cluster = 0; cluster < centroids.size(); ++cluster) { outwardness[cluster] = glm::dot(centroids[cluster] - meshCentroid, normals[cluster]); }
+        std::vector<uint32_t> order(centroids.size());
+        std::iota(order.begin(), order.end(), 0u);
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return outwardness[a] > outwardness[b]; });
+        std::vector<uint32_t> reordered{};
+        reordered.reserve(indices.size());
+        for (uint32_t cluster : order) { reordered.insert(reordered.end(), indices.begin() + (std::ptrdiff_t)(clusters[cluster] * 3), indices.begin() + (std::ptrdiff_t)(clusters[cluster + 1] * 3)); }
+        reordered.insert(reordered.end(), indices.begin() + (std::ptrdiff_t)(triangleCount * 3), indices.end());
+        indices.swap(reordered);
+    }
+
+    /** This method renumbers vertices in the order the indices first use them, dropping any that are never used.
+     * @param vertices These are the vertices.
+     * @param indices These are the indices.*/
+    static void reorderForVertexFetch(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+        std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+        std::vector<Vertex> reordered{};
+        reordered.reserve(vertices.size());
+        for (uint32_t &index : indices) {
+            if (remap[index] == UINT32_MAX) {
+                remap[index] = (uint32_t)reordered.size();
+                reordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        vertices.swap(reordered);
+    }
+
+    /** This method counts how many vertices a FIFO post transform cache would have to transform per triangle drawn.
+     * @param indices These are the indices, three per triangle.
+     * @param vertexCount This is the number of vertices the indices point into.
+     * @param size This is the number of vertices the cache holds.
+     * @return The average cache miss ratio, between 0.5 for a perfect ordering of a large grid and 3.*/
+    static float averageCacheMissRatio(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t size = cacheSize) {
+        if (indices.size() < 3) { return 0.0f; }
+        std::vector<uint32_t> cacheTime(vertexCount);
+        uint32_t time = size + 1, misses = 0;
+        for (uint32_t vertex : indices) {
+            if (time - cacheTime[vertex] > size) {
+                cacheTime[vertex] = time++;
+                ++misses;
+            }
+        }
+        return (float)misses / (float)(indices.size() / 3);
+    }
+};
@@ -0,0 +1,450 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CRYSTAL_ENGINE_OBJ_SSE2
+#endif
+
+#include "../../Core/mappedFile.hpp"
+#include "../../Core/threadPool.hpp"
+
+/** This class parses the positions, texture coordinates, normals, and faces of Wavefront OBJ files.
+ * The file is mapped and split into chunks that start on line boundaries. A first pass over the chunks counts the attributes in each, so that a second pass can parse every chunk straight into its place in the attribute arrays, and a third triangulates the faces of every chunk. The chunks are joined in file order, so the result does not depend on the number of chunks or threads.
+ * Numbers are read and polygons triangulated the same way tinyobjloader does, so the output matches it bit for bit.*/
+class ObjParser {
+public:
+    /** This struct is one corner of a triangle. Each member indexes the attribute it is named after, or is -1 if the corner has none.*/
+    struct Corner {
+        int32_t position{-1};
+        int32_t texCoord{-1};
+        int32_t normal{-1};
+    };
+
+    /** These are the positions, three floats each.*/
+    std::vector<float> positions{};
+    /** These are the texture coordinates, two floats each.*/
+    std::vector<float> texCoords{};
+    /** These are the normals, three floats each.*/
+    std::vector<float> normals{};
+    /** These are the corners of the triangles, three per triangle, in the order the faces appear in the file.*/
+    std::vector<Corner> corners{};
+
+    /** This is the smallest chunk worth giving a task of its own.*/
+    static constexpr size_t minimumChunkSize = 64 * 1024;
+
+    /** This method parses a model file, replacing whatever was parsed before.
+     * @param filename This is the filename of the model.
+     * @param threadPool This is the pool to parse the chunks on, or nullptr to parse the whole file on the calling thread.*/
+    void parse(const char *filename, ThreadPool *threadPool = nullptr) {
+        positions.clear();
+        texCoords.clear();
+        normals.clear();
+        corners.clear();
+        MappedFile file(filename);
+        if (file.data() == nullptr) {
+            std::error_code error;
+            if (std::filesystem::exists(filename, error) && std::filesystem::file_size(filename, error) == 0 && !error) { return; }
+            throw std::runtime_error("failed to open model file: " + (std::string)filename);
+        }
+        const char *text = reinterpret_cast<const char *>(file.data());
+        std::vector<Chunk> chunks = split(text, file.size(), threadPool);
+        auto forEachChunk = [&](auto &&body) {
+            if (threadPool == nullptr || chunks.size() == 1) { for (Chunk &chunk : chunks) { body(chunk); } }
+            else { threadPool->parallelFor(chunks.size(), 1, [&](size_t begin, size_t end) { for (size_t i = begin; i < end; ++i) { body(chunks[i]); } }); }
+        };
+        forEachChunk([](Chunk &chunk) { count(chunk); });
+        size_t positionCount{}, texCoordCount{}, normalCount{};
+        for (Chunk &chunk : chunks) {
+            chunk.firstPosition = positionCount;
+            chunk.firstTexCoord = texCoordCount;
+            chunk.firstNormal = normalCount;
+            positionCount += chunk.positionCount;
+            texCoordCount += chunk.texCoordCount;
+            normalCount += chunk.normalCount;
+        }
+        if (std::max({positionCount, texCoordCount, normalCount}) > (size_t)std::numeric_limits<int32_t>::max()) { throw std::runtime_error("model file has too many vertices: " + (std::string)filename); }
+        positions.resize(positionCount * 3);
+        texCoords.resize(texCoordCount * 2);
+        normals.resize(normalCount * 3);
+        forEachChunk([this](Chunk &chunk) { read(chunk); });
+        throwFirstError(chunks, text, filename);
+        forEachChunk([this](Chunk &chunk) { triangulate(chunk); });
+        throwFirstError(chunks, text, filename);
+        size_t cornerCount{};
+        for (Chunk &chunk : chunks) {
+            chunk.firstCorner = cornerCount;
+            cornerCount += chunk.triangles.size();
+        }
+        corners.resize(cornerCount);
+        forEachChunk([this](Chunk &chunk) {
+            std::copy(chunk.triangles.begin(), chunk.triangles.end(), corners.begin() + (ptrdiff_t)chunk.firstCorner);
+            std::vector<Corner>().swap(chunk.triangles);
+        });
+    }
+
+private:
+    /** This struct is a run of whole lines of the file, with what was found in it.*/
+    struct Chunk {
+        const char *begin{};
+        const char *end{};
+        size_t positionCount{}, texCoordCount{}, normalCount{};
+        size_t firstPosition{}, firstTexCoord{}, firstNormal{}, firstCorner{};
+        std::vector<Corner> faceCorners{};
+        std::vector<uint32_t> faceSizes{};
+        std::vector<Corner> triangles{};
+        std::string error{};
+        const char *errorLine{};
+    };
+
+    enum LineType { other, position, texCoord, normal, face };
+
+    static bool isSpace(char character) {
+        return character == ' ' || character == '\t';
+    }
+
+    static bool isDigit(char character) {
+        return static_cast<unsigned>(character - '0') < 10u;
+    }
+
+    /** This method finds the end of a line.
+     * @param line This is the start of the line.
+     * @param end This is the end of the text.
+     * @return The newline that ends the line, or end if the text ends first.*/
+    static const char *findNewline(const char *line, const char *end) {
+#ifdef CRYSTAL_ENGINE_OBJ_SSE2
+        const __m128i newline = _mm_set1_epi8('\n');
+        for (; end - line >= 16; line += 16) {
+            int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(line)), newline));
+            if (mask != 0) {
+#if defined(_MSC_VER) && !defined(__clang__)
+                unsigned long first;
+                _BitScanForward(&first, (unsigned long)mask);
+                return line + first;
+#else
+                return line + __builtin_ctz((unsigned)mask);
+#endif
+            }
+        }
+#endif
+        const void *found = std::memchr(line, '\n', (size_t)(end - line));
+        return found == nullptr ? end : static_cast<const char *>(found);
+    }
+
+    /** This method splits the text into chunks of whole lines, enough to keep every thread of the pool busy.*/
+    static std::vector<Chunk> split(const char *text, size_t size, ThreadPool *threadPool) {
+        size_t chunkCount = 1;
+        if (threadPool != nullptr && threadPool->concurrency() > 1) { chunkCount = std::clamp<size_t>(size / minimumChunkSize, 1, (size_t)threadPool->concurrency() * 4); }
+        std::vector<Chunk> chunks{};
+        chunks.reserve(chunkCount);
+        const char *begin = text, *end = text + size;
+        for (size_t i = 1; i <= chunkCount && begin < end; ++i) {
+            const char *chunkEnd = end;
+            if (i != chunkCount) {
+                const char *newline = findNewline(std::max(begin, text + size / chunkCount * i), end);
+                if (newline != end) { chunkEnd = newline + 1; }
+            }
+            Chunk &chunk = chunks.emplace_back();
+            chunk.begin = begin;
+            chunk.end = chunkEnd;
+            begin = chunkEnd;
+        }
+        return chunks;
+    }
+
+    /** This method finds the meaningful part of a line and what kind of line it is.
+     * @param token This is set to the first character after the leading spaces, and then past the keyword.
+     * @param lineEnd This is the newline or end of text after the line, and is moved back over a carriage return.*/
+    static LineType classify(const char *&token, const char *&lineEnd) {
+        if (lineEnd != token && lineEnd[-1] == '\r') { --lineEnd; }
+        while (token != lineEnd && isSpace(*token)) { ++token; }
+        ptrdiff_t length = lineEnd - token;
+        if (length < 2) { return other; }
+        if (token[0] == 'v') {
+            if (isSpace(token[1])) {
+                token += 2;
+                return position;
+            }
+            if (length >= 3 && isSpace(token[2])) {
+                if (token[1] == 't') {
+                    token += 3;
+                    return texCoord;
+                }
+                if (token[1] == 'n') {
+                    token += 3;
+                    return normal;
+                }
+            }
+            return other;
+        }
+        if (token[0] == 'f' && isSpace(token[1])) {
+            token += 2;
+            return face;
+        }
+        return other;
+    }
+
+    /** This method counts the attributes in a chunk, so that every chunk knows where its attributes go before any are read.*/
+    static void count(Chunk &chunk) {
+        for (const char *line = chunk.begin; line < chunk.end;) {
+            const char *newline = findNewline(line, chunk.end), *token = line, *lineEnd = newline;
+            switch (classify(token, lineEnd)) {
+                case position: ++chunk.positionCount; break;
+                case texCoord: ++chunk.texCoordCount; break;
+                case normal: ++chunk.normalCount; break;
+                default: break;
+            }
+            line = newline + 1;
+        }
+    }
+
+    /** This method reads the attributes of a chunk into their places and collects the corners of its faces, resolving relative indices against the attributes before them.*/
+    void read(Chunk &chunk) {
+        size_t positionCount = chunk.firstPosition, texCoordCount = chunk.firstTexCoord, normalCount = chunk.firstNormal;
+        chunk.faceCorners.reserve((size_t)(chunk.end - chunk.begin) / 24);
+        for (const char *line = chunk.begin; line < chunk.end;) {
+            const char *newline = findNewline(line, chunk.end), *token = line, *lineEnd = newline;
+            switch (classify(token, lineEnd)) {
+                case LineType::position:
+                    for (int i = 0; i < 3; ++i) { positions[positionCount * 3 + i] = parseReal(token, lineEnd); }
+                    ++positionCount;
+                    break;
+                case LineType::texCoord:
+                    for (int i = 0; i < 2; ++i) { texCoords[texCoordCount * 2 + i] = parseReal(token, lineEnd); }
+                    ++texCoordCount;
+                    break;
+                case LineType::normal:
+                    for (int i = 0; i < 3; ++i) { normals[normalCount * 3 + i] = parseReal(token, lineEnd); }
+                    ++normalCount;
+                    break;
+                case LineType::face: {
+                    while (token != lineEnd && isSpace(*token)) { ++token; }
+                    uint32_t size{};
+                    while (token != lineEnd && *token != '\r' && *token != '\0') {
+                        Corner corner;
+                        if (!parseCorner(token, lineEnd, (int)positionCount, (int)texCoordCount, (int)normalCount, corner)) {
+                            chunk.error = "failed to parse face";
+                            chunk.errorLine = line;
+                            return;
+                        }
+                        chunk.faceCorners.push_back(corner);
+                        ++size;
+                        while (token != lineEnd && (isSpace(*token) || *token == '\r')) { ++token; }
+                    }
+                    chunk.faceSizes.push_back(size);
+                    break;
+                }
+                default: break;
+            }
+            line = newline + 1;
+        }
+    }
+
+    /** This method reads an index the way atoi does, stopping at the end of the line.*/
+    static int parseIndex(const char *token, const char *lineEnd) {
+        while (token != lineEnd && (isSpace(*token) || *token == '\n' || *token == '\v' || *token == '\f' || *token == '\r')) { ++token; }
+        bool negative = false;
+        if (token != lineEnd && (*token == '+' || *token == '-')) { negative = *token++ == '-'; }
+        int64_t value{};
+        for (; token != lineEnd && isDigit(*token) && value <= std::numeric_limits<int32_t>::max(); ++token) { value = value * 10 + (*token - '0'); }
+        if (value > std::numeric_limits<int32_t>::max()) { return 0; }
+        return (int)(negative ? -value : value);
+    }
+
+    /** This method makes an index zero based, with negative indices counting back from the end of the attributes read so far.
+     * @return Whether the index was valid. Zero is never a valid index.*/
+    static bool fixIndex(int index, int count, int32_t &fixed) {
+        if (index > 0) { fixed = index - 1; }
+        else if (index < 0) { fixed = count + index; }
+        return index != 0;
+    }
+
+    /** This method skips to the next slash or space.*/
+    static void skipIndex(const char *&token, const char *lineEnd) {
+        while (token != lineEnd && *token != '/' && !isSpace(*token) && *token != '\r') { ++token; }
+    }
+
+    /** This method reads a corner of a face, written as v, v/vt, v//vn, or v/vt/vn.*/
+    static bool parseCorner(const char *&token, const char *lineEnd, int positionCount, int texCoordCount, int normalCount, Corner &corner) {
+        if (!fixIndex(parseIndex(token, lineEnd), positionCount, corner.position)) { return false; }
+        skipIndex(token, lineEnd);
+        if (token == lineEnd || *token != '/') { return true; }
+        ++token;
+        if (token != lineEnd && *token == '/') {
+            ++token;
+            if (!fixIndex(parseIndex(token, lineEnd), normalCount, corner.normal)) { return false; }
+            skipIndex(token, lineEnd);
+            return true;
+        }
+        if (!fixIndex(parseIndex(token, lineEnd), texCoordCount, corner.texCoord)) { return false; }
+        skipIndex(token, lineEnd);
+        if (token == lineEnd || *token != '/') { return true; }
+        ++token;
+        if (!fixIndex(parseIndex(token, lineEnd), normalCount, corner.normal)) { return false; }
+        skipIndex(token, lineEnd);
+        return true;
+    }
+
+    /** This method reads the next number on a line, or zero if it is missing or malformed.*/
+    static float parseReal(const char *&token, const char *lineEnd) {
+        while (token != lineEnd && isSpace(*token)) { ++token; }
+        const char *end = token;
+        while (end != lineEnd && !isSpace(*end) && *end != '\r') { ++end; }
+        double value = 0.0;
+        parseDouble(token, end, value);
+        token = end;
+        return static_cast<float>(value);
+    }
+
+    /** This method reads a number in the form [sign] digits [. digits] [e [sign] digits], accumulating its digits in the same order and precision as tinyobjloader.
+     * @return Whether the number was well formed. The value is only set if it was.*/
+    static bool parseDouble(const char *text, const char *end, double &result) {
+        static constexpr double powers[]{1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001};
+        if (text >= end) { return false; }
+        const char *current = text;
+        double mantissa = 0.0;
+        int exponent = 0, read = 0;
+        bool negative = false, leadingDot = false;
+        if (*current == '+' || *current == '-') {
+            negative = *current++ == '-';
+            leadingDot = current != end && *current == '.';
+        } else if (*current == '.') { leadingDot = true; }
+        else if (!isDigit(*current)) { return false; }
+        if (!leadingDot) {
+            for (; current != end && isDigit(*current); ++current, ++read) { mantissa = mantissa * 10 + (*current - '0'); }
+            if (read == 0) { return false; }
+        }
+        if (current != end) {
+            if (*current == '.') {
+                ++current;
+                for (read = 1; current != end && isDigit(*current); ++current, ++read) { mantissa += (*current - '0') * (read < 8 ? powers[read] : std::pow(10.0, -read)); }
+            } else if (*current != 'e' && *current != 'E') { current = end; }
+            if (current != end && (*current == 'e' || *current == 'E')) {
+                ++current;
+                bool negativeExponent = false;
+                if (current != end && (*current == '+' || *current == '-')) { negativeExponent = *current++ == '-'; }
+                else if (current == end || !isDigit(*current)) { return false; }
+                for (read = 0; current != end && isDigit(*current); ++current, ++read) { exponent = exponent * 10 + (*current - '0'); }
+                if (negativeExponent) { exponent = -exponent; }
+                if (read == 0) { return false; }
+            }
+        }
+        result = (negative ? -1 : 1) * (exponent != 0 ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
+        return true;
+    }
+
+    /** This method turns the faces of a chunk into triangles. Triangles are kept as they are, and larger polygons are cut into ears.*/
+    void triangulate(Chunk &chunk) {
+        chunk.triangles.reserve(chunk.faceCorners.size() + chunk.faceSizes.size());
+        const int32_t positionCount = (int32_t)(positions.size() / 3), texCoordCount = (int32_t)(texCoords.size() / 2), normalCount = (int32_t)(normals.size() / 3);
+        for (const Corner &corner : chunk.faceCorners) {
+            if (corner.position < 0 || corner.position >= positionCount || corner.texCoord < -1 || corner.texCoord >= texCoordCount || corner.normal < -1 || corner.normal >= normalCount) {
+                chunk.error = "face refers to a missing vertex";
+                return;
+            }
+        }
+        std::vector<Corner> remaining{};
+        const Corner *face = chunk.faceCorners.data();
+        for (uint32_t size : chunk.faceSizes) {
+            if (size == 3) { chunk.triangles.insert(chunk.triangles.end(), face, face + 3); }
+            else if (size > 3) {
+                remaining.assign(face, face + size);
+                cutEars(remaining, chunk.triangles);
+            }
+            face += size;
+        }
+        std::vector<Corner>().swap(chunk.faceCorners);
+        std::vector<uint32_t>().swap(chunk.faceSizes);
+    }
+
+    /** This method tests whether a point is inside a triangle.*/
+    static bool inside(const float *x, const float *y, float testX, float testY) {
+        bool in = false;
+        for (int i = 0, j = 2; i < 3; j = i++) {
+            if (((y[i] > testY) != (y[j] > testY)) && (testX < (x[j] - x[i]) * (testY - y[i]) / (y[j] - y[i]) + x[i])) { in = !in; }
+        }
+        return in;
+    }
+
+    /** This method cuts a polygon into triangles by clipping ears, in the plane of the two axes it spans most.
+     * @param polygon These are the corners of the polygon. It is consumed.
+     * @param triangles The triangles are added to this.*/
+    void cutEars(std::vector<Corner> &polygon, std::vector<Corner> &triangles) const {
+        const float *v = positions.data();
+        size_t count = polygon.size();
+        //every index wrapped is less than twice the count, so wrapping is a subtraction
+        auto wrap = [&count](size_t index) { return index >= count ? index - count : index; };
+        size_t axes[2]{1, 2};
+        for (size_t k = 0; k < count; ++k) {
+            const float *a = v + polygon[k].position * 3, *b = v + polygon[wrap(k + 1)].position * 3, *c = v + polygon[wrap(k + 2)].position * 3;
+            float e0x = b[0] - a[0], e0y = b[1] - a[1], e0z = b[2] - a[2];
+            float e1x = c[0] - b[0], e1y = c[1] - b[1], e1z = c[2] - b[2];
+            float cx = std::fabs(e0y * e1z - e0z * e1y), cy = std::fabs(e0z * e1x - e0x * e1z), cz = std::fabs(e0x * e1y - e0y * e1x);
+            const float epsilon = std::numeric_limits<float>::epsilon();
+            if (cx > epsilon || cy > epsilon || cz > epsilon) {
+                if (!(cx > cy && cx > cz)) {
+                    axes[0] = 0;
+                    if (cz > cx && cz > cy) { axes[1] = 1; }
+                }
+                break;
+            }
+        }
+        float area = 0;
+        for (size_t k = 0; k < count; ++k) {
+            const float *a = v + polygon[k].position * 3, *b = v + polygon[wrap(k + 1)].position * 3;
+            area += (a[axes[0]] * b[axes[1]] - a[axes[1]] * b[axes[0]]) * 0.5f;
+        }
+        size_t guess = 0, iterationsLeft = count, previousCount = count;
+        Corner ear[3];
+        float x[3], y[3];
+        while (polygon.size() > 3 && iterationsLeft > 0) {
+            count = polygon.size();
+            if (guess >= count) { guess -= count; }
+            //every vertex gets a turn as the tip of an ear before giving up on a polygon that stopped shrinking
+            if (previousCount != count) {
+                previousCount = count;
+                iterationsLeft = count;
+            } else { --iterationsLeft; }
+            for (size_t k = 0; k < 3; ++k) {
+                ear[k] = polygon[wrap(guess + k)];
+                x[k] = v[ear[k].position * 3 + axes[0]];
+                y[k] = v[ear[k].position * 3 + axes[1]];
+            }
+            float cross = (x[1] - x[0]) * (y[2] - y[1]) - (y[1] - y[0]) * (x[2] - x[1]);
+            if (cross * area < 0.0f) {
+                ++guess;
+                continue;
+            }
+            bool overlap = false;
+            for (size_t other = 3; other < count && !overlap; ++other) {
+                const float *point = v + polygon[wrap(guess + other)].position * 3;
+                overlap = inside(x, y, point[axes[0]], point[axes[1]]);
+            }
+            if (overlap) {
+                ++guess;
+                continue;
+            }
+            triangles.insert(triangles.end(), ear, ear + 3);
+            polygon.erase(polygon.begin() + (ptrdiff_t)wrap(guess + 1));
+        }
+        if (polygon.size() == 3) { triangles.insert(triangles.end(), polygon.begin(), polygon.end()); }
+    }
+
+    /** This method throws for the first chunk that failed, naming the line it failed on when it is known.*/
+    static void throwFirstError(const std::vector<Chunk> &chunks, const char *text, const char *filename) {
+        for (const Chunk &chunk : chunks) {
+            if (chunk.error.empty()) { continue; }
+            std::string where = chunk.errorLine == nullptr ? "" : " on line " + std::to_string(1 + std::count(text, chunk.errorLine, '\n'));
+            throw std::runtime_error(chunk.error + where + " in model file: " + (std::string)filename);
+        }
+    }
+};
@@ -7,6 +7,7 @@
 #include <vulkan/vulkan.hpp>
 
 #include "asset.hpp"
+#include "shaderCache.hpp"
 #include "vertex.hpp"
 
 /** This enum holds a few variables used in this file.*/
@@ -36,7 +37,7 @@ public:
     }
 
     /***/
-    void setup(VulkanGraphicsEngineLink *engineLink, const std::vector<VkDescriptorType>& setupDescriptorTypes, const std::vector<VkShaderStageFlagBits>& setupShaderFlags, uint32_t setupSwapchainImageCount, VkRenderPass renderPass, std::vector<std::vector<char>> shaderData) {
+    void setup(VulkanGraphicsEngineLink *engineLink, const std::vector<VkDescriptorType>& setupDescriptorTypes, const std::vector<VkShaderStageFlagBits>& setupShaderFlags, uint32_t setupSwapchainImageCount, VkRenderPass renderPass, const std::vector<ShaderCache::Spirv> &shaderData) {
         linkedRenderEngine = engineLink;
         //create descriptor layout
         if (setupDescriptorTypes.size() != setupShaderFlags.size()) { throw std::runtime_error("number of descriptor types does not equal number of shader flags!"); }
@@ -81,8 +82,8 @@ public:
         for (unsigned int i = 0; i < shaderData.size(); i++) {
             VkShaderModule shaderModule;
             VkShaderModuleCreateInfo shaderModuleCreateInfo{VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
-            shaderModuleCreateInfo.codeSize = shaderData[i].size();
-            shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t *>(shaderData[i].data());
+            shaderModuleCreateInfo.codeSize = shaderData[i]->size();
+            shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t *>(shaderData[i]->data());
             if (vkCreateShaderModule(linkedRenderEngine->device->device, &shaderModuleCreateInfo, nullptr, &shaderModule) != VK_SUCCESS) { throw std::runtime_error("failed to create shader module!"); }
             VkPipelineShaderStageCreateInfo shaderStageInfo{VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
             shaderStageInfo.module = shaderModule;
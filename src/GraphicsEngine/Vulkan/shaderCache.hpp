@@ -0,0 +1,212 @@
+#pragma once
+
+#if defined(_WIN32)
+#define GLSLC "glslc.exe "
+#else
+#define GLSLC "glslc "
+#endif
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../../Core/mappedFile.hpp"
+
+/** This class compiles GLSL shaders to SPIR-V only when they have changed. Every shader is keyed by a hash of its source, the source of every file it includes, its stage, and the compiler options, and the SPIR-V is kept on disk under that key, so an unchanged shader is read back instead of compiled, whichever file or asset it is loaded from. Loaded SPIR-V is also kept in memory and shared by every asset using it, and a shader that several threads ask for at once is only compiled by the first of them.*/
+class ShaderCache {
+public:
+    /** This is the SPIR-V of one shader, shared by everything that loaded it.*/
+    using Spirv = std::shared_ptr<const std::vector<char>>;
+
+    /** This is bumped whenever the way shaders are compiled changes, which makes every existing cache stale.*/
+    static constexpr uint32_t version = 1;
+
+    /** This is the folder compiled shaders are kept in.*/
+    static inline std::filesystem::path directory{"ShaderCache"};
+    /** These are extra options passed to the compiler, such as "-O" or "-DSHADOWS". They are part of every key.*/
+    static inline std::string options{};
+    /** These are the folders searched for files included with angle brackets, passed to the compiler as -I.*/
+    static inline std::vector<std::filesystem::path> includeDirectories{};
+
+    /** This method loads the SPIR-V of a shader from memory, then from disk, and compiles it only if neither has it.
+     * @param shaderName This is the filename of the GLSL shader. Its extension gives its stage.
+     * @return The SPIR-V of the shader.*/
+    static Spirv load(const std::filesystem::path &shaderName) {
+        uint64_t key = hashShader(shaderName);
+        std::promise<Spirv> promise;
+        std::shared_future<Spirv> loaded;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto [entry, inserted] = modules.try_emplace(key);
+            if (!inserted) { loaded = entry->second; }
+            else { entry->second = promise.get_future().share(); }
+        }
+        //another thread already has this shader, or is compiling it
+        if (loaded.valid()) { return loaded.get(); }
+        try {
+            Spirv spirv = read(cachePath(key));
+            if (spirv == nullptr) { spirv = compile(shaderName, key); }
+            promise.set_value(spirv);
+            return spirv;
+        } catch (...) {
+            {
+                //forget the failure, so that a later load tries again
+                std::lock_guard<std::mutex> lock(mutex);
+                modules.erase(key);
+            }
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+    }
+
+    /** This method finds where the compiled shader with a key is kept.
+     * @param key This is the key of the shader, as given by hashShader.
+     * @return The name of the SPIR-V file.*/
+    static std::filesystem::path cachePath(uint64_t key) {
+        char name[17];
+        for (int i = 15; i >= 0; --i, key >>= 4) { name[i] = "0123456789abcdef"[key & 15]; }
+        name[16] = '\0';
+        return directory / (std::string(name) + ".spv");
+    }
+
+    /** This method hashes everything that decides what a shader compiles to: the source of the shader and of every file it includes, its stage, the compiler, and the options.
+     * @param shaderName This is the filename of the GLSL shader.
+     * @return The key of the shader.*/
+    static uint64_t hashShader(const std::filesystem::path &shaderName) {
+        std::string settings = std::to_string(version) + "\n" + GLSLC + options + "\n" + shaderName.extension().string();
+        for (const std::filesystem::path &includeDirectory : includeDirectories) { settings += "\n" + includeDirectory.string(); }
+        uint64_t hash = hashBytes(settings.data(), settings.size(), offsetBasis);
+        std::unordered_set<std::string> visited{};
+        return hashSource(shaderName, hash, visited);
+    }
+
+    /** This method forgets every shader kept in memory. Shaders kept on disk are untouched.*/
+    static void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        modules.clear();
+    }
+
+private:
+    static constexpr uint64_t offsetBasis = 14695981039346656037ull;
+    static constexpr uint64_t prime = 1099511628211ull;
+    static constexpr uint32_t spirvMagic = 0x07230203;
+
+    static inline std::mutex mutex{};
+    static inline std::unordered_map<uint64_t, std::shared_future<Spirv>> modules{};
+
+    /** This method folds bytes into a 64 bit FNV-1a hash, eight bytes at a time.*/
+    static uint64_t hashBytes(const void *data, size_t size, uint64_t hash) {
+        const auto *bytes = static_cast<const uint8_t *>(data);
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, bytes + i, 8);
+            hash = (hash ^ word) * prime;
+        }
+        for (; i < size; ++i) { hash = (hash ^ bytes[i]) * prime; }
+        return (hash ^ size) * prime;
+    }
+
+    /** This method folds the source of a file, then of every file it includes, into a hash. Each file is folded in once, and an include that cannot be found folds in only its name, which is enough since compiling it fails.*/
+    static uint64_t hashSource(const std::filesystem::path &fileName, uint64_t hash, std::unordered_set<std::string> &visited) {
+        if (!visited.insert(std::filesystem::absolute(fileName).lexically_normal().string()).second) { return hash; }
+        MappedFile file(fileName);
+        if (file.data() == nullptr && !std::filesystem::exists(fileName)) { throw std::runtime_error("failed to open shader file: " + fileName.string()); }
+        hash = hashBytes(file.data(), file.size(), hash);
+        const char *source = reinterpret_cast<const char *>(file.data()), *end = source + file.size();
+        for (const char *line = source; line < end;) {
+            const char *next = static_cast<const char *>(std::memchr(line, '\n', (size_t)(end - line)));
+            next = next == nullptr ? end : next + 1;
+            std::string name{};
+            bool angled{};
+            if (includedName(line, next, name, angled)) {
+                hash = hashBytes(name.data(), name.size(), hash);
+                std::filesystem::path included = findInclude(fileName, name, angled);
+                if (!included.empty()) { hash = hashSource(included, hash, visited); }
+            }
+            line = next;
+        }
+        return hash;
+    }
+
+    /** This method reads the name out of a line of the form #include "name" or #include <name>.
+     * @return Whether the line is an include.*/
+    static bool includedName(const char *line, const char *end, std::string &name, bool &angled) {
+        auto skipSpaces = [&] { while (line < end && (*line == ' ' || *line == '\t')) { ++line; } };
+        skipSpaces();
+        if (line == end || *line++ != '#') { return false; }
+        skipSpaces();
+        if ((size_t)(end - line) < 7 || std::memcmp(line, "include", 7) != 0) { return false; }
+        line += 7;
+        skipSpaces();
+        if (line == end || (*line != '"' && *line != '<')) { return false; }
+        angled = *line == '<';
+        const char *close = static_cast<const char *>(std::memchr(line + 1, angled ? '>' : '"', (size_t)(end - line - 1)));
+        if (close == nullptr) { return false; }
+        name.assign(line + 1, close);
+        return true;
+    }
+
+    /** This method finds an included file the way the compiler does: next to the file including it for quotes, then in every include folder.
+     * @return The included file, or nothing if it cannot be found.*/
+    static std::filesystem::path findInclude(const std::filesystem::path &includer, const std::string &name, bool angled) {
+        std::error_code error;
+        if (!angled) {
+            std::filesystem::path candidate = includer.parent_path() / name;
+            if (std::filesystem::is_regular_file(candidate, error)) { return candidate; }
+        }
+        for (const std::filesystem::path &includeDirectory : includeDirectories) {
+            std::filesystem::path candidate = includeDirectory / name;
+            if (std::filesystem::is_regular_file(candidate, error)) { return candidate; }
+        }
+        return {};
+    }
+
+    /** This method reads a compiled shader.
+     * @return The SPIR-V, or nothing if the file is missing or is not SPIR-V.*/
+    static Spirv read(const std::filesystem::path &path) {
+        MappedFile file(path);
+        uint32_t magic{};
+        if (file.size() < sizeof(uint32_t) * 5 || file.size() % sizeof(uint32_t) != 0) { return nullptr; }
+        std::memcpy(&magic, file.data(), sizeof(uint32_t));
+        if (magic != spirvMagic) { return nullptr; }
+        return std::make_shared<const std::vector<char>>(reinterpret_cast<const char *>(file.data()), reinterpret_cast<const char *>(file.data()) + file.size());
+    }
+
+    /** This method compiles a shader into the cache. The compiler writes to a temporary file of the calling thread's own, which is then renamed into place, so that a reader never sees half a shader.
+     * @return The SPIR-V of the shader.*/
+    static Spirv compile(const std::filesystem::path &shaderName, uint64_t key) {
+        std::filesystem::path path = cachePath(key), temporary = path;
+        temporary += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        std::string command = GLSLC + options;
+        for (const std::filesystem::path &includeDirectory : includeDirectories) { command += " -I \"" + includeDirectory.string() + "\""; }
+        command += " \"" + shaderName.string() + "\" -o \"" + temporary.string() + "\"";
+        if (system(command.c_str()) != 0) {
+            std::filesystem::remove(temporary, error);
+            throw std::runtime_error("failed to compile shader: " + shaderName.string());
+        }
+        Spirv spirv = read(temporary);
+        if (spirv == nullptr) {
+            std::filesystem::remove(temporary, error);
+            throw std::runtime_error("failed to read compiled shader: " + shaderName.string());
+        }
+        std::filesystem::rename(temporary, path, error);
+        //a cache that cannot be written only costs the next run a compile
+        if (error) { std::filesystem::remove(temporary, error); }
+        return spirv;
+    }
+};
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
+#include <cstring>
 
 #include <vulkan/vulkan.hpp>
 
@@ -43,7 +45,21 @@ public:
         return attributeDescriptions;
     }
 
-    bool operator==(const Vertex &other) const { return pos == other.pos && color == other.color && texCoord == other.texCoord; }
+    bool operator==(const Vertex &other) const { return pos == other.pos && color == other.color && texCoord == other.texCoord && normal == other.normal; }
 };
 
-template<> struct std::hash<Vertex> { size_t operator()(Vertex const& vertex) const { return hash<glm::vec3>()(vertex.pos); } };
\ No newline at end of file
+/** This hashes every attribute of a vertex, so that vertices that share a position but not a seam, color, or normal land in different buckets. Negative zero is hashed as zero, since the two compare equal.*/
+template<> struct std::hash<Vertex> {
+    size_t operator()(Vertex const& vertex) const {
+        const float attributes[]{vertex.pos.x, vertex.pos.y, vertex.pos.z, vertex.color.r, vertex.color.g, vertex.color.b, vertex.texCoord.x, vertex.texCoord.y, vertex.normal.x, vertex.normal.y, vertex.normal.z};
+        uint64_t hash = 0;
+        for (float attribute : attributes) {
+            attribute += 0.0f;
+            uint32_t bits;
+            std::memcpy(&bits, &attribute, sizeof(bits));
+            hash = (hash ^ bits) * 0x9E3779B97F4A7C15ull;
+            hash ^= hash >> 29;
+        }
+        return static_cast<size_t>(hash ^ hash >> 32);
+    }
+};
\ No newline at end of file
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <algorithm>
 #include <deque>
 #include <functional>
+#include <memory>
+#include <utility>
 #include <vector>
 
 #include <VkBootstrap.h>
@@ -124,6 +127,10 @@ protected:
         //delete staging buffer
         scratchBuffer.setEngineLink(&renderEngineLink);
         engineDeletionQueue.emplace_front([&] { scratchBuffer.destroy(); });
+        //create the instance transform buffer, which is persistently mapped and holds one region of model matrices per frame in flight
+        instanceBuffer.setEngineLink(&renderEngineLink);
+        instanceBuffer.create(sizeof(glm::mat4) * settings.maxInstances * settings.MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        engineDeletionQueue.emplace_front([&] { instanceBuffer.destroy(); });
         createSwapchain(true);
         renderEngineLink.build();
     }
@@ -196,14 +203,72 @@ protected:
     VkPipelineLayout pipelineLayout{};
     RenderPassManager renderPassManager{};
     VulkanGraphicsEngineLink renderEngineLink{};
+    BufferManager instanceBuffer{};
+    uint32_t reservedInstances{};
+    /** These are the assets given to uploadAsset before they had loaded.*/
+    std::vector<Asset *> loadingAssets{};
+    /** These are the assets whose files are being reloaded, each with the asset they are loading into.*/
+    std::vector<std::pair<Asset *, std::shared_ptr<Asset>>> reloadingAssets{};
+
+    /** This method finds the first instance to draw an asset with, so that gl_InstanceIndex indexes the current frame's region of the instance transform buffer, or of the asset's own buffer if its instances are packed.
+     * @param asset This is the asset being drawn.
+     * @return The first instance.*/
+    uint32_t firstInstance(const Asset *asset) const {
+        if (asset->packedInstances) { return static_cast<uint32_t>(currentFrame) * asset->instanceCount; }
+        return static_cast<uint32_t>(currentFrame) * settings.maxInstances + asset->instanceIndex;
+    }
+
+    /** This method uploads the assets that have finished loading since the last frame and swaps in the files of finished reloads, leaving the rest to load, so that the frame loop never waits on a file.*/
+    void uploadLoadedAssets() {
+        for (size_t i = 0; i < loadingAssets.size();) {
+            if (!loadingAssets[i]->ready()) {
+                ++i;
+                continue;
+            }
+            Asset *asset = loadingAssets[i];
+            loadingAssets.erase(loadingAssets.begin() + (std::ptrdiff_t)i);
+            uploadAsset(asset, false);
+            assets.push_back(asset);
+        }
+        for (size_t i = 0; i < reloadingAssets.size();) {
+            if (!reloadingAssets[i].second->ready()) {
+                ++i;
+                continue;
+            }
+            //the asset's old buffers may still be drawn by frames in flight
+            vkDeviceWaitIdle(device.device);
+            reloadingAssets[i].first->adopt(*reloadingAssets[i].second);
+            uploadAsset(reloadingAssets[i].first, false);
+            reloadingAssets.erase(reloadingAssets.begin() + (std::ptrdiff_t)i);
+        }
+    }
 
 public:
+    /** This method uploads an asset's mesh, textures, and shaders, building its pipeline.
+     * An asset that is still loading has its instance slots reserved right away, so that its transforms can be written, and is uploaded and drawn from the first frame after it has loaded.
+     * @param asset This is the asset to upload.
+     * @param append This variable tells the method to add the asset to the ones drawn every frame.*/
     virtual void uploadAsset(Asset *asset, bool append) {
+        if (append && !asset->packedInstances) { asset->instanceIndex = reserveInstances(asset->instanceCount); }
+        //packed instances get a buffer of their own, with one region per frame in flight as the instance transform buffer has. Like that buffer it lives as long as the engine, so that it can be written while the asset loads and survives reuploads.
+        if (append && asset->packedInstances) {
+            asset->packedInstanceBuffer.setEngineLink(&renderEngineLink);
+            asset->packedInstanceBuffer.create(sizeof(glm::vec4) * std::max(asset->instanceCount, 1u) * settings.MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+            engineDeletionQueue.emplace_front([asset] { asset->packedInstanceBuffer.destroy(); });
+        }
+        if (append && !asset->ready()) {
+            loadingAssets.push_back(asset);
+            return;
+        }
+        asset->wait();
         //destroy previously created asset if any
         asset->destroy();
         //upload mesh, vertex, and transformation data
         asset->vertexBuffer.setEngineLink(&renderEngineLink);
-        memcpy(asset->vertexBuffer.create(sizeof(asset->vertices[0]) * asset->vertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU), asset->vertices.data(), sizeof(asset->vertices[0]) * asset->vertices.size());
+        size_t vertexBytes = sizeof(asset->vertices[0]) * asset->vertices.size();
+        size_t vertexRegions = asset->dynamicVertices ? settings.MAX_FRAMES_IN_FLIGHT : 1;
+        auto *vertexData = static_cast<uint8_t *>(asset->vertexBuffer.create(vertexBytes * vertexRegions, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU));
+        for (size_t region = 0; region < vertexRegions; ++region) { memcpy(vertexData + region * vertexBytes, asset->vertices.data(), vertexBytes); }
         asset->deletionQueue.emplace_front([&](Asset thisAsset){ thisAsset.vertexBuffer.destroy(); });
         asset->indexBuffer.setEngineLink(&renderEngineLink);
         memcpy(asset->indexBuffer.create(sizeof(asset->indices[0]) * asset->indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU), asset->indices.data(), sizeof(asset->indices[0]) * asset->indices.size());
@@ -228,13 +293,65 @@ public:
         //build graphics pipeline and descriptor set for this asset
         asset->pipelineManagers.resize(1);
         for (unsigned int i = 0; i < asset->pipelineManagers.size(); ++i) {
-            asset->pipelineManagers[i].setup(&renderEngineLink, {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER}, {VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT}, swapchain.image_count, renderPassManager.renderPass, asset->shaderData);
-            asset->pipelineManagers[0].createDescriptorSet({asset->uniformBuffer}, {asset->textureImages[0]}, {BUFFER, IMAGE});
+            asset->pipelineManagers[i].setup(&renderEngineLink, {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER}, {VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT, VK_SHADER_STAGE_VERTEX_BIT}, swapchain.image_count, renderPassManager.renderPass, asset->shaderData);
+            asset->pipelineManagers[0].createDescriptorSet({asset->uniformBuffer, asset->packedInstances ? asset->packedInstanceBuffer : instanceBuffer}, {asset->textureImages[0]}, {BUFFER, IMAGE, BUFFER});
         }
         asset->deletionQueue.emplace_front([&](const Asset& thisAsset){ for (RasterizationPipelineManager pipelineManager : thisAsset.pipelineManagers) { pipelineManager.destroy(); } });
         if (append) { assets.push_back(asset); }
     }
 
+    /** This method reloads an asset's model, textures, and shaders. If the asset was loaded on a thread pool the files are loaded on it again while the asset is still drawn as it was, and uploaded in its place once they have loaded. Otherwise they are loaded and uploaded right away.
+     * @param asset This is an uploaded asset.*/
+    void reloadAsset(Asset *asset) {
+        if (asset->loadingPool == nullptr) {
+            asset->reloadAsset();
+            vkDeviceWaitIdle(device.device);
+            uploadAsset(asset, false);
+            return;
+        }
+        if (std::any_of(reloadingAssets.begin(), reloadingAssets.end(), [asset](const auto &reloading) { return reloading.first == asset; })) { return; }
+        reloadingAssets.emplace_back(asset, asset->reloadAsync(*asset->loadingPool));
+    }
+
+    /** This method reserves a contiguous run of slots in the instance transform buffer.
+     * @param count This is the number of slots to reserve.
+     * @return The first slot reserved.*/
+    uint32_t reserveInstances(uint32_t count) {
+        if (count > settings.maxInstances - reservedInstances) { throw std::runtime_error("instance transform buffer is full!"); }
+        reservedInstances += count;
+        return reservedInstances - count;
+    }
+
+    /** This method waits for the GPU to finish with the next frame's region of the instance transform buffer, then returns it so that model matrices can be written straight into it. Assets with external transforms must be written every frame, since each frame in flight has a region of its own.
+     * @return The model matrices of the next frame, indexed by instance slot.*/
+    glm::mat4 *instanceTransforms() {
+        vkWaitForFences(device.device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        return static_cast<glm::mat4 *>(instanceBuffer.data) + currentFrame * settings.maxInstances;
+    }
+
+    /** This method waits for the GPU to finish with the next frame's region of an asset's packed instance buffer, then returns it so that instances can be written straight into it, as the instance transforms are.
+     * @param asset This is an uploaded asset with packed instances.
+     * @return The instances of the next frame, instanceCount of them.*/
+    glm::vec4 *packedInstances(const Asset *asset) {
+        vkWaitForFences(device.device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        return static_cast<glm::vec4 *>(asset->packedInstanceBuffer.data) + currentFrame * asset->instanceCount;
+    }
+
+    /** This method waits for the GPU to finish with the next frame's region of an asset's vertex buffer, then returns it so that vertices can be written straight into it, as the instance transforms are. Only the positions and normals need writing, since every region starts as a copy of the asset's vertices.
+     * @param asset This is an uploaded asset with dynamic vertices.
+     * @return The vertices of the next frame.*/
+    Vertex *dynamicVertices(const Asset *asset) {
+        vkWaitForFences(device.device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        return static_cast<Vertex *>(asset->vertexBuffer.data) + currentFrame * asset->vertices.size();
+    }
+
+    /** This method finds where the current frame's region of an asset's vertex buffer starts.
+     * @param asset This is the asset being drawn.
+     * @return The offset in bytes.*/
+    VkDeviceSize vertexOffset(const Asset *asset) const {
+        return asset->dynamicVertices ? static_cast<VkDeviceSize>(currentFrame) * sizeof(Vertex) * asset->vertices.size() : 0;
+    }
+
     void updateSettings(bool updateAll) {
         //TODO: Fix view jerk when exiting fullscreen. - LOW PRIORITY
         if (settings.fullscreen) {
@@ -278,6 +395,7 @@ public:
     }
 
     GLFWmonitor *monitor{};
+    size_t currentFrame{};
     VulkanSettings settings{};
     Camera camera{&settings};
     GLFWwindow *window{};
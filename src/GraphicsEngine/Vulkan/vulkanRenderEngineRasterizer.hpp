@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <functional>
 #include <deque>
 
@@ -17,6 +18,7 @@ public:
     bool update() override {
         //GPU synchronization
         if (window == nullptr) { return false; }
+        uploadLoadedAssets();
         if (assets.empty()) { return glfwWindowShouldClose(window) != 1; }
         vkWaitForFences(device.device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
         uint32_t imageIndex = 0;
@@ -27,8 +29,6 @@ public:
         } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) { throw std::runtime_error("failed to acquire swapchain image!"); }
         if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) { vkWaitForFences(device.device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX); }
         imagesInFlight[imageIndex] = inFlightFences[currentFrame];
-        //update state of frame
-        VkDeviceSize offsets[] = {0};
         //record command buffers for color pass
         commandBufferManager.resetCommandBuffer((int)(imageIndex + (swapchain.image_count - 1)) % (int)swapchain.image_count);
         commandBufferManager.recordCommandBuffer((int)imageIndex);
@@ -53,16 +53,18 @@ public:
         VkRenderPassBeginInfo renderPassBeginInfo = renderPassManager.beginRenderPass(imageIndex);
         vkCmdBeginRenderPass(commandBufferManager.commandBuffers[imageIndex], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
         camera.update();
+        glm::mat4 *transforms = instanceTransforms();
         for (Asset *asset : assets) {
             if (asset->render) {
                 //update asset
-                asset->update(camera);
+                asset->update(camera, transforms);
                 //record command buffer for this asset
+                VkDeviceSize offsets[] = {vertexOffset(asset)};
                 vkCmdBindVertexBuffers(commandBufferManager.commandBuffers[imageIndex], 0, 1, &asset->vertexBuffer.buffer, offsets);
                 vkCmdBindIndexBuffer(commandBufferManager.commandBuffers[imageIndex], asset->indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
                 vkCmdBindDescriptorSets(commandBufferManager.commandBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, asset->pipelineManagers[0].pipelineLayout, 0, 1, &asset->pipelineManagers[0].descriptorSet, 0, nullptr);
                 vkCmdBindPipeline(commandBufferManager.commandBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, asset->pipelineManagers[0].pipeline);
-                vkCmdDrawIndexed(commandBufferManager.commandBuffers[imageIndex], static_cast<uint32_t>(asset->indices.size()), 1, 0, 0, 0);
+                vkCmdDrawIndexed(commandBufferManager.commandBuffers[imageIndex], static_cast<uint32_t>(asset->indices.size()), std::min(asset->drawnInstances, asset->instanceCount), 0, 0, firstInstance(asset));
             }
         }
         vkCmdEndRenderPass(commandBufferManager.commandBuffers[imageIndex]);
@@ -107,7 +109,6 @@ public:
         return glfwWindowShouldClose(window) != 1;
     }
 
-    size_t currentFrame{};
     bool framebufferResized{false};
     float previousTime{};
     float frameTime{};
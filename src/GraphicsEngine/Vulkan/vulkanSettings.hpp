@@ -33,6 +33,7 @@ public:
     int refreshRate{60};
     std::array<int, 2> resolution{defaultWindowResolution};
     int MAX_FRAMES_IN_FLIGHT{2};
+    uint32_t maxInstances{16384};
     double fov{90};
     double renderDistance{1000000};
     double mouseSensitivity{0.1};
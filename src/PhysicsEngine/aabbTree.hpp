@@ -0,0 +1,305 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+//an axis aligned bounding box
+struct AABB {
+    glm::vec3 min{};
+    glm::vec3 max{};
+
+    [[nodiscard]] bool contains(const AABB &other) const {
+        return glm::all(glm::lessThanEqual(min, other.min)) && glm::all(glm::greaterThanEqual(max, other.max));
+    }
+
+    [[nodiscard]] bool overlaps(const AABB &other) const {
+        return glm::all(glm::lessThanEqual(min, other.max)) && glm::all(glm::lessThanEqual(other.min, max));
+    }
+
+    [[nodiscard]] float surfaceArea() const {
+        glm::vec3 d = max - min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    static AABB merge(const AABB &a, const AABB &b) {
+        return {glm::min(a.min, b.min), glm::max(a.max, b.max)};
+    }
+};
+
+//a ray for scene queries. Hits further than maxT along direction are ignored.
+struct Ray {
+    glm::vec3 origin{};
+    glm::vec3 direction{};
+    float maxT{INFINITY};
+};
+
+//the closest hit of a ray. body is UINT32_MAX if the ray hit nothing.
+struct RayHit {
+    uint32_t body{UINT32_MAX};
+    float t{INFINITY};
+};
+
+//one result of an overlap query: the index of the query and the body it overlapped
+struct QueryHit {
+    uint32_t query;
+    uint32_t body;
+};
+
+//dynamic bounding volume hierarchy. Leaves hold fattened boxes so that small movements need no update at all, larger ones are refit in place, and the tree is kept shallow with surface area reducing rotations on the way back up.
+class DynamicAABBTree {
+public:
+    static constexpr int32_t nullNode = -1;
+
+    float margin{0.1f}; //how far a leaf's box is grown beyond the box it was given
+    float velocityScale{2.0f}; //how many ticks of movement a leaf's box is stretched to cover
+
+    //insert a box and return its proxy id
+    int32_t insert(const AABB &box, uint32_t userData, glm::vec3 displacement = {}) {
+        int32_t leaf = allocateNode();
+        nodes[leaf].box = fatten(box, displacement);
+        nodes[leaf].userData = userData;
+        nodes[leaf].height = 0;
+        insertLeaf(leaf);
+        return leaf;
+    }
+
+    void remove(int32_t proxy) {
+        removeLeaf(proxy);
+        freeNode(proxy);
+    }
+
+    //update a proxy's box. Returns true if the tree changed.
+    bool move(int32_t proxy, const AABB &box, glm::vec3 displacement = {}) {
+        if (nodes[proxy].box.contains(box)) { return false; }
+        AABB fat = fatten(box, displacement);
+        //boxes that moved a little are refit in place, boxes that jumped are reinserted where they now belong
+        if (nodes[proxy].box.overlaps(fat)) {
+            nodes[proxy].box = fat;
+            refit(nodes[proxy].parent);
+            return true;
+        }
+        removeLeaf(proxy);
+        nodes[proxy].box = fat;
+        insertLeaf(proxy);
+        return true;
+    }
+
+    [[nodiscard]] const AABB &getFatAABB(int32_t proxy) const {
+        return nodes[proxy].box;
+    }
+
+    [[nodiscard]] uint32_t getUserData(int32_t proxy) const {
+        return nodes[proxy].userData;
+    }
+
+    void setUserData(int32_t proxy, uint32_t userData) {
+        nodes[proxy].userData = userData;
+    }
+
+    [[nodiscard]] int32_t getHeight() const {
+        return root == nullNode ? 0 : nodes[root].height;
+    }
+
+    void clear() {
+        nodes.clear();
+        freeList = nullNode;
+        root = nullNode;
+    }
+
+    //call leafTest(userData, t) for every leaf whose box the ray passes through closer than the current best t. leafTest returns the exact distance to its object, or a negative number for a miss.
+    template<typename LeafTest> RayHit raycast(const Ray &ray, LeafTest leafTest) {
+        RayHit hit{UINT32_MAX, ray.maxT};
+        if (root == nullNode) { return hit; }
+        glm::vec3 inverseDirection = 1.0f / ray.direction;
+        stack.clear();
+        stack.push_back(root);
+        while (!stack.empty()) {
+            int32_t id = stack.back();
+            stack.pop_back();
+            const Node &node = nodes[id];
+            if (!rayHitsBox(ray.origin, inverseDirection, node.box, hit.t)) { continue; }
+            if (node.isLeaf()) {
+                float t = leafTest(node.userData);
+                if (t >= 0.0f && t < hit.t) { hit = {node.userData, t}; }
+                continue;
+            }
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+        return hit;
+    }
+
+    //call callback(userData) for every leaf whose box overlaps box
+    template<typename Callback> void query(const AABB &box, Callback callback) {
+        if (root == nullNode) { return; }
+        stack.clear();
+        stack.push_back(root);
+        while (!stack.empty()) {
+            const Node &node = nodes[stack.back()];
+            stack.pop_back();
+            if (!node.box.overlaps(box)) { continue; }
+            if (node.isLeaf()) { callback(node.userData); }
+            else {
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
+            }
+        }
+    }
+
+private:
+    struct Node {
+        AABB box{};
+        int32_t parent{nullNode}; //doubles as the next free node while the node is unused
+        int32_t child1{nullNode};
+        int32_t child2{nullNode};
+        int32_t height{}; //leaves are 0, unused nodes are -1
+        uint32_t userData{};
+
+        [[nodiscard]] bool isLeaf() const { return child1 == nullNode; }
+    };
+
+    std::vector<Node> nodes{};
+    std::vector<int32_t> stack{}; //traversal stack reused by every query
+    int32_t freeList{nullNode};
+    int32_t root{nullNode};
+
+    [[nodiscard]] AABB fatten(const AABB &box, glm::vec3 displacement) const {
+        AABB fat{box.min - margin, box.max + margin};
+        glm::vec3 d = displacement * velocityScale;
+        fat.min += glm::min(d, glm::vec3(0.0f));
+        fat.max += glm::max(d, glm::vec3(0.0f));
+        return fat;
+    }
+
+    int32_t allocateNode() {
+        if (freeList == nullNode) {
+            nodes.emplace_back();
+            return (int32_t)nodes.size() - 1;
+        }
+        int32_t id = freeList;
+        freeList = nodes[id].parent;
+        nodes[id] = Node{};
+        return id;
+    }
+
+    void freeNode(int32_t id) {
+        nodes[id].parent = freeList;
+        nodes[id].height = -1;
+        freeList = id;
+    }
+
+    void insertLeaf(int32_t leaf) {
+        if (root == nullNode) {
+            root = leaf;
+            nodes[root].parent = nullNode;
+            return;
+        }
+        //descend towards the sibling that would grow the total surface area least
+        AABB leafBox = nodes[leaf].box;
+        int32_t index = root;
+        while (!nodes[index].isLeaf()) {
+            const Node &node = nodes[index];
+            float area = node.box.surfaceArea();
+            float combinedArea = AABB::merge(node.box, leafBox).surfaceArea();
+            float cost = 2.0f * combinedArea; //cost of making a new parent for this node and the leaf
+            float inheritanceCost = 2.0f * (combinedArea - area); //minimum cost of pushing the leaf further down
+            float cost1 = descendCost(node.child1, leafBox) + inheritanceCost;
+            float cost2 = descendCost(node.child2, leafBox) + inheritanceCost;
+            if (cost < cost1 && cost < cost2) { break; }
+            index = cost1 < cost2 ? node.child1 : node.child2;
+        }
+        int32_t sibling = index;
+        int32_t oldParent = nodes[sibling].parent;
+        int32_t newParent = allocateNode();
+        nodes[newParent].parent = oldParent;
+        nodes[newParent].box = AABB::merge(leafBox, nodes[sibling].box);
+        nodes[newParent].height = nodes[sibling].height + 1;
+        nodes[newParent].child1 = sibling;
+        nodes[newParent].child2 = leaf;
+        nodes[sibling].parent = newParent;
+        nodes[leaf].parent = newParent;
+        if (oldParent == nullNode) { root = newParent; }
+        else if (nodes[oldParent].child1 == sibling) { nodes[oldParent].child1 = newParent; }
+        else { nodes[oldParent].child2 = newParent; }
+        refit(nodes[leaf].parent);
+    }
+
+    [[nodiscard]] float descendCost(int32_t child, const AABB &leafBox) const {
+        float combined = AABB::merge(leafBox, nodes[child].box).surfaceArea();
+        return nodes[child].isLeaf() ? combined : combined - nodes[child].box.surfaceArea();
+    }
+
+    void removeLeaf(int32_t leaf) {
+        if (leaf == root) {
+            root = nullNode;
+            return;
+        }
+        int32_t parent = nodes[leaf].parent;
+        int32_t grandParent = nodes[parent].parent;
+        int32_t sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+        if (grandParent == nullNode) {
+            root = sibling;
+            nodes[sibling].parent = nullNode;
+        } else {
+            if (nodes[grandParent].child1 == parent) { nodes[grandParent].child1 = sibling; }
+            else { nodes[grandParent].child2 = sibling; }
+            nodes[sibling].parent = grandParent;
+            refit(grandParent);
+        }
+        freeNode(parent);
+    }
+
+    //walk from index to the root, recomputing boxes and heights and rotating wherever that shrinks the tree
+    void refit(int32_t index) {
+        while (index != nullNode) {
+            rotate(index);
+            Node &node = nodes[index];
+            node.box = AABB::merge(nodes[node.child1].box, nodes[node.child2].box);
+            node.height = 1 + std::max(nodes[node.child1].height, nodes[node.child2].height);
+            index = node.parent;
+        }
+    }
+
+    //try swapping each child of index with each grandchild under its other child, and keep the swap that most reduces the surface area of the child whose subtree changes
+    void rotate(int32_t index) {
+        int32_t best = 0;
+        float bestGain = 0.0f;
+        int32_t children[2] = {nodes[index].child1, nodes[index].child2};
+        for (int32_t side = 0; side < 2; ++side) {
+            int32_t uncle = children[side], parent = children[1 - side];
+            if (nodes[parent].isLeaf()) { continue; }
+            int32_t grandChildren[2] = {nodes[parent].child1, nodes[parent].child2};
+            float area = nodes[parent].box.surfaceArea();
+            for (int32_t g = 0; g < 2; ++g) {
+                //swapping uncle with grandChildren[g] leaves parent holding uncle and the other grandchild
+                float gain = area - AABB::merge(nodes[uncle].box, nodes[grandChildren[1 - g]].box).surfaceArea();
+                if (gain > bestGain) {
+                    bestGain = gain;
+                    best = 1 + side * 2 + g;
+                }
+            }
+        }
+        if (best == 0) { return; }
+        int32_t side = (best - 1) / 2, g = (best - 1) % 2;
+        int32_t uncle = children[side], parent = children[1 - side];
+        int32_t grandChild = g == 0 ? nodes[parent].child1 : nodes[parent].child2;
+        if (side == 0) { nodes[index].child1 = grandChild; } else { nodes[index].child2 = grandChild; }
+        if (g == 0) { nodes[parent].child1 = uncle; } else { nodes[parent].child2 = uncle; }
+        nodes[grandChild].parent = index;
+        nodes[uncle].parent = parent;
+        Node &p = nodes[parent];
+        p.box = AABB::merge(nodes[p.child1].box, nodes[p.child2].box);
+        p.height = 1 + std::max(nodes[p.child1].height, nodes[p.child2].height);
+    }
+
+    static bool rayHitsBox(glm::vec3 origin, glm::vec3 inverseDirection, const AABB &box, float maxT) {
+        glm::vec3 t1 = (box.min - origin) * inverseDirection;
+        glm::vec3 t2 = (box.max - origin) * inverseDirection;
+        glm::vec3 tMin = glm::min(t1, t2), tMax = glm::max(t1, t2);
+        float enter = std::max({tMin.x, tMin.y, tMin.z, 0.0f});
+        float exit = std::min({tMax.x, tMax.y, tMax.z, maxT});
+        return enter <= exit;
+    }
+};
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+//a stable reference to a body in a world. Bodies move within the store as others are removed, but a handle keeps finding its body, and a handle to a removed body is known to be stale instead of finding whichever body took its place.
+struct BodyHandle {
+    uint32_t slot{UINT32_MAX};
+    uint32_t generation{};
+
+    bool operator==(const BodyHandle &other) const {
+        return slot == other.slot && generation == other.generation;
+    }
+
+    bool operator!=(const BodyHandle &other) const {
+        return !(*this == other);
+    }
+};
+
+//maps handles to the current index of their body in a store. Slots of removed bodies are reused with their generation bumped, so that old handles to them go stale. Nothing is allocated once the registry has held as many bodies as it does now.
+class BodyRegistry {
+public:
+    static constexpr uint32_t invalidIndex = UINT32_MAX;
+
+    void reserve(size_t count) {
+        slots.reserve(count);
+        freeSlots.reserve(count);
+        slotOfBody.reserve(count);
+    }
+
+    void clear() {
+        slots.clear();
+        freeSlots.clear();
+        slotOfBody.clear();
+    }
+
+    //register the body just appended to the store at index body
+    BodyHandle add(uint32_t body) {
+        uint32_t slot;
+        if (freeSlots.empty()) {
+            slot = (uint32_t)slots.size();
+            slots.push_back({body, 0});
+        } else {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+            slots[slot].body = body;
+        }
+        slotOfBody.push_back(slot);
+        return {slot, slots[slot].generation};
+    }
+
+    //forget the body at index body, after the store moved its last body, from index last, into its place
+    void remove(uint32_t body, uint32_t last) {
+        uint32_t slot = slotOfBody[body];
+        slots[slot].body = invalidIndex;
+        ++slots[slot].generation;
+        freeSlots.push_back(slot);
+        if (body != last) {
+            slotOfBody[body] = slotOfBody[last];
+            slots[slotOfBody[body]].body = body;
+        }
+        slotOfBody.pop_back();
+    }
+
+    //the index of handle's body in the store, or invalidIndex if the body was removed
+    [[nodiscard]] uint32_t indexOf(BodyHandle handle) const {
+        if (handle.slot >= slots.size() || slots[handle.slot].generation != handle.generation) { return invalidIndex; }
+        return slots[handle.slot].body;
+    }
+
+    [[nodiscard]] BodyHandle handleOf(uint32_t body) const {
+        uint32_t slot = slotOfBody[body];
+        return {slot, slots[slot].generation};
+    }
+
+    //the number of bytes write needs
+    [[nodiscard]] size_t serializedSize() const {
+        return 3 * sizeof(uint32_t) + slots.size() * sizeof(Slot) + (freeSlots.size() + slotOfBody.size()) * sizeof(uint32_t);
+    }
+
+    //copy every slot to out, and return the end of what was written
+    uint8_t *write(uint8_t *out) const {
+        out = writeArray(out, slots);
+        out = writeArray(out, freeSlots);
+        return writeArray(out, slotOfBody);
+    }
+
+    //check that [in, end) starts with slots written by write for a store of bodyCount bodies, without changing anything. Returns the end of them, or null if an array runs past end or an index points outside the slots or the store.
+    [[nodiscard]] static const uint8_t *validate(const uint8_t *in, const uint8_t *end, size_t bodyCount) {
+        const uint8_t *slotData = in;
+        uint32_t slotCount{};
+        if (!arrayFits<Slot>(in, end, slotCount)) { return nullptr; }
+        for (uint32_t i = 0; i < slotCount; ++i) {
+            Slot slot;
+            std::memcpy(&slot, slotData + sizeof(uint32_t) + i * sizeof(Slot), sizeof(Slot));
+            if (slot.body != invalidIndex && slot.body >= bodyCount) { return nullptr; }
+        }
+        for (int array = 0; array < 2; ++array) {
+            const uint8_t *indexData = in;
+            uint32_t count{};
+            if (!arrayFits<uint32_t>(in, end, count) || (array == 1 && count != bodyCount)) { return nullptr; }
+            for (uint32_t i = 0; i < count; ++i) {
+                uint32_t slot;
+                std::memcpy(&slot, indexData + sizeof(uint32_t) + i * sizeof(uint32_t), sizeof(slot));
+                if (slot >= slotCount) { return nullptr; }
+            }
+        }
+        return in;
+    }
+
+    //replace every slot with ones written by write. Returns the end of what was read, or null, changing nothing, if validate fails.
+    const uint8_t *read(const uint8_t *in, const uint8_t *end, size_t bodyCount) {
+        if (validate(in, end, bodyCount) == nullptr) { return nullptr; }
+        in = readArray(in, slots);
+        in = readArray(in, freeSlots);
+        return readArray(in, slotOfBody);
+    }
+
+private:
+    struct Slot {
+        uint32_t body; //the index of the body in the store, or invalidIndex if the slot is free
+        uint32_t generation; //bumped whenever the slot's body is removed
+    };
+
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+    std::vector<uint32_t> slotOfBody; //the slot of each body in the store
+
+    template<typename T> static uint8_t *writeArray(uint8_t *out, const std::vector<T> &array) {
+        auto count = (uint32_t)array.size();
+        std::memcpy(out, &count, sizeof(count));
+        if (count != 0) { std::memcpy(out + sizeof(count), array.data(), count * sizeof(T)); }
+        return out + sizeof(count) + count * sizeof(T);
+    }
+
+    //step in past an array written by writeArray, if all of it lies before end
+    template<typename T> static bool arrayFits(const uint8_t *&in, const uint8_t *end, uint32_t &count) {
+        if ((size_t)(end - in) < sizeof(count)) { return false; }
+        std::memcpy(&count, in, sizeof(count));
+        if ((size_t)(end - in - sizeof(count)) / sizeof(T) < count) { return false; }
+        in += sizeof(count) + count * sizeof(T);
+        return true;
+    }
+
+    template<typename T> static const uint8_t *readArray(const uint8_t *in, std::vector<T> &array) {
+        uint32_t count;
+        std::memcpy(&count, in, sizeof(count));
+        array.resize(count);
+        if (count != 0) { std::memcpy(array.data(), in + sizeof(count), count * sizeof(T)); }
+        return in + sizeof(count) + count * sizeof(T);
+    }
+};
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__AVX__) && !defined(CRYSTAL_ENGINE_PHYSICS_SCALAR)
+#include <immintrin.h>
+#define CRYSTAL_ENGINE_PHYSICS_AVX
+#elif defined(__SSE2__) && !defined(CRYSTAL_ENGINE_PHYSICS_SCALAR)
+#include <emmintrin.h>
+#define CRYSTAL_ENGINE_PHYSICS_SSE
+#endif
+
+//the state of a single body, used by bodies that have not been added to a world yet
+struct BodyState {
+    glm::vec3 pos{}; //position
+    glm::vec3 v{}; //velocity
+    float m{}; //mass
+    glm::vec3 rot{}; //angular position
+    glm::vec3 rotV{}; //angular velocity
+    float r{}; //radius, zero for bodies that are not spheres
+};
+
+//structure-of-arrays storage for every body in a world. Each attribute of each axis gets its own contiguous array so that the integration kernel can stream through them.
+class BodyStore {
+public:
+    std::vector<float> posX, posY, posZ; //positions
+    std::vector<float> vX, vY, vZ; //velocities
+    std::vector<float> m; //masses
+    std::vector<float> invM; //inverse masses, zero for bodies with no mass
+    std::vector<float> rotX, rotY, rotZ; //angular positions
+    std::vector<float> rotVX, rotVY, rotVZ; //angular velocities
+    std::vector<float> r; //radii
+    std::vector<float> prevPosX, prevPosY, prevPosZ; //positions before the last tick of the last update
+    std::vector<float> prevRotX, prevRotY, prevRotZ; //angular positions before the last tick of the last update
+    float alpha{1.0f}; //how far between the previous and current state the renderer is, from 0 to 1
+    std::vector<uint8_t> asleep; //whether each body is asleep. Sleeping bodies are not integrated, and their velocities are ignored.
+    std::vector<float> sleepTimer; //how long each body has been slow enough to sleep
+    std::vector<uint32_t> sleepNext; //the next body in the ring of bodies that fell asleep together, or the body itself
+
+    [[nodiscard]] size_t size() const {
+        return posX.size();
+    }
+
+    void reserve(size_t count) {
+        for (std::vector<float> *array : arrays()) { array->reserve(count); }
+        asleep.reserve(count);
+        sleepNext.reserve(count);
+    }
+
+    void clear() {
+        for (std::vector<float> *array : arrays()) { array->clear(); }
+        asleep.clear();
+        sleepNext.clear();
+    }
+
+    //append a body and return its index
+    uint32_t add(const BodyState &state) {
+        posX.push_back(state.pos.x); posY.push_back(state.pos.y); posZ.push_back(state.pos.z);
+        vX.push_back(state.v.x); vY.push_back(state.v.y); vZ.push_back(state.v.z);
+        m.push_back(state.m);
+        invM.push_back(state.m == 0.0f ? 0.0f : 1.0f / state.m);
+        rotX.push_back(state.rot.x); rotY.push_back(state.rot.y); rotZ.push_back(state.rot.z);
+        rotVX.push_back(state.rotV.x); rotVY.push_back(state.rotV.y); rotVZ.push_back(state.rotV.z);
+        r.push_back(state.r);
+        prevPosX.push_back(state.pos.x); prevPosY.push_back(state.pos.y); prevPosZ.push_back(state.pos.z);
+        prevRotX.push_back(state.rot.x); prevRotY.push_back(state.rot.y); prevRotZ.push_back(state.rot.z);
+        asleep.push_back(0);
+        sleepTimer.push_back(0.0f);
+        sleepNext.push_back(static_cast<uint32_t>(size() - 1));
+        return static_cast<uint32_t>(size() - 1);
+    }
+
+    //remove body i by moving the last body into its place, and return the index the last body was moved from. Body i is woken first, so that nothing that fell asleep with it stays asleep without it.
+    uint32_t remove(uint32_t i) {
+        wake(i);
+        auto last = static_cast<uint32_t>(size() - 1);
+        if (i != last) {
+            for (std::vector<float> *array : arrays()) { (*array)[i] = (*array)[last]; }
+            asleep[i] = asleep[last];
+            //the body before last in its sleep ring now points at last's new index
+            if (sleepNext[last] == last) { sleepNext[i] = i; }
+            else {
+                uint32_t before = last;
+                while (sleepNext[before] != last) { before = sleepNext[before]; }
+                sleepNext[before] = i;
+                sleepNext[i] = sleepNext[last];
+            }
+        }
+        for (std::vector<float> *array : arrays()) { array->pop_back(); }
+        asleep.pop_back();
+        sleepNext.pop_back();
+        return last;
+    }
+
+    [[nodiscard]] BodyState get(uint32_t i) const {
+        return {{posX[i], posY[i], posZ[i]}, {vX[i], vY[i], vZ[i]}, m[i], {rotX[i], rotY[i], rotZ[i]}, {rotVX[i], rotVY[i], rotVZ[i]}, r[i]};
+    }
+
+    //the number of bytes write needs
+    [[nodiscard]] size_t serializedSize() const {
+        return sizeof(uint32_t) + size() * (arraysOf(*this).size() * sizeof(float) + sizeof(uint8_t) + sizeof(uint32_t));
+    }
+
+    //copy every body to out, one bulk copy per array, and return the end of what was written
+    uint8_t *write(uint8_t *out) const {
+        auto count = static_cast<uint32_t>(size());
+        out = copy(out, &count, sizeof(count));
+        for (const std::vector<float> *array : arraysOf(*this)) { out = copy(out, array->data(), count * sizeof(float)); }
+        out = copy(out, asleep.data(), count * sizeof(uint8_t));
+        return copy(out, sleepNext.data(), count * sizeof(uint32_t));
+    }
+
+    //check that [in, end) starts with bodies written by write for a store of this size, without changing anything. Returns the end of them, or null if they run past end, their count differs, or the sleep rings are broken: wake and remove walk a ring until it closes, so every body must be in exactly one ring, and every ring must be either all asleep or a single awake body pointing at itself.
+    [[nodiscard]] const uint8_t *validate(const uint8_t *in, const uint8_t *end) const {
+        uint32_t count;
+        if ((size_t)(end - in) < sizeof(count)) { return nullptr; }
+        std::memcpy(&count, in, sizeof(count));
+        in += sizeof(count);
+        size_t bytesPerBody = arraysOf(*this).size() * sizeof(float) + sizeof(uint8_t) + sizeof(uint32_t);
+        if (count != size() || (size_t)(end - in) / bytesPerBody < count) { return nullptr; }
+        const uint8_t *flags = in + count * arraysOf(*this).size() * sizeof(float), *rings = flags + count * sizeof(uint8_t);
+        std::vector<uint32_t> next(count);
+        if (count != 0) { std::memcpy(next.data(), rings, count * sizeof(uint32_t)); }
+        std::vector<uint8_t> seen(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            if (flags[i] > 1 || next[i] >= count) { return nullptr; }
+            if (!flags[i] && next[i] != i) { return nullptr; }
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            if (seen[i]) { continue; }
+            //a body already seen can only be reached from inside its own ring, so reaching one before closing means two rings join
+            uint32_t body = i;
+            do {
+                if (seen[body] || flags[body] != flags[i]) { return nullptr; }
+                seen[body] = 1;
+                body = next[body];
+            } while (body != i);
+        }
+        return rings + count * sizeof(uint32_t);
+    }
+
+    //overwrite every body with ones written by write. The store must hold as many bodies as were written, since bodies added since then would be left without state. Returns the end of what was read, or null, changing nothing, if validate fails.
+    const uint8_t *read(const uint8_t *in, const uint8_t *end) {
+        if (validate(in, end) == nullptr) { return nullptr; }
+        uint32_t count;
+        std::memcpy(&count, in, sizeof(count));
+        in += sizeof(count);
+        for (std::vector<float> *array : arrays()) { in = copyIn(array->data(), in, count * sizeof(float)); }
+        in = copyIn(asleep.data(), in, count * sizeof(uint8_t));
+        return copyIn(sleepNext.data(), in, count * sizeof(uint32_t));
+    }
+
+    //put bodies to sleep together. Waking any of them later wakes them all.
+    void sleep(const uint32_t *bodies, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t body = bodies[i];
+            asleep[body] = 1;
+            sleepNext[body] = bodies[(i + 1) % count];
+            vX[body] = vY[body] = vZ[body] = 0.0f;
+            rotVX[body] = rotVY[body] = rotVZ[body] = 0.0f;
+        }
+    }
+
+    //wake body i and every body that fell asleep with it. Their velocities are zeroed, since anything written to them while asleep was ignored.
+    void wake(uint32_t i) {
+        if (!asleep[i]) { return; }
+        uint32_t body = i;
+        do {
+            uint32_t next = sleepNext[body];
+            asleep[body] = 0;
+            sleepTimer[body] = 0.0f;
+            sleepNext[body] = body;
+            vX[body] = vY[body] = vZ[body] = 0.0f;
+            rotVX[body] = rotVY[body] = rotVZ[body] = 0.0f;
+            body = next;
+        } while (body != i);
+    }
+
+    //remember the current positions and rotations so that the renderer can interpolate from them
+    void savePrevious() {
+        prevPosX = posX; prevPosY = posY; prevPosZ = posZ;
+        prevRotX = rotX; prevRotY = rotY; prevRotZ = rotZ;
+    }
+
+    //the position of body i blended alpha of the way from its previous position to its current one
+    [[nodiscard]] glm::vec3 interpolatedPosition(uint32_t i) const {
+        return glm::mix(glm::vec3(prevPosX[i], prevPosY[i], prevPosZ[i]), glm::vec3(posX[i], posY[i], posZ[i]), alpha);
+    }
+
+    [[nodiscard]] glm::vec3 interpolatedRotation(uint32_t i) const {
+        return glm::mix(glm::vec3(prevRotX[i], prevRotY[i], prevRotZ[i]), glm::vec3(rotX[i], rotY[i], rotZ[i]), alpha);
+    }
+
+    //advance bodies [begin, end) by dt using the widest kernel this build supports
+    void integrate(float dt, size_t begin = 0, size_t end = SIZE_MAX) {
+        if (end > size()) { end = size(); }
+        if (begin >= end) { return; }
+#if defined(CRYSTAL_ENGINE_PHYSICS_AVX)
+        begin = integrateAVX(dt, begin, end);
+#elif defined(CRYSTAL_ENGINE_PHYSICS_SSE)
+        begin = integrateSSE(dt, begin, end);
+#endif
+        integrateScalar(dt, begin, end);
+    }
+
+    //advance the bodies in [begin, end) that are awake, one contiguous run at a time so that the runs still go through the SIMD kernel
+    void integrateAwake(float dt, size_t begin = 0, size_t end = SIZE_MAX) {
+        if (end > size()) { end = size(); }
+        while (begin < end) {
+            while (begin < end && asleep[begin]) { ++begin; }
+            size_t run = begin;
+            while (run < end && !asleep[run]) { ++run; }
+            integrate(dt, begin, run);
+            begin = run;
+        }
+    }
+
+    //reference kernel. The SIMD kernels do the same multiply followed by the same add on each lane, so they produce bit-identical results as long as the compiler does not fuse the multiply and add here, which the build turns off with -ffp-contract=off.
+    void integrateScalar(float dt, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            posX[i] = posX[i] + vX[i] * dt;
+            posY[i] = posY[i] + vY[i] * dt;
+            posZ[i] = posZ[i] + vZ[i] * dt;
+            rotX[i] = rotX[i] + rotVX[i] * dt;
+            rotY[i] = rotY[i] + rotVY[i] * dt;
+            rotZ[i] = rotZ[i] + rotVZ[i] * dt;
+        }
+    }
+
+private:
+    static uint8_t *copy(uint8_t *out, const void *in, size_t bytes) {
+        if (bytes != 0) { std::memcpy(out, in, bytes); }
+        return out + bytes;
+    }
+
+    static const uint8_t *copyIn(void *out, const uint8_t *in, size_t bytes) {
+        if (bytes != 0) { std::memcpy(out, in, bytes); }
+        return in + bytes;
+    }
+
+    //every per-body float array, const or not to match the store
+    template<typename Store> static auto arraysOf(Store &store) -> std::array<decltype(&store.posX), 22> {
+        return std::array{&store.posX, &store.posY, &store.posZ, &store.vX, &store.vY, &store.vZ, &store.m, &store.invM, &store.rotX, &store.rotY, &store.rotZ, &store.rotVX, &store.rotVY, &store.rotVZ, &store.r, &store.prevPosX, &store.prevPosY, &store.prevPosZ, &store.prevRotX, &store.prevRotY, &store.prevRotZ, &store.sleepTimer};
+    }
+
+    std::array<std::vector<float> *, 22> arrays() {
+        return arraysOf(*this);
+    }
+
+#if defined(CRYSTAL_ENGINE_PHYSICS_AVX)
+    //returns the index of the first body that was not integrated
+    size_t integrateAVX(float dt, size_t begin, size_t end) {
+        const __m256 step = _mm256_set1_ps(dt);
+        float *positions[6] = {posX.data(), posY.data(), posZ.data(), rotX.data(), rotY.data(), rotZ.data()};
+        const float *velocities[6] = {vX.data(), vY.data(), vZ.data(), rotVX.data(), rotVY.data(), rotVZ.data()};
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            for (int axis = 0; axis < 6; ++axis) {
+                __m256 p = _mm256_loadu_ps(positions[axis] + i);
+                __m256 v = _mm256_loadu_ps(velocities[axis] + i);
+                _mm256_storeu_ps(positions[axis] + i, _mm256_add_ps(p, _mm256_mul_ps(v, step)));
+            }
+        }
+        return i;
+    }
+#elif defined(CRYSTAL_ENGINE_PHYSICS_SSE)
+    //returns the index of the first body that was not integrated
+    size_t integrateSSE(float dt, size_t begin, size_t end) {
+        const __m128 step = _mm_set1_ps(dt);
+        float *positions[6] = {posX.data(), posY.data(), posZ.data(), rotX.data(), rotY.data(), rotZ.data()};
+        const float *velocities[6] = {vX.data(), vY.data(), vZ.data(), rotVX.data(), rotVY.data(), rotVZ.data()};
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            for (int axis = 0; axis < 6; ++axis) {
+                __m128 p = _mm_loadu_ps(positions[axis] + i);
+                __m128 v = _mm_loadu_ps(velocities[axis] + i);
+                _mm_storeu_ps(positions[axis] + i, _mm_add_ps(p, _mm_mul_ps(v, step)));
+            }
+        }
+        return i;
+    }
+#endif
+};
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "bodyStore.hpp"
+
+//two bodies, by store index, that may be touching. a is always less than b.
+struct BodyPair {
+    uint32_t a;
+    uint32_t b;
+
+    bool operator==(const BodyPair &other) const { return a == other.a && b == other.b; }
+};
+
+//uniform grid over every sphere in a body store, rebuilt from scratch each step with a counting sort. Each sphere is binned once, by the minimum corner of its swept bounds, into cells at least as large as the sphere, so every overlapping pair lies in the same or adjacent cells.
+//cells are laid out x-major so that the three cells of a row are contiguous, and worlds too large for a dense grid wrap around it like a spatial hash.
+class SpatialHashGrid {
+public:
+    float cellSize{}; //edge length of a cell. Zero picks twice the average swept sphere size, ignoring spheres far larger than the rest and capped at the largest sphere, each rebuild.
+    size_t cellsPerBody{4}; //the most cells to allocate per sphere before the grid starts to wrap
+
+    //bin every sphere by its swept bounds (its position now and after moving for dt seconds) and write every deduplicated pair of overlapping bounds to pairs. Pairs of resting spheres, those asleep or static and still, cannot start touching and are left out.
+    void findPairs(const BodyStore &store, std::vector<BodyPair> &pairs, float dt) {
+        pairs.clear();
+        buildBounds(store, dt);
+        if (bodies.size() < 2) { return; }
+        float size = cellSize > 0.0f ? cellSize : autoCellSize();
+        float inverseSize = 1.0f / size;
+        layoutCells(size, inverseSize);
+        //count the spheres in each cell. Spheres larger than a cell are kept out of the grid.
+        size_t cellCount = (size_t)dims.x * dims.y * dims.z;
+        cellStart.assign(cellCount + 1, 0);
+        cellOfBody.resize(bodies.size());
+        sorted.resize(bodies.size());
+        oversized.clear();
+        for (uint32_t i = 0; i < bodies.size(); ++i) {
+            const Bounds &b = bounds[i];
+            if (extent(b) > size) {
+                oversized.push_back(i);
+                cellOfBody[i] = UINT32_MAX;
+                continue;
+            }
+            glm::ivec3 cell = glm::ivec3((glm::vec3(b.min[0], b.min[1], b.min[2]) - origin) * inverseSize) % dims;
+            cellOfBody[i] = cellIndex(cell.x, cell.y, cell.z);
+            ++cellStart[cellOfBody[i] + 1];
+        }
+        for (size_t c = 1; c <= cellCount; ++c) { cellStart[c] += cellStart[c - 1]; }
+        cellFill.assign(cellStart.begin(), cellStart.end() - 1);
+        for (uint32_t i = 0; i < bodies.size(); ++i) {
+            if (cellOfBody[i] != UINT32_MAX) { sorted[cellFill[cellOfBody[i]]++] = {i, resting[i], bounds[i]}; }
+        }
+        //test each sphere against the rest of its cell and the 13 neighbouring cells ahead of it, so that each pair is tested exactly once.
+        //when most spheres are resting it is cheaper to skip them and test only the moving ones, against all 26 neighbouring cells.
+        bool movingOnly = restingCount * 2 > bodies.size();
+        for (int z = 0; z < dims.z; ++z) {
+            for (int y = 0; y < dims.y; ++y) {
+                for (int x = 0; x < dims.x; ++x) {
+                    uint32_t c = cellIndex(x, y, z);
+                    for (uint32_t j = cellStart[c]; j < cellStart[c + 1]; ++j) {
+                        if (!movingOnly) { testNeighbours(j, x, y, z, pairs); }
+                        else if (!sorted[j].resting) { testAllNeighbours(j, x, y, z, pairs); }
+                    }
+                }
+            }
+        }
+        //oversized spheres are few, so testing them against everything is cheaper than growing every cell to fit them
+        for (uint32_t p : oversized) {
+            for (uint32_t q = 0; q < bodies.size(); ++q) {
+                if (q == p || (cellOfBody[q] == UINT32_MAX && q < p)) { continue; }
+                test({p, resting[p], bounds[p]}, {q, resting[q], bounds[q]}, pairs);
+            }
+        }
+    }
+
+private:
+    struct Bounds {
+        float min[3];
+        float max[3];
+    };
+
+    struct Entry {
+        uint32_t body; //index into this grid's bound arrays
+        uint32_t resting; //whether the sphere is resting, widened to keep entries 32 bytes
+        Bounds bounds; //copied in so that the pair loop reads the grid sequentially
+    };
+
+    std::vector<uint32_t> bodies; //the store index of each sphere in the grid
+    std::vector<Bounds> bounds; //swept bounds of each sphere in the grid
+    std::vector<uint32_t> resting; //whether each sphere in the grid is asleep, or static and not moving
+    std::vector<uint32_t> cellOfBody; //the cell each sphere was binned into, or UINT32_MAX if it is oversized
+    std::vector<uint32_t> oversized; //spheres larger than a cell
+    std::vector<Entry> sorted; //spheres sorted by cell
+    std::vector<uint32_t> cellStart, cellFill;
+    glm::vec3 origin{}; //the minimum corner of the grid
+    glm::ivec3 dims{}; //the number of cells along each axis
+    glm::bvec3 wraps{}; //whether the world is larger than the grid along each axis
+    size_t restingCount{}; //the number of resting spheres in the grid
+    double sizeSum{}; //the sum of the extents of every sphere in the grid
+    float largest{}; //the extent of the largest sphere in the grid
+
+    void buildBounds(const BodyStore &store, float dt) {
+        bodies.clear();
+        bounds.clear();
+        resting.clear();
+        restingCount = 0;
+        sizeSum = 0.0;
+        largest = 0.0f;
+        for (uint32_t i = 0; i < store.size(); ++i) {
+            float r = store.r[i];
+            if (r <= 0.0f) { continue; }
+            //the velocities of sleeping spheres are ignored
+            float step = store.asleep[i] ? 0.0f : dt;
+            float x = store.posX[i], y = store.posY[i], z = store.posZ[i];
+            float nx = x + store.vX[i] * step, ny = y + store.vY[i] * step, nz = z + store.vZ[i] * step;
+            bodies.push_back(i);
+            resting.push_back(store.asleep[i] || (store.invM[i] == 0.0f && nx == x && ny == y && nz == z));
+            restingCount += resting.back();
+            bounds.push_back({{std::min(x, nx) - r, std::min(y, ny) - r, std::min(z, nz) - r}, {std::max(x, nx) + r, std::max(y, ny) + r, std::max(z, nz) + r}});
+            float e = extent(bounds.back());
+            sizeSum += e;
+            largest = std::max(largest, e);
+        }
+    }
+
+    [[nodiscard]] float autoCellSize() const {
+        //a few huge spheres, such as the ground, would otherwise drag the average up and pile everything else into a handful of cells. They go to the oversized pass instead.
+        double average = sizeSum / (double)bodies.size(), cutoff = 4.0 * average, typicalSum{};
+        size_t typical{};
+        for (const Bounds &b : bounds) {
+            float e = extent(b);
+            if (e > cutoff) { continue; }
+            typicalSum += e;
+            ++typical;
+        }
+        if (typical > 0) { average = typicalSum / (double)typical; }
+        float size = std::min(largest, (float)(2.0 * average));
+        return size > 0.0f ? size : 1.0f;
+    }
+
+    //fit the grid to the spheres that will be binned, shrinking it into a wrapped grid if a dense one would need too many cells
+    void layoutCells(float size, float inverseSize) {
+        glm::vec3 low(INFINITY), high(-INFINITY);
+        for (const Bounds &b : bounds) {
+            if (extent(b) > size) { continue; }
+            low = glm::min(low, glm::vec3(b.min[0], b.min[1], b.min[2]));
+            high = glm::max(high, glm::vec3(b.min[0], b.min[1], b.min[2]));
+        }
+        if (low.x > high.x) { low = high = glm::vec3(0.0f); } //every sphere is oversized
+        origin = low;
+        //computed exactly as the cells are in findPairs, so that the highest corner always lands in the last cell
+        glm::dvec3 span = glm::dvec3(glm::ivec3((high - origin) * inverseSize)) + 1.0;
+        double maxCells = (double)std::max<size_t>(64, bodies.size() * cellsPerBody);
+        double scale = std::min(1.0, std::cbrt(maxCells / (span.x * span.y * span.z)));
+        for (int axis = 0; axis < 3; ++axis) {
+            double d = std::min(span[axis], std::max(3.0, std::floor(span[axis] * scale)));
+            wraps[axis] = d < span[axis];
+            dims[axis] = (int)d;
+        }
+    }
+
+    void testNeighbours(uint32_t j, int x, int y, int z, std::vector<BodyPair> &pairs) const {
+        const Entry &p = sorted[j];
+        //the rest of this cell, and the next cell along the row when it is stored right after this one
+        uint32_t c = cellIndex(x, y, z);
+        uint32_t end = x + 1 < dims.x ? cellStart[c + 2] : cellStart[c + 1];
+        for (uint32_t k = j + 1; k < end; ++k) { test(p, sorted[k], pairs); }
+        if (x + 1 == dims.x && wraps.x) { testCell(p, cellIndex(0, y, z), pairs); }
+        //the rows above and in front
+        static const int rows[4][2] = {{1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+        for (const int *row : rows) {
+            int ny = y + row[0], nz = z + row[1];
+            if (ny < 0 || ny >= dims.y) {
+                if (!wraps.y) { continue; }
+                ny = (ny + dims.y) % dims.y;
+            }
+            if (nz >= dims.z) {
+                if (!wraps.z) { continue; }
+                nz = 0;
+            }
+            if (x > 0 && x + 1 < dims.x) {
+                uint32_t first = cellIndex(x - 1, ny, nz);
+                for (uint32_t k = cellStart[first]; k < cellStart[first + 3]; ++k) { test(p, sorted[k], pairs); }
+                continue;
+            }
+            for (int nx = x - 1; nx <= x + 1; ++nx) {
+                if (nx < 0 || nx >= dims.x) {
+                    if (!wraps.x) { continue; }
+                    testCell(p, cellIndex((nx + dims.x) % dims.x, ny, nz), pairs);
+                } else { testCell(p, cellIndex(nx, ny, nz), pairs); }
+            }
+        }
+    }
+
+    //test a moving sphere against every sphere in its own and the 26 neighbouring cells. Pairs of moving spheres are found from both sides, so only the side with the lower index reports them.
+    void testAllNeighbours(uint32_t j, int x, int y, int z, std::vector<BodyPair> &pairs) const {
+        const Entry &p = sorted[j];
+        auto testMoving = [&](uint32_t first, uint32_t last) {
+            for (uint32_t k = first; k < last; ++k) {
+                const Entry &q = sorted[k];
+                if (!q.resting && q.body <= p.body) { continue; }
+                test(p, q, pairs);
+            }
+        };
+        for (int dz = -1; dz <= 1; ++dz) {
+            int nz = z + dz;
+            if (nz < 0 || nz >= dims.z) {
+                if (!wraps.z) { continue; }
+                nz = (nz + dims.z) % dims.z;
+            }
+            for (int dy = -1; dy <= 1; ++dy) {
+                int ny = y + dy;
+                if (ny < 0 || ny >= dims.y) {
+                    if (!wraps.y) { continue; }
+                    ny = (ny + dims.y) % dims.y;
+                }
+                if (x > 0 && x + 1 < dims.x) {
+                    uint32_t first = cellIndex(x - 1, ny, nz);
+                    testMoving(cellStart[first], cellStart[first + 3]);
+                    continue;
+                }
+                for (int nx = x - 1; nx <= x + 1; ++nx) {
+                    if ((nx < 0 || nx >= dims.x) && !wraps.x) { continue; }
+                    uint32_t cell = cellIndex((nx + dims.x) % dims.x, ny, nz);
+                    testMoving(cellStart[cell], cellStart[cell + 1]);
+                }
+            }
+        }
+    }
+
+    void testCell(const Entry &p, uint32_t cell, std::vector<BodyPair> &pairs) const {
+        for (uint32_t k = cellStart[cell]; k < cellStart[cell + 1]; ++k) { test(p, sorted[k], pairs); }
+    }
+
+    //the comparisons are combined without short-circuiting because nearly every test fails and a single well predicted branch is much cheaper than six poorly predicted ones
+    void test(const Entry &p, const Entry &q, std::vector<BodyPair> &pairs) const {
+        const Bounds &a = p.bounds, &b = q.bounds;
+        bool overlap = (a.min[0] <= b.max[0]) & (b.min[0] <= a.max[0]) & (a.min[1] <= b.max[1]) & (b.min[1] <= a.max[1]) & (a.min[2] <= b.max[2]) & (b.min[2] <= a.max[2]) & !(p.resting & q.resting);
+        if (!overlap) { return; }
+        uint32_t first = bodies[p.body], second = bodies[q.body];
+        pairs.push_back(first < second ? BodyPair{first, second} : BodyPair{second, first});
+    }
+
+    [[nodiscard]] uint32_t cellIndex(int x, int y, int z) const {
+        return (uint32_t)(x + dims.x * (y + dims.y * z));
+    }
+
+    static float extent(const Bounds &b) {
+        return std::max({b.max[0] - b.min[0], b.max[1] - b.min[1], b.max[2] - b.min[2]});
+    }
+};
@@ -0,0 +1,376 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "aabbTree.hpp"
+#include "lanes.hpp"
+#include "publishedState.hpp"
+#include "../Core/threadPool.hpp"
+
+//a sheet of particles joined along the edges of a triangle mesh, such as a banner or flag, simulated by extended position based dynamics. Each tick is split into substeps that predict where every particle goes, project the constraints once, and take the velocity from how far each particle moved. Edges keep their length, the two far corners of every pair of triangles sharing an edge keep their distance so that the sheet resists folding, and particles are pushed out of bodies.
+class Cloth {
+public:
+    static constexpr size_t maxLanes = 8;
+
+    float stretchCompliance{0.0f}; //how far edges give under load, in meters per newton. Zero is as stiff as the substeps allow.
+    float bendCompliance{0.01f}; //the same for folding across an edge
+    float damping{0.1f}; //the fraction of its velocity each particle loses per second
+    float friction{0.3f}; //the fraction of sliding cancelled while a particle touches a body
+    float thickness{0.02f}; //how far the cloth keeps from the surface of bodies
+    glm::vec3 gravity{0.0f, 0.0f, -9.81f}; //acceleration of every free particle, kept apart from the world's gravity so that cloth can hang in a world without any
+    int substeps{8}; //substeps per tick. Cloth stiffens with more substeps far faster than with more iterations of one.
+    size_t particlesPerTask{2048}; //the most particles or constraints in one task when stepped on a thread pool
+    TripleBuffer<PublishedCloth> published; //the shape of the cloth as of the last publish, for a renderer on another thread to read with published.acquire()
+
+    Cloth() = default;
+
+    //build from indexed triangles, read in place as MeshCollider reads them: Cloth(&asset.vertices[0].pos, sizeof(Vertex), asset.vertices.size(), asset.indices.data(), asset.indices.size(), mass, model). Vertices at the same position, such as either side of a texture seam, become one particle, and mass is shared evenly between particles.
+    Cloth(const glm::vec3 *positions, size_t stride, size_t vertexCount, const uint32_t *indices, size_t indexCount, float mass, const glm::mat4 &transform = glm::mat4(1.0f)) {
+        std::vector<glm::vec3> vertices(vertexCount);
+        const auto *bytes = reinterpret_cast<const uint8_t *>(positions);
+        for (size_t i = 0; i < vertexCount; ++i) { vertices[i] = glm::vec3(transform * glm::vec4(*reinterpret_cast<const glm::vec3 *>(bytes + i * stride), 1.0f)); }
+        weld(vertices);
+        size_t padded = (count + maxLanes - 1) / maxLanes * maxLanes;
+        for (std::vector<float> *axis : {&x, &y, &z, &vX, &vY, &vZ, &oldX, &oldY, &oldZ, &invM}) { axis->resize(padded); }
+        for (uint32_t v = 0; v < vertexCount; ++v) {
+            glm::vec3 p = vertices[v];
+            uint32_t i = vertexParticle[v];
+            x[i] = p.x;
+            y[i] = p.y;
+            z[i] = p.z;
+        }
+        particleInvM = count != 0 && mass > 0.0f ? (float)count / mass : 0.0f;
+        std::fill(invM.begin(), invM.begin() + (ptrdiff_t)count, particleInvM);
+        savePrevious();
+        buildConstraints(indices, indexCount);
+    }
+
+    [[nodiscard]] size_t particleCount() const {
+        return count;
+    }
+
+    //the particle that vertex of the mesh the cloth was built from moves with
+    [[nodiscard]] uint32_t particleOf(uint32_t vertex) const {
+        return vertexParticle[vertex];
+    }
+
+    [[nodiscard]] glm::vec3 position(uint32_t particle) const {
+        return {x[particle], y[particle], z[particle]};
+    }
+
+    //fix particle in place, as where a banner hangs from its pole, or free it again
+    void pin(uint32_t particle, bool pinned = true) {
+        invM[particle] = pinned ? 0.0f : particleInvM;
+        vX[particle] = vY[particle] = vZ[particle] = 0.0f;
+    }
+
+    //move particle, and where it was before the last tick, to position
+    void setPosition(uint32_t particle, glm::vec3 p) {
+        x[particle] = previousX[particle] = p.x;
+        y[particle] = previousY[particle] = p.y;
+        z[particle] = previousZ[particle] = p.z;
+    }
+
+    //the number of batches of constraints that share no particle, each solved in parallel
+    [[nodiscard]] size_t colorCount() const {
+        return stretch.colorStart.size() + bend.colorStart.size() - 2;
+    }
+
+    //bounds every particle, grown by how far the fastest one could move in dt seconds and by the thickness
+    [[nodiscard]] AABB bounds(float dt) const {
+        if (count == 0) { return {}; }
+        AABB box{glm::vec3(INFINITY), glm::vec3(-INFINITY)};
+        float fastest2{};
+        for (size_t i = 0; i < count; ++i) {
+            glm::vec3 p(x[i], y[i], z[i]), v(vX[i], vY[i], vZ[i]);
+            box.min = glm::min(box.min, p);
+            box.max = glm::max(box.max, p);
+            fastest2 = std::max(fastest2, glm::dot(v, v));
+        }
+        float grow = std::sqrt(fastest2) * dt + thickness;
+        return {box.min - grow, box.max + grow};
+    }
+
+    //advance the cloth by dt seconds, pushing it out of count spheres, each a center and radius. Stepping on threadPool gives the same result as stepping without one.
+    void step(float dt, const glm::vec4 *spheres, size_t sphereCount, ThreadPool *threadPool = nullptr) {
+        if (count == 0 || substeps <= 0) { return; }
+        float h = dt / (float)substeps;
+        for (int substep = 0; substep < substeps; ++substep) {
+            forParticles(threadPool, [&](size_t begin, size_t end) { predict(h, begin, end); });
+            project(stretch, stretchCompliance / (h * h), threadPool);
+            project(bend, bendCompliance / (h * h), threadPool);
+            forParticles(threadPool, [&](size_t begin, size_t end) { collide(h, spheres, sphereCount, begin, end); });
+        }
+    }
+
+    //remember where every particle is, to blend from until the next call. World::update calls this before the last tick of every update, as it does BodyStore::savePrevious.
+    void savePrevious() {
+        previousX = x;
+        previousY = y;
+        previousZ = z;
+    }
+
+    //blend every particle alpha of the way from its previous position to its current one, work out the normal of every vertex from the triangles around it, and hand both to the reader through published. Called by World::publish.
+    void publish(float alpha) {
+        blended.resize(count);
+        particleNormals.assign(count, glm::vec3(0.0f));
+        for (size_t i = 0; i < count; ++i) { blended[i] = glm::mix(glm::vec3(previousX[i], previousY[i], previousZ[i]), glm::vec3(x[i], y[i], z[i]), alpha); }
+        //unnormalized cross products weigh each triangle by its area
+        for (size_t t = 0; t + 2 < triangles.size(); t += 3) {
+            glm::vec3 a = blended[triangles[t]], b = blended[triangles[t + 1]], c = blended[triangles[t + 2]];
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            for (size_t k = 0; k < 3; ++k) { particleNormals[triangles[t + k]] += normal; }
+        }
+        for (glm::vec3 &normal : particleNormals) {
+            float length = glm::length(normal);
+            normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+        }
+        PublishedCloth &state = published.back();
+        state.positions.resize(vertexParticle.size());
+        state.normals.resize(vertexParticle.size());
+        for (size_t v = 0; v < vertexParticle.size(); ++v) {
+            state.positions[v] = blended[vertexParticle[v]];
+            state.normals[v] = particleNormals[vertexParticle[v]];
+        }
+        state.frame = ++publishedFrames;
+        published.publish();
+    }
+
+private:
+#if defined(CRYSTAL_ENGINE_PHYSICS_AVX)
+    using Lanes = AVXLanes;
+#elif defined(CRYSTAL_ENGINE_PHYSICS_SSE)
+    using Lanes = SSELanes;
+#else
+    using Lanes = ScalarLanes;
+#endif
+
+    //distance constraints sorted into colors, no two constraints of which share a particle. A particle joined to more constraints than there are colors puts the rest in a last batch solved in order on one thread.
+    struct Constraints {
+        std::vector<uint32_t> a, b;
+        std::vector<float> rest;
+        std::vector<uint32_t> colorStart{0}; //constraints [colorStart[i], colorStart[i + 1]) make up the i-th color
+        uint32_t sequentialStart{}; //constraints from here on are solved in order
+    };
+
+    size_t count{};
+    float particleInvM{};
+    std::vector<float> x, y, z, vX, vY, vZ, invM; //padded with pinned particles to a whole number of the widest batches
+    std::vector<float> oldX, oldY, oldZ; //positions at the start of the substep
+    std::vector<float> previousX, previousY, previousZ; //positions before the last tick of the last update
+    std::vector<uint32_t> vertexParticle; //the particle of each vertex of the mesh
+    std::vector<uint32_t> triangles; //the mesh's triangles as particles, three to a triangle
+    Constraints stretch, bend;
+    std::vector<glm::vec3> blended, particleNormals;
+    uint64_t publishedFrames{};
+
+    //give every distinct position a particle, numbered in order of first appearance so that particles of nearby vertices stay near each other in memory
+    void weld(const std::vector<glm::vec3> &vertices) {
+        std::vector<uint32_t> order(vertices.size());
+        for (uint32_t v = 0; v < order.size(); ++v) { order[v] = v; }
+        auto less = [](glm::vec3 a, glm::vec3 b) { return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z; };
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return less(vertices[a], vertices[b]); });
+        //each vertex first points at the earliest vertex at its position, which is then given the next particle when first met
+        std::vector<uint32_t> first(vertices.size());
+        for (size_t i = 0; i < order.size(); ++i) { first[order[i]] = i != 0 && vertices[order[i]] == vertices[order[i - 1]] ? first[order[i - 1]] : order[i]; }
+        vertexParticle.assign(vertices.size(), UINT32_MAX);
+        count = 0;
+        for (uint32_t v = 0; v < vertices.size(); ++v) {
+            if (vertexParticle[first[v]] == UINT32_MAX) { vertexParticle[first[v]] = (uint32_t)count++; }
+            vertexParticle[v] = vertexParticle[first[v]];
+        }
+    }
+
+    //join the two ends of every edge, and the far corners of every two triangles sharing an edge
+    void buildConstraints(const uint32_t *indices, size_t indexCount) {
+        std::unordered_map<uint64_t, uint32_t> opposite; //the far corner of the first triangle found on each edge
+        std::vector<uint32_t> stretchEnds, bendEnds;
+        for (size_t t = 0; t + 2 < indexCount; t += 3) {
+            if (std::max({indices[t], indices[t + 1], indices[t + 2]}) >= vertexParticle.size()) { continue; }
+            uint32_t corner[3] = {vertexParticle[indices[t]], vertexParticle[indices[t + 1]], vertexParticle[indices[t + 2]]};
+            if (corner[0] == corner[1] || corner[1] == corner[2] || corner[2] == corner[0]) { continue; }
+            triangles.insert(triangles.end(), corner, corner + 3);
+            for (int k = 0; k < 3; ++k) {
+                uint32_t a = corner[k], b = corner[(k + 1) % 3], far = corner[(k + 2) % 3];
+                uint64_t edge = (uint64_t)std::min(a, b) << 32 | std::max(a, b);
+                auto [found, added] = opposite.emplace(edge, far);
+                if (added) {
+                    stretchEnds.insert(stretchEnds.end(), {a, b});
+                } else if (found->second != UINT32_MAX && found->second != far) {
+                    bendEnds.insert(bendEnds.end(), {found->second, far});
+                    //an edge shared by more than two triangles bends only between the first two
+                    found->second = UINT32_MAX;
+                }
+            }
+        }
+        color(stretchEnds, stretch);
+        color(bendEnds, bend);
+    }
+
+    //greedily give each constraint the lowest color neither of its particles has yet, then sort the constraints by color
+    void color(const std::vector<uint32_t> &ends, Constraints &constraints) const {
+        constexpr uint32_t colors = 64;
+        std::vector<uint64_t> used(count);
+        std::vector<uint32_t> colorOf(ends.size() / 2), colorSize(colors + 1);
+        for (size_t i = 0; i < colorOf.size(); ++i) {
+            uint32_t a = ends[2 * i], b = ends[2 * i + 1];
+            uint64_t free = ~(used[a] | used[b]);
+            colorOf[i] = free == 0 ? colors : (uint32_t)std::countr_zero(free);
+            if (colorOf[i] < colors) {
+                used[a] |= 1ull << colorOf[i];
+                used[b] |= 1ull << colorOf[i];
+            }
+            ++colorSize[colorOf[i]];
+        }
+        std::vector<uint32_t> start(colors + 2);
+        for (uint32_t c = 0; c <= colors; ++c) { start[c + 1] = start[c] + colorSize[c]; }
+        constraints.a.resize(colorOf.size());
+        constraints.b.resize(colorOf.size());
+        constraints.rest.resize(colorOf.size());
+        std::vector<uint32_t> next(start.begin(), start.end() - 1);
+        for (size_t i = 0; i < colorOf.size(); ++i) {
+            uint32_t slot = next[colorOf[i]]++, a = ends[2 * i], b = ends[2 * i + 1];
+            constraints.a[slot] = a;
+            constraints.b[slot] = b;
+            constraints.rest[slot] = glm::length(glm::vec3(x[b] - x[a], y[b] - y[a], z[b] - z[a]));
+        }
+        constraints.colorStart.assign(1, 0);
+        for (uint32_t c = 0; c < colors; ++c) {
+            if (colorSize[c] != 0) { constraints.colorStart.push_back(start[c + 1]); }
+        }
+        constraints.sequentialStart = start[colors];
+    }
+
+    //run body over every particle in chunks of whole batches, on threadPool if there is one
+    template<typename Body> void forParticles(ThreadPool *threadPool, Body body) {
+        size_t padded = x.size();
+        if (threadPool == nullptr) {
+            body(0, padded);
+            return;
+        }
+        threadPool->parallelFor(padded, grain(), body);
+    }
+
+    [[nodiscard]] size_t grain() const {
+        return std::max<size_t>(particlesPerTask / maxLanes, 1) * maxLanes;
+    }
+
+    //damp and accelerate every free particle, then move it along its velocity for h seconds
+    void predict(float h, size_t begin, size_t end) {
+        using L = Lanes;
+        using F = typename L::Float;
+        F step = L::set(h), keep = L::set(std::max(1.0f - damping * h, 0.0f)), zero = L::set(0.0f);
+        F dv[3] = {L::set(gravity.x * h), L::set(gravity.y * h), L::set(gravity.z * h)};
+        float *positions[3] = {x.data(), y.data(), z.data()}, *velocities[3] = {vX.data(), vY.data(), vZ.data()}, *old[3] = {oldX.data(), oldY.data(), oldZ.data()};
+        for (size_t i = begin; i < end; i += L::width) {
+            auto free = L::less(zero, L::load(invM.data() + i));
+            for (int axis = 0; axis < 3; ++axis) {
+                F v = L::select(free, L::add(L::mul(L::load(velocities[axis] + i), keep), dv[axis]), zero);
+                F p = L::load(positions[axis] + i);
+                L::store(velocities[axis] + i, v);
+                L::store(old[axis] + i, p);
+                L::store(positions[axis] + i, L::add(p, L::mul(v, step)));
+            }
+        }
+    }
+
+    //project every constraint once, a color at a time. Constraints of one color share no particle, so they are split between tasks and gathered into lanes freely.
+    void project(const Constraints &constraints, float alpha, ThreadPool *threadPool) {
+        for (size_t color = 0; color + 1 < constraints.colorStart.size(); ++color) {
+            size_t first = constraints.colorStart[color], size = constraints.colorStart[color + 1] - first;
+            auto body = [&](size_t begin, size_t end) {
+                size_t i = projectRange<Lanes>(constraints, first + begin, first + end, alpha);
+                projectRange<ScalarLanes>(constraints, i, first + end, alpha);
+            };
+            if (threadPool == nullptr) { body(0, size); }
+            else { threadPool->parallelFor(size, grain(), body); }
+        }
+        projectRange<ScalarLanes>(constraints, constraints.sequentialStart, constraints.a.size(), alpha);
+    }
+
+    //move both ends of each constraint in [begin, end) along it, in proportion to their inverse mass, until it is at its rest length or as near as alpha, its compliance over the substep squared, lets it. Returns the first constraint left for a narrower kernel.
+    template<typename L> size_t projectRange(const Constraints &constraints, size_t begin, size_t end, float alpha) {
+        using F = typename L::Float;
+        constexpr size_t width = L::width;
+        F compliance = L::set(alpha), tiny = L::set(1e-12f);
+        float *positions[3] = {x.data(), y.data(), z.data()};
+        size_t i = begin;
+        for (; i + width <= end; i += width) {
+            const uint32_t *a = constraints.a.data() + i, *b = constraints.b.data() + i;
+            float ends[2][3][width], weights[2][width];
+            for (size_t lane = 0; lane < width; ++lane) {
+                for (int axis = 0; axis < 3; ++axis) {
+                    ends[0][axis][lane] = positions[axis][a[lane]];
+                    ends[1][axis][lane] = positions[axis][b[lane]];
+                }
+                weights[0][lane] = invM[a[lane]];
+                weights[1][lane] = invM[b[lane]];
+            }
+            F d[3], length2 = L::set(0.0f);
+            for (int axis = 0; axis < 3; ++axis) {
+                d[axis] = L::sub(L::load(ends[1][axis]), L::load(ends[0][axis]));
+                length2 = L::add(length2, L::mul(d[axis], d[axis]));
+            }
+            F wA = L::load(weights[0]), wB = L::load(weights[1]);
+            F length = L::sqrt(length2);
+            //the stretch over the length, so that multiplying d by it gives the stretch along the constraint
+            F scale = L::div(L::sub(length, L::load(constraints.rest.data() + i)), L::mul(L::max(length, tiny), L::max(L::add(L::add(wA, wB), compliance), tiny)));
+            F moveA = L::mul(wA, scale), moveB = L::mul(wB, scale);
+            for (int axis = 0; axis < 3; ++axis) {
+                L::store(ends[0][axis], L::add(L::load(ends[0][axis]), L::mul(d[axis], moveA)));
+                L::store(ends[1][axis], L::sub(L::load(ends[1][axis]), L::mul(d[axis], moveB)));
+            }
+            for (size_t lane = 0; lane < width; ++lane) {
+                for (int axis = 0; axis < 3; ++axis) {
+                    positions[axis][a[lane]] = ends[0][axis][lane];
+                    positions[axis][b[lane]] = ends[1][axis][lane];
+                }
+            }
+        }
+        return i;
+    }
+
+    //push every free particle out of each sphere, cancelling friction of its sliding, then take its velocity from how far it moved over the substep of h seconds
+    void collide(float h, const glm::vec4 *spheres, size_t sphereCount, size_t begin, size_t end) {
+        using L = Lanes;
+        using F = typename L::Float;
+        F zero = L::set(0.0f), tiny = L::set(1e-12f), grip = L::set(std::clamp(friction, 0.0f, 1.0f)), inverseStep = L::set(1.0f / h);
+        float *positions[3] = {x.data(), y.data(), z.data()}, *velocities[3] = {vX.data(), vY.data(), vZ.data()};
+        for (size_t i = begin; i < end; i += L::width) {
+            auto free = L::less(zero, L::load(invM.data() + i));
+            F p[3] = {L::load(x.data() + i), L::load(y.data() + i), L::load(z.data() + i)};
+            F start[3] = {L::load(oldX.data() + i), L::load(oldY.data() + i), L::load(oldZ.data() + i)};
+            for (size_t s = 0; s < sphereCount; ++s) {
+                glm::vec4 sphere = spheres[s];
+                float reach = sphere.w + thickness;
+                F d[3] = {L::sub(p[0], L::set(sphere.x)), L::sub(p[1], L::set(sphere.y)), L::sub(p[2], L::set(sphere.z))};
+                F distance2 = L::add(L::add(L::mul(d[0], d[0]), L::mul(d[1], d[1])), L::mul(d[2], d[2]));
+                auto touching = L::both(free, L::less(distance2, L::set(reach * reach)));
+                if (L::bits(touching) == 0) { continue; }
+                F distance = L::max(L::sqrt(distance2), tiny);
+                F push = L::div(L::sub(L::set(reach), distance), distance);
+                F n[3], moved[3], along = zero;
+                for (int axis = 0; axis < 3; ++axis) {
+                    n[axis] = L::div(d[axis], distance);
+                    p[axis] = L::select(touching, L::add(p[axis], L::mul(d[axis], push)), p[axis]);
+                    moved[axis] = L::sub(p[axis], start[axis]);
+                    along = L::add(along, L::mul(moved[axis], n[axis]));
+                }
+                for (int axis = 0; axis < 3; ++axis) {
+                    F slide = L::sub(moved[axis], L::mul(n[axis], along));
+                    p[axis] = L::select(touching, L::sub(p[axis], L::mul(slide, grip)), p[axis]);
+                }
+            }
+            for (int axis = 0; axis < 3; ++axis) {
+                L::store(positions[axis] + i, p[axis]);
+                L::store(velocities[axis] + i, L::mul(L::sub(p[axis], start[axis]), inverseStep));
+            }
+        }
+    }
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "lanes.hpp"
+
+//a convex shape in its body's frame, described by the point of a core furthest along any direction plus a margin rounding every side of the core. Boxes and hulls have no margin, a capsule is a segment with its radius as margin, and a sphere, which needs no collider, is a point with its radius as margin.
+class ConvexCollider {
+public:
+    enum class Kind : uint8_t { box, capsule, hull };
+
+    ConvexCollider() = default;
+
+    //a box reaching halfExtents from its center along each axis
+    static ConvexCollider box(glm::vec3 halfExtents) {
+        ConvexCollider collider;
+        collider.kind = Kind::box;
+        collider.halfExtents = glm::abs(halfExtents);
+        collider.bounding = glm::length(collider.halfExtents);
+        return collider;
+    }
+
+    //a capsule whose segment runs halfHeight along the local z axis either side of its center
+    static ConvexCollider capsule(float halfHeight, float radius) {
+        ConvexCollider collider;
+        collider.kind = Kind::capsule;
+        collider.halfExtents = {0.0f, 0.0f, std::abs(halfHeight)};
+        collider.roundness = std::abs(radius);
+        collider.bounding = collider.halfExtents.z + collider.roundness;
+        return collider;
+    }
+
+    //the convex hull of points, read in place with stride bytes from one point to the next, so that the vertices of an Asset can be used directly: ConvexCollider::hull(&asset.vertices[0].pos, sizeof(Vertex), asset.vertices.size(), asset.scale). The furthest point of a set along a direction is always a corner of its hull, so the hull is never built; duplicate points are dropped and the rest are searched a batch of lanes at a time.
+    static ConvexCollider hull(const glm::vec3 *points, size_t stride, size_t count, glm::vec3 scale = glm::vec3(1.0f)) {
+        ConvexCollider collider;
+        collider.kind = Kind::hull;
+        std::vector<glm::vec3> unique(count);
+        const auto *bytes = reinterpret_cast<const uint8_t *>(points);
+        for (size_t i = 0; i < count; ++i) { unique[i] = *reinterpret_cast<const glm::vec3 *>(bytes + i * stride) * scale; }
+        auto less = [](glm::vec3 a, glm::vec3 b) { return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z; };
+        std::sort(unique.begin(), unique.end(), less);
+        unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+        //padded with copies of the first point, which can never be further along a direction than the point itself
+        size_t padded = (unique.size() + maxLanes - 1) / maxLanes * maxLanes;
+        collider.vertexCount = (uint32_t)unique.size();
+        for (std::vector<float> *axis : {&collider.x, &collider.y, &collider.z}) { axis->resize(padded); }
+        for (size_t i = 0; i < padded; ++i) {
+            glm::vec3 p = unique.empty() ? glm::vec3(0.0f) : unique[i < unique.size() ? i : 0];
+            collider.x[i] = p.x;
+            collider.y[i] = p.y;
+            collider.z[i] = p.z;
+            collider.bounding = std::max(collider.bounding, glm::length(p));
+        }
+        return collider;
+    }
+
+    [[nodiscard]] Kind getKind() const {
+        return kind;
+    }
+
+    //the distance every side of the core is rounded out by
+    [[nodiscard]] float margin() const {
+        return roundness;
+    }
+
+    //the radius of a sphere around the body's center holding the whole shape, which stands in for it in the broadphase and scene queries
+    [[nodiscard]] float boundingRadius() const {
+        return bounding;
+    }
+
+    [[nodiscard]] size_t hullVertexCount() const {
+        return vertexCount;
+    }
+
+    //the point of the core furthest along direction, in the body's frame
+    [[nodiscard]] glm::vec3 support(glm::vec3 direction) const {
+        switch (kind) {
+            case Kind::box:
+                return {direction.x < 0.0f ? -halfExtents.x : halfExtents.x, direction.y < 0.0f ? -halfExtents.y : halfExtents.y, direction.z < 0.0f ? -halfExtents.z : halfExtents.z};
+            case Kind::capsule:
+                return {0.0f, 0.0f, direction.z < 0.0f ? -halfExtents.z : halfExtents.z};
+            case Kind::hull:
+                break;
+        }
+#if defined(CRYSTAL_ENGINE_PHYSICS_AVX)
+        return hullSupport<AVXLanes>(direction);
+#elif defined(CRYSTAL_ENGINE_PHYSICS_SSE)
+        return hullSupport<SSELanes>(direction);
+#else
+        return hullSupport<ScalarLanes>(direction);
+#endif
+    }
+
+private:
+    static constexpr size_t maxLanes = 8;
+
+    Kind kind{Kind::box};
+    glm::vec3 halfExtents{};
+    float roundness{};
+    float bounding{};
+    uint32_t vertexCount{};
+    std::vector<float> x, y, z; //hull points, padded to a whole number of the widest batches
+
+    //keep the furthest point seen in each lane, then pick the furthest of the lanes. Ties go to the earliest point, so the result does not depend on the lane width.
+    template<typename L> glm::vec3 hullSupport(glm::vec3 direction) const {
+        using F = typename L::Float;
+        constexpr size_t width = L::width;
+        if (vertexCount == 0) { return glm::vec3(0.0f); }
+        static constexpr float laneIndex[maxLanes] = {0, 1, 2, 3, 4, 5, 6, 7};
+        F dx = L::set(direction.x), dy = L::set(direction.y), dz = L::set(direction.z);
+        F best = L::set(-INFINITY), bestIndex = L::set(0.0f), index = L::load(laneIndex);
+        for (size_t i = 0; i < x.size(); i += width) {
+            F distance = L::add(L::add(L::mul(L::load(x.data() + i), dx), L::mul(L::load(y.data() + i), dy)), L::mul(L::load(z.data() + i), dz));
+            auto further = L::less(best, distance);
+            best = L::select(further, distance, best);
+            bestIndex = L::select(further, index, bestIndex);
+            index = L::add(index, L::set((float)width));
+        }
+        float distances[width], indices[width];
+        L::store(distances, best);
+        L::store(indices, bestIndex);
+        size_t furthest = (size_t)indices[0];
+        float furthestDistance = distances[0];
+        for (size_t lane = 1; lane < width; ++lane) {
+            auto i = (size_t)indices[lane];
+            if (distances[lane] > furthestDistance || (distances[lane] == furthestDistance && i < furthest)) {
+                furthest = i;
+                furthestDistance = distances[lane];
+            }
+        }
+        return {x[furthest], y[furthest], z[furthest]};
+    }
+};
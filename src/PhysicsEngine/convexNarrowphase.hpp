@@ -0,0 +1,557 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "bodyStore.hpp"
+#include "broadphase.hpp"
+#include "convexCollider.hpp"
+#include "narrowphase.hpp"
+
+//a convex shape placed in the world: its collider, or null for a sphere, which is a point rounded by its radius
+struct ConvexPose {
+    const ConvexCollider *collider;
+    glm::vec3 position;
+    glm::mat3 rotation;
+    float margin;
+
+    static ConvexPose of(const BodyStore &store, uint32_t body, const ConvexCollider *collider) {
+        glm::vec3 position(store.posX[body], store.posY[body], store.posZ[body]);
+        if (collider == nullptr) { return {nullptr, position, glm::mat3(1.0f), store.r[body]}; }
+        return {collider, position, glm::mat3_cast(glm::quat(glm::vec3(store.rotX[body], store.rotY[body], store.rotZ[body]))), collider->margin()};
+    }
+
+    //the point of the core furthest along direction
+    [[nodiscard]] glm::vec3 support(glm::vec3 direction) const {
+        if (collider == nullptr) { return position; }
+        return position + rotation * collider->support(glm::transpose(rotation) * direction);
+    }
+};
+
+//the closest points between two convex shapes, or their deepest points where they overlap
+struct ConvexDistance {
+    glm::vec3 normal{}; //unit normal pointing from the first shape towards the second
+    float separation{}; //the distance between the surfaces along normal, negative where they overlap
+    glm::vec3 pointA{}, pointB{}; //the closest or deepest point on the surface of each shape
+    int iterations{}; //the GJK iterations it took, counting each support point found
+};
+
+//narrowphase for pairs involving convex colliders. GJK finds the distance between the cores of two shapes, and EPA how deeply they overlap in the rarer case that the cores themselves do. Every pair remembers the axis it was last separated along: a pair still separated along it by more than it can close in a tick is skipped after a single support query, and any other starts GJK from that axis, which usually finishes it in one or two iterations.
+class ConvexNarrowphase {
+public:
+    static constexpr uint32_t maxPoints = 4; //the most contact points a pair keeps
+
+    //what a pair carries from one tick to the next: the axis it was last separated along, and the contact points it has found, kept in the frame of each body. GJK finds a single point a tick, so a box settling onto a face gathers one at each corner it touches over a few ticks and then rests on all of them.
+    struct PairState {
+        glm::vec3 axis{};
+        uint32_t count{};
+        glm::vec3 localA[maxPoints]{}, localB[maxPoints]{};
+    };
+
+    int maxIterations{32}; //the most GJK iterations per pair
+    int maxExpansions{48}; //the most points EPA adds to its polytope per pair
+    float contactBreaking{0.02f}; //how far a kept point may slide along the surface or move out of contact before it is dropped
+    size_t iterations{}; //the GJK iterations run over every pair during the last tick
+
+    //find the closest points of a and b, starting GJK along axis, a guess at the normal from a to b
+    static ConvexDistance distance(const ConvexPose &a, const ConvexPose &b, glm::vec3 axis, int maxIterations = 32, int maxExpansions = 48) {
+        ConvexDistance result;
+        Simplex simplex;
+        glm::vec3 v{};
+        bool overlapping = gjk(a, b, axis, maxIterations, simplex, v, result.iterations);
+        glm::vec3 coreA{}, coreB{};
+        float coreDistance;
+        if (!overlapping) {
+            simplex.witnesses(coreA, coreB);
+            coreDistance = glm::length(v);
+            result.normal = -v / coreDistance;
+        } else if (!epa(a, b, simplex, maxExpansions, result.normal, coreDistance, coreA, coreB)) {
+            //the cores only touch, or are too flat to expand around. Push apart along the line between the centers.
+            glm::vec3 offset = b.position - a.position;
+            result.normal = glm::dot(offset, offset) > 0.0f ? glm::normalize(offset) : glm::vec3(0.0f, 0.0f, 1.0f);
+            coreA = a.support(result.normal);
+            coreB = b.support(-result.normal);
+            coreDistance = glm::dot(coreB - coreA, result.normal);
+        } else {
+            coreDistance = -coreDistance;
+        }
+        result.pointA = coreA + result.normal * a.margin;
+        result.pointB = coreB - result.normal * b.margin;
+        result.separation = coreDistance - a.margin - b.margin;
+        return result;
+    }
+
+    //find the contacts of each of count pairs whose surfaces are closer than they could close in the next dt seconds, appending them to contacts in pair order. colliders holds the collider of each body, or null for spheres. The state each pair ends with is written to states, for remember. Safe to call from several threads at once. Returns the GJK iterations run.
+    size_t collide(const BodyStore &store, const std::vector<const ConvexCollider *> &colliders, const BodyPair *pairs, size_t count, float dt, std::vector<Contact> &contacts, PairState *states) const {
+        size_t run{};
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t a = pairs[i].a, b = pairs[i].b;
+            ConvexPose poseA = ConvexPose::of(store, a, colliders[a]), poseB = ConvexPose::of(store, b, colliders[b]);
+            glm::vec3 displacement = (glm::vec3(store.vX[b], store.vY[b], store.vZ[b]) - glm::vec3(store.vX[a], store.vY[a], store.vZ[a])) * dt;
+            float reach = glm::length(displacement);
+            auto cached = pairCache.find(key(pairs[i]));
+            PairState &state = states[i];
+            if (cached != pairCache.end()) {
+                state = cached->second;
+                //still separated along the old axis by more than the pair can close, so there is nothing to find
+                float gap = glm::dot(state.axis, poseB.support(-state.axis) - poseA.support(state.axis)) - poseA.margin - poseB.margin;
+                ++run;
+                if (gap > reach) {
+                    state.count = 0;
+                    continue;
+                }
+            } else {
+                glm::vec3 offset = poseB.position - poseA.position;
+                state = {glm::dot(offset, offset) > 0.0f ? glm::normalize(offset) : glm::vec3(0.0f, 0.0f, 1.0f)};
+            }
+            ConvexDistance found = distance(poseA, poseB, state.axis, maxIterations, maxExpansions);
+            run += (size_t)found.iterations;
+            state.axis = found.normal;
+            if (found.separation > reach) {
+                state.count = 0;
+                continue;
+            }
+            keepPoints(state, poseA, poseB, found);
+            float closing = -glm::dot(displacement, found.normal);
+            for (uint32_t k = 0; k < state.count; ++k) {
+                glm::vec3 pointA = poseA.position + poseA.rotation * state.localA[k], pointB = poseB.position + poseB.rotation * state.localB[k];
+                float separation = glm::dot(pointB - pointA, found.normal);
+                if (separation > reach) { continue; }
+                float toi = separation <= 0.0f ? 0.0f : closing > 0.0f ? std::min(separation / closing, 1.0f) : 1.0f;
+                contacts.push_back({a, b, toi, found.normal, std::max(-separation, 0.0f), (pointA + pointB) * 0.5f, k + 1, separation});
+            }
+        }
+        return run;
+    }
+
+    //keep the state of every pair collided this tick for the next one, forgetting pairs that were not. iterationsRun is the total returned by collide over the tick.
+    void remember(const BodyPair *pairs, size_t count, const PairState *states, size_t iterationsRun) {
+        pairCache.clear();
+        pairKeys.clear();
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t k = key(pairs[i]);
+            pairCache[k] = states[i];
+            pairKeys.push_back(k);
+        }
+        iterations = iterationsRun;
+    }
+
+    //renumber the bodies of every cached pair after bodies were moved within the store, as ContactSolver::remapBodies does
+    void remapBodies(const std::vector<uint32_t> &newIndex) {
+        remapped.clear();
+        keptKeys.clear();
+        for (uint64_t k : pairKeys) {
+            uint32_t a = newIndex[k >> 32], b = newIndex[(uint32_t)k];
+            if (a == UINT32_MAX || b == UINT32_MAX) { continue; }
+            PairState state = pairCache.at(k);
+            //pairs are keyed lowest body first, and the axis points from the first body to the second
+            if (a > b) {
+                std::swap(a, b);
+                state.axis = -state.axis;
+                std::swap(state.localA, state.localB);
+            }
+            uint64_t remappedKey = (uint64_t)a << 32 | b;
+            remapped.emplace(remappedKey, state);
+            keptKeys.push_back(remappedKey);
+        }
+        std::swap(pairCache, remapped);
+        std::swap(pairKeys, keptKeys);
+    }
+
+    void clear() {
+        pairCache.clear();
+        pairKeys.clear();
+    }
+
+    //the number of bytes write needs
+    [[nodiscard]] size_t serializedSize() const {
+        return sizeof(uint32_t) + pairKeys.size() * sizeof(CachedPair);
+    }
+
+    //copy the state of every cached pair to out in the order they were cached, and return the end of what was written
+    uint8_t *write(uint8_t *out) const {
+        auto count = (uint32_t)pairKeys.size();
+        std::memcpy(out, &count, sizeof(count));
+        out += sizeof(count);
+        for (uint64_t k : pairKeys) {
+            CachedPair record{k, pairCache.at(k)};
+            std::memcpy(out, &record, sizeof(record));
+            out += sizeof(record);
+        }
+        return out;
+    }
+
+    //check that [in, end) starts with pairs written by write for a store of bodyCount bodies, without changing anything. Returns the end of them, or null if they run past end or a key names a body outside the store.
+    [[nodiscard]] static const uint8_t *validate(const uint8_t *in, const uint8_t *end, size_t bodyCount) {
+        uint32_t count;
+        if ((size_t)(end - in) < sizeof(count)) { return nullptr; }
+        std::memcpy(&count, in, sizeof(count));
+        in += sizeof(count);
+        if ((size_t)(end - in) / sizeof(CachedPair) < count) { return nullptr; }
+        for (uint32_t i = 0; i < count; ++i, in += sizeof(CachedPair)) {
+            uint64_t k;
+            std::memcpy(&k, in + offsetof(CachedPair, key), sizeof(k));
+            if ((k >> 32) >= bodyCount || (uint32_t)k >= bodyCount) { return nullptr; }
+        }
+        return in;
+    }
+
+    //replace the cache with pairs written by write. Returns the end of what was read, or null, changing nothing, if validate fails.
+    const uint8_t *read(const uint8_t *in, const uint8_t *end, size_t bodyCount) {
+        if (validate(in, end, bodyCount) == nullptr) { return nullptr; }
+        uint32_t count;
+        std::memcpy(&count, in, sizeof(count));
+        in += sizeof(count);
+        clear();
+        pairKeys.resize(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            CachedPair record;
+            std::memcpy(&record, in, sizeof(record));
+            in += sizeof(record);
+            pairKeys[i] = record.key;
+            pairCache.emplace(record.key, record.state);
+        }
+        return in;
+    }
+
+private:
+    //a point of the Minkowski difference a - b, and the points of a and b it came from
+    struct SupportPoint {
+        glm::vec3 w, a, b;
+    };
+
+    struct Simplex {
+        SupportPoint points[4];
+        float weights[4]; //the barycentric weight of each point in the closest point to the origin
+        int size{};
+
+        void witnesses(glm::vec3 &a, glm::vec3 &b) const {
+            a = b = glm::vec3(0.0f);
+            for (int i = 0; i < size; ++i) {
+                a += points[i].a * weights[i];
+                b += points[i].b * weights[i];
+            }
+        }
+
+        //keep only the points with a weight
+        void reduce() {
+            int kept{};
+            for (int i = 0; i < size; ++i) {
+                if (weights[i] <= 0.0f) { continue; }
+                points[kept] = points[i];
+                weights[kept++] = weights[i];
+            }
+            size = kept;
+        }
+    };
+
+    struct CachedPair {
+        uint64_t key;
+        PairState state;
+    };
+
+    std::unordered_map<uint64_t, PairState> pairCache{}, remapped{};
+    std::vector<uint64_t> pairKeys{}, keptKeys{}; //every key in the cache, in pair order
+
+    static uint64_t key(const BodyPair &pair) {
+        return (uint64_t)pair.a << 32 | pair.b;
+    }
+
+    //drop the kept points of a pair that have slid apart or out of contact, then add the points found this tick. A new point close to a kept one replaces it; once every slot is full, it replaces whichever point leaves the others spread over the largest area, never the deepest.
+    void keepPoints(PairState &state, const ConvexPose &a, const ConvexPose &b, const ConvexDistance &found) const {
+        glm::vec3 pointsA[maxPoints];
+        float separations[maxPoints];
+        uint32_t kept{};
+        for (uint32_t k = 0; k < state.count; ++k) {
+            glm::vec3 pointA = a.position + a.rotation * state.localA[k], pointB = b.position + b.rotation * state.localB[k];
+            glm::vec3 gap = pointB - pointA;
+            float separation = glm::dot(gap, found.normal);
+            glm::vec3 slide = gap - found.normal * separation;
+            if (separation > contactBreaking || glm::dot(slide, slide) > contactBreaking * contactBreaking) { continue; }
+            state.localA[kept] = state.localA[k];
+            state.localB[kept] = state.localB[k];
+            pointsA[kept] = pointA;
+            separations[kept++] = separation;
+        }
+        state.count = kept;
+        uint32_t slot = kept;
+        for (uint32_t k = 0; k < kept && slot == kept; ++k) {
+            glm::vec3 offset = pointsA[k] - found.pointA;
+            if (glm::dot(offset, offset) <= contactBreaking * contactBreaking) { slot = k; }
+        }
+        if (slot == maxPoints) {
+            uint32_t deepest{};
+            for (uint32_t k = 1; k < maxPoints; ++k) { deepest = separations[k] < separations[deepest] ? k : deepest; }
+            float largest = -1.0f;
+            for (uint32_t k = 0; k < maxPoints; ++k) {
+                if (k == deepest && separations[k] < found.separation) { continue; }
+                glm::vec3 p[maxPoints];
+                for (uint32_t j = 0; j < maxPoints; ++j) { p[j] = j == k ? found.pointA : pointsA[j]; }
+                //twice the area of the quad the four points make, whichever order they go around in
+                float area = std::max({glm::length(glm::cross(p[0] - p[1], p[2] - p[3])), glm::length(glm::cross(p[0] - p[2], p[1] - p[3])), glm::length(glm::cross(p[0] - p[3], p[1] - p[2]))});
+                if (area > largest) {
+                    largest = area;
+                    slot = k;
+                }
+            }
+        }
+        state.localA[slot] = glm::transpose(a.rotation) * (found.pointA - a.position);
+        state.localB[slot] = glm::transpose(b.rotation) * (found.pointB - b.position);
+        state.count = std::max(state.count, slot + 1);
+    }
+
+    //the point of a - b furthest along direction
+    static SupportPoint support(const ConvexPose &a, const ConvexPose &b, glm::vec3 direction) {
+        glm::vec3 pointA = a.support(direction), pointB = b.support(-direction);
+        return {pointA - pointB, pointA, pointB};
+    }
+
+    //run GJK on the cores of a and b, leaving in v the point of a - b closest to the origin and in simplex the points it lies on. Returns true if the cores overlap, in which case simplex holds every point found so far for EPA to start from.
+    static bool gjk(const ConvexPose &a, const ConvexPose &b, glm::vec3 axis, int maxIterations, Simplex &simplex, glm::vec3 &v, int &iterations) {
+        simplex.points[0] = support(a, b, axis);
+        simplex.weights[0] = 1.0f;
+        simplex.size = 1;
+        v = simplex.points[0].w;
+        iterations = 1;
+        float distance2 = glm::dot(v, v);
+        while (iterations < maxIterations) {
+            if (distance2 <= 1e-12f) { return true; }
+            SupportPoint next = support(a, b, -v);
+            ++iterations;
+            //the new point gets no closer to the origin than v does, so v is as close as the difference gets
+            if (distance2 - glm::dot(v, next.w) <= 1e-6f * distance2) { return false; }
+            bool repeated{};
+            for (int i = 0; i < simplex.size; ++i) { repeated |= simplex.points[i].w == next.w; }
+            if (repeated) { return false; }
+            simplex.points[simplex.size] = next;
+            ++simplex.size;
+            Simplex closer = simplex;
+            glm::vec3 closest;
+            if (!closestToOrigin(closer, closest)) {
+                simplex = closer;
+                return true;
+            }
+            float closerDistance2 = glm::dot(closest, closest);
+            //rounding can stop the distance from shrinking, at which point the last simplex is as good as it gets
+            if (closerDistance2 >= distance2) {
+                --simplex.size;
+                return false;
+            }
+            simplex = closer;
+            simplex.reduce();
+            v = closest;
+            distance2 = closerDistance2;
+        }
+        return distance2 <= 1e-12f;
+    }
+
+    //weigh the points of simplex towards the point closest to the origin and return it in closest. Returns false if the simplex is a tetrahedron holding the origin.
+    static bool closestToOrigin(Simplex &simplex, glm::vec3 &closest) {
+        SupportPoint *p = simplex.points;
+        float *weights = simplex.weights;
+        if (simplex.size == 2) {
+            glm::vec3 edge = p[1].w - p[0].w;
+            float t = std::clamp(-glm::dot(p[0].w, edge) / glm::dot(edge, edge), 0.0f, 1.0f);
+            weights[0] = 1.0f - t;
+            weights[1] = t;
+        } else if (simplex.size == 3) {
+            closestOnTriangle(p[0].w, p[1].w, p[2].w, weights);
+        } else {
+            //of the faces the origin lies outside of, the closest one holds the closest point
+            static constexpr int faces[4][4] = {{0, 1, 2, 3}, {0, 3, 1, 2}, {0, 2, 3, 1}, {1, 3, 2, 0}};
+            float best = INFINITY;
+            for (const int *face : faces) {
+                glm::vec3 normal = glm::cross(p[face[1]].w - p[face[0]].w, p[face[2]].w - p[face[0]].w);
+                float originSide = -glm::dot(normal, p[face[0]].w), otherSide = glm::dot(normal, p[face[3]].w - p[face[0]].w);
+                if (originSide * otherSide > 0.0f) { continue; }
+                float faceWeights[3];
+                closestOnTriangle(p[face[0]].w, p[face[1]].w, p[face[2]].w, faceWeights);
+                glm::vec3 point = p[face[0]].w * faceWeights[0] + p[face[1]].w * faceWeights[1] + p[face[2]].w * faceWeights[2];
+                float distance2 = glm::dot(point, point);
+                if (distance2 >= best) { continue; }
+                best = distance2;
+                for (int i = 0; i < 4; ++i) { weights[i] = 0.0f; }
+                for (int i = 0; i < 3; ++i) { weights[face[i]] = faceWeights[i]; }
+            }
+            if (best == INFINITY) { return false; }
+        }
+        closest = glm::vec3(0.0f);
+        for (int i = 0; i < simplex.size; ++i) { closest += p[i].w * weights[i]; }
+        return true;
+    }
+
+    //the barycentric weights of the point of triangle abc closest to the origin, by which Voronoi region of the triangle the origin lies in
+    static void closestOnTriangle(glm::vec3 a, glm::vec3 b, glm::vec3 c, float weights[3]) {
+        glm::vec3 ab = b - a, ac = c - a;
+        float d1 = -glm::dot(ab, a), d2 = -glm::dot(ac, a);
+        weights[0] = weights[1] = weights[2] = 0.0f;
+        if (d1 <= 0.0f && d2 <= 0.0f) { weights[0] = 1.0f; return; }
+        float d3 = -glm::dot(ab, b), d4 = -glm::dot(ac, b);
+        if (d3 >= 0.0f && d4 <= d3) { weights[1] = 1.0f; return; }
+        float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+            float t = d1 / (d1 - d3);
+            weights[0] = 1.0f - t;
+            weights[1] = t;
+            return;
+        }
+        float d5 = -glm::dot(ab, c), d6 = -glm::dot(ac, c);
+        if (d6 >= 0.0f && d5 <= d6) { weights[2] = 1.0f; return; }
+        float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+            float t = d2 / (d2 - d6);
+            weights[0] = 1.0f - t;
+            weights[2] = t;
+            return;
+        }
+        float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+            float t = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+            weights[1] = 1.0f - t;
+            weights[2] = t;
+            return;
+        }
+        float denominator = 1.0f / (va + vb + vc);
+        weights[1] = vb * denominator;
+        weights[2] = vc * denominator;
+        weights[0] = 1.0f - weights[1] - weights[2];
+    }
+
+    struct Face {
+        int a, b, c; //points of the polytope, wound so that normal faces out
+        glm::vec3 normal;
+        float distance; //from the origin to the plane of the face
+    };
+
+    static constexpr int maxPolytopePoints = 64;
+    static constexpr int maxPolytopeFaces = 2 * maxPolytopePoints;
+
+    //grow the simplex GJK ended with into a polytope of a - b until it finds the face closest to the origin, which gives the normal and depth of the overlap of the cores. Returns false if the simplex could not be grown around the origin.
+    static bool epa(const ConvexPose &a, const ConvexPose &b, const Simplex &simplex, int maxExpansions, glm::vec3 &normal, float &depth, glm::vec3 &pointA, glm::vec3 &pointB) {
+        SupportPoint points[maxPolytopePoints];
+        Face faces[maxPolytopeFaces];
+        int pointCount = simplex.size, faceCount{};
+        for (int i = 0; i < simplex.size; ++i) { points[i] = simplex.points[i]; }
+        if (!completeTetrahedron(a, b, points, pointCount)) { return false; }
+        glm::vec3 center = (points[0].w + points[1].w + points[2].w + points[3].w) * 0.25f;
+        static constexpr int tetrahedron[4][3] = {{0, 1, 2}, {0, 3, 1}, {0, 2, 3}, {1, 3, 2}};
+        for (const int *face : tetrahedron) {
+            if (!addFace(points, faces, faceCount, face[0], face[1], face[2], center)) { return false; }
+        }
+        int closest{};
+        for (int expansion = 0; expansion <= maxExpansions; ++expansion) {
+            closest = 0;
+            for (int i = 1; i < faceCount; ++i) {
+                if (faces[i].distance < faces[closest].distance) { closest = i; }
+            }
+            const Face face = faces[closest];
+            SupportPoint next = support(a, b, face.normal);
+            //the difference reaches no further past this face, so it is the closest
+            if (glm::dot(next.w, face.normal) - face.distance <= 1e-4f * std::max(1.0f, face.distance) || expansion == maxExpansions || pointCount == maxPolytopePoints) { break; }
+            //remove every face the new point can see, keeping the edges around the hole they leave
+            int edges[maxPolytopeFaces * 3][2];
+            int edgeCount{};
+            for (int i = 0; i < faceCount;) {
+                if (glm::dot(faces[i].normal, next.w - points[faces[i].a].w) <= 0.0f) {
+                    ++i;
+                    continue;
+                }
+                const int corners[3] = {faces[i].a, faces[i].b, faces[i].c};
+                for (int e = 0; e < 3; ++e) {
+                    int from = corners[e], to = corners[(e + 1) % 3];
+                    //an edge shared with another removed face is inside the hole, and that face has it the other way round
+                    bool shared{};
+                    for (int k = 0; k < edgeCount && !shared; ++k) {
+                        if (edges[k][0] != to || edges[k][1] != from) { continue; }
+                        edges[k][0] = edges[edgeCount - 1][0];
+                        edges[k][1] = edges[edgeCount - 1][1];
+                        --edgeCount;
+                        shared = true;
+                    }
+                    if (!shared) {
+                        edges[edgeCount][0] = from;
+                        edges[edgeCount][1] = to;
+                        ++edgeCount;
+                    }
+                }
+                faces[i] = faces[--faceCount];
+            }
+            if (faceCount + edgeCount > maxPolytopeFaces) { break; }
+            int added = pointCount++;
+            points[added] = next;
+            for (int e = 0; e < edgeCount; ++e) {
+                if (!addFace(points, faces, faceCount, edges[e][0], edges[e][1], added, center)) { return false; }
+            }
+        }
+        const Face &face = faces[closest];
+        //weigh the corners of the closest face towards the point on it nearest the origin
+        glm::vec3 onFace = face.normal * face.distance;
+        glm::vec3 v0 = points[face.b].w - points[face.a].w, v1 = points[face.c].w - points[face.a].w, v2 = onFace - points[face.a].w;
+        float d00 = glm::dot(v0, v0), d01 = glm::dot(v0, v1), d11 = glm::dot(v1, v1), d20 = glm::dot(v2, v0), d21 = glm::dot(v2, v1);
+        float denominator = d00 * d11 - d01 * d01;
+        float wb = denominator != 0.0f ? (d11 * d20 - d01 * d21) / denominator : 0.0f;
+        float wc = denominator != 0.0f ? (d00 * d21 - d01 * d20) / denominator : 0.0f;
+        float wa = 1.0f - wb - wc;
+        pointA = points[face.a].a * wa + points[face.b].a * wb + points[face.c].a * wc;
+        pointB = points[face.a].b * wa + points[face.b].b * wb + points[face.c].b * wc;
+        //the cores separate by moving a back along the face normal, so b lies ahead of a along it
+        normal = face.normal;
+        depth = std::max(face.distance, 0.0f);
+        return true;
+    }
+
+    //add points until the simplex is a tetrahedron with some volume, searching along the axes and then around what is already there
+    static bool completeTetrahedron(const ConvexPose &a, const ConvexPose &b, SupportPoint points[], int &count) {
+        const glm::vec3 axes[3] = {{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}};
+        if (count == 1) {
+            for (int i = 0; i < 6 && count == 1; ++i) {
+                SupportPoint next = support(a, b, i < 3 ? axes[i] : -axes[i - 3]);
+                if (glm::length(next.w - points[0].w) > 1e-6f) { points[count++] = next; }
+            }
+        }
+        if (count == 2) {
+            glm::vec3 line = points[1].w - points[0].w;
+            glm::vec3 least = std::abs(line.x) < std::abs(line.y) ? (std::abs(line.x) < std::abs(line.z) ? axes[0] : axes[2]) : (std::abs(line.y) < std::abs(line.z) ? axes[1] : axes[2]);
+            glm::vec3 across = glm::normalize(glm::cross(line, least)), around = glm::normalize(glm::cross(line, across));
+            for (int i = 0; i < 6 && count == 2; ++i) {
+                float angle = (float)i * 1.04719755f;
+                SupportPoint next = support(a, b, across * std::cos(angle) + around * std::sin(angle));
+                if (glm::length(glm::cross(next.w - points[0].w, line)) > 1e-6f * glm::length(line)) { points[count++] = next; }
+            }
+        }
+        if (count == 3) {
+            glm::vec3 normal = glm::cross(points[1].w - points[0].w, points[2].w - points[0].w);
+            if (glm::dot(normal, normal) == 0.0f) { return false; }
+            normal = glm::normalize(normal);
+            for (glm::vec3 direction : {normal, -normal}) {
+                SupportPoint next = support(a, b, direction);
+                if (std::abs(glm::dot(next.w - points[0].w, normal)) > 1e-6f) {
+                    points[count++] = next;
+                    break;
+                }
+            }
+        }
+        return count == 4;
+    }
+
+    static bool addFace(const SupportPoint points[], Face faces[], int &faceCount, int ia, int ib, int ic, glm::vec3 center) {
+        glm::vec3 normal = glm::cross(points[ib].w - points[ia].w, points[ic].w - points[ia].w);
+        float length = glm::length(normal);
+        if (length == 0.0f || faceCount == maxPolytopeFaces) { return false; }
+        normal /= length;
+        //faces of the first tetrahedron may come wound either way, so face them away from its center
+        if (glm::dot(normal, points[ia].w - center) < 0.0f) {
+            std::swap(ib, ic);
+            normal = -normal;
+        }
+        faces[faceCount++] = {ia, ib, ic, normal, glm::dot(normal, points[ia].w)};
+        return true;
+    }
+};
@@ -0,0 +1,441 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+#include <vector>
+
+#include "aabbTree.hpp"
+#include "lanes.hpp"
+#include "publishedState.hpp"
+#include "../Core/threadPool.hpp"
+
+//a liquid made of particles, simulated by smoothed particle hydrodynamics. Every substep the particles are sorted by the cell of a grid they fall in, so that the particles of neighboring cells sit side by side in memory; each particle's density is then summed from its neighbors, turned into a pressure, and the pressure and viscosity forces between neighbors move it. Particles are kept inside a box and pushed out of bodies.
+class Fluid {
+public:
+    float restDensity{1000.0f}; //the density the liquid settles at, in kilograms per cubic meter
+    float stiffness{200.0f}; //how strongly pressure pushes back against compression. Stiffer liquid needs more substeps to stay stable.
+    float viscosity{1.0f}; //how strongly neighbors drag each other towards the same velocity
+    float restitution{0.0f}; //the fraction of its speed into a wall or body a particle keeps after bouncing off it
+    glm::vec3 gravity{0.0f, 0.0f, -9.81f}; //acceleration of every particle, kept apart from the world's gravity as cloth's is
+    AABB container{glm::vec3(-1.0f), glm::vec3(1.0f)}; //the box the liquid is kept in
+    int substeps{4}; //substeps per tick. Below about three, the default stiffness blows the liquid apart at 60 ticks a second.
+    size_t particlesPerTask{4096}; //the most particles in one task when stepped on a thread pool. Results do not depend on the thread count, but do depend on this.
+    TripleBuffer<PublishedFluid> published; //where every particle was as of the last publish, for a renderer on another thread to read with published.acquire()
+
+    //a liquid whose particles start spacing apart, each feeling neighbors within smoothingLength
+    explicit Fluid(float spacing = 0.05f, float smoothingLength = 0.0f) : spacing(spacing), h(smoothingLength > 0.0f ? smoothingLength : 2.0f * spacing) {
+        //the density kernel summed over a particle's neighbors in a grid of the starting spacing, so that liquid starts at rest density
+        int reach = (int)std::ceil(h / spacing);
+        float latticeSum{};
+        for (int i = -reach; i <= reach; ++i) {
+            for (int j = -reach; j <= reach; ++j) {
+                for (int k = -reach; k <= reach; ++k) {
+                    float r2 = (float)(i * i + j * j + k * k) * spacing * spacing;
+                    if (r2 < h * h) { latticeSum += std::pow(h - std::sqrt(r2), 3.0f); }
+                }
+            }
+        }
+        densityConstant = 15.0f / (std::numbers::pi_v<float> * std::pow(h, 6.0f));
+        massPerDensity = 1.0f / (densityConstant * latticeSum);
+        gradientConstant = 45.0f / (std::numbers::pi_v<float> * std::pow(h, 6.0f));
+    }
+
+    [[nodiscard]] size_t particleCount() const {
+        return x.size();
+    }
+
+    [[nodiscard]] float particleSpacing() const {
+        return spacing;
+    }
+
+    [[nodiscard]] float smoothingLength() const {
+        return h;
+    }
+
+    //the mass of every particle, so that particles spacing apart are at rest density
+    [[nodiscard]] float particleMass() const {
+        return restDensity * massPerDensity;
+    }
+
+    //particles are stored in the order of the grid, which changes every substep
+    [[nodiscard]] glm::vec3 position(size_t particle) const {
+        return {x[particle], y[particle], z[particle]};
+    }
+
+    [[nodiscard]] glm::vec3 velocity(size_t particle) const {
+        return {vX[particle], vY[particle], vZ[particle]};
+    }
+
+    [[nodiscard]] float density(size_t particle) const {
+        return densities[particle];
+    }
+
+    void addParticle(glm::vec3 p, glm::vec3 v = glm::vec3(0.0f)) {
+        x.push_back(p.x);
+        y.push_back(p.y);
+        z.push_back(p.z);
+        vX.push_back(v.x);
+        vY.push_back(v.y);
+        vZ.push_back(v.z);
+        previousX.push_back(p.x);
+        previousY.push_back(p.y);
+        previousZ.push_back(p.z);
+        densities.push_back(restDensity);
+    }
+
+    //fill region with particles spacing apart, moving at v. Returns the number added.
+    size_t fill(const AABB &region, glm::vec3 v = glm::vec3(0.0f)) {
+        glm::ivec3 counts = glm::max(glm::ivec3((region.max - region.min) / spacing) + 1, glm::ivec3(0));
+        size_t added = (size_t)counts.x * counts.y * counts.z;
+        for (std::vector<float> *array : {&x, &y, &z, &vX, &vY, &vZ, &previousX, &previousY, &previousZ, &densities}) { array->reserve(array->size() + added); }
+        for (int k = 0; k < counts.z; ++k) {
+            for (int j = 0; j < counts.y; ++j) {
+                for (int i = 0; i < counts.x; ++i) { addParticle(region.min + glm::vec3((float)i, (float)j, (float)k) * spacing, v); }
+            }
+        }
+        return added;
+    }
+
+    void clear() {
+        for (std::vector<float> *array : {&x, &y, &z, &vX, &vY, &vZ, &previousX, &previousY, &previousZ, &densities}) { array->clear(); }
+    }
+
+    //advance the liquid by dt seconds, pushing it out of count spheres, each a center and radius. Stepping on threadPool gives the same result as stepping without one.
+    void step(float dt, const glm::vec4 *spheres, size_t sphereCount, ThreadPool *threadPool = nullptr) {
+        if (x.empty() || substeps <= 0) { return; }
+        float substep = dt / (float)substeps;
+        for (int i = 0; i < substeps; ++i) {
+            sortIntoGrid(threadPool);
+            forTasks(threadPool, [&](size_t begin, size_t end) { sumDensities(begin, end); });
+            forTasks(threadPool, [&](size_t begin, size_t end) { applyForces(substep, spheres, sphereCount, begin, end); });
+            std::swap(x, sorted[0]);
+            std::swap(y, sorted[1]);
+            std::swap(z, sorted[2]);
+            std::swap(vX, sorted[3]);
+            std::swap(vY, sorted[4]);
+            std::swap(vZ, sorted[5]);
+        }
+    }
+
+    //remember where every particle is, to blend from until the next call. World::update calls this before the last tick of every update, as it does BodyStore::savePrevious.
+    void savePrevious() {
+        previousX = x;
+        previousY = y;
+        previousZ = z;
+    }
+
+    //blend every particle alpha of the way from its previous position to its current one, and hand the positions to the reader through published. Called by World::publish.
+    void publish(float alpha) {
+        PublishedFluid &state = published.back();
+        state.positions.resize(x.size());
+        for (size_t i = 0; i < x.size(); ++i) { state.positions[i] = glm::mix(glm::vec3(previousX[i], previousY[i], previousZ[i]), glm::vec3(x[i], y[i], z[i]), alpha); }
+        state.frame = ++publishedFrames;
+        published.publish();
+    }
+
+private:
+#if defined(CRYSTAL_ENGINE_PHYSICS_AVX)
+    using Lanes = AVXLanes;
+#elif defined(CRYSTAL_ENGINE_PHYSICS_SSE)
+    using Lanes = SSELanes;
+#else
+    using Lanes = ScalarLanes;
+#endif
+
+    static constexpr float laneOffsets[8]{0, 1, 2, 3, 4, 5, 6, 7}; //the index of every lane, to mask off lanes past the end of a run
+
+    float spacing, h;
+    float densityConstant{}, gradientConstant{}, massPerDensity{};
+    std::vector<float> x, y, z, vX, vY, vZ; //in grid order after a substep's sort
+    std::vector<float> previousX, previousY, previousZ; //positions before the last tick of the last update, kept in the same order
+    std::vector<float> densities, inverseDensities, pressureTerms; //pressure terms are pressure over density squared, the part of the pressure force each particle of a pair brings
+    uint64_t publishedFrames{};
+
+    //the grid is a hash table of cells. Adding a cell's x coordinate after hashing its y and z keeps the three cells of a row next to each other in the table, and so next to each other in memory once particles are sorted by cell.
+    uint32_t tableMask{};
+    std::vector<uint32_t> keys, sortedKeys, order, sortedOrder; //the cell of every particle, and the particle at every place in grid order
+    std::vector<uint32_t> histograms; //one count of every digit for every task of a sorting pass
+    std::vector<uint32_t> cellStart, cellEnd; //the particles of each cell in grid order, empty for cells with none
+    std::vector<float> sorted[9]; //somewhere to move position, velocity and previous position into without overwriting what is being read
+
+    [[nodiscard]] glm::ivec3 cellOf(float px, float py, float pz) const {
+        return {(int)std::floor(px / h), (int)std::floor(py / h), (int)std::floor(pz / h)};
+    }
+
+    [[nodiscard]] uint32_t rowKey(int cellY, int cellZ, int cellX) const {
+        return ((uint32_t)cellY * 73856093u ^ (uint32_t)cellZ * 19349663u) + (uint32_t)cellX;
+    }
+
+    [[nodiscard]] size_t grain() const {
+        return std::max<size_t>(particlesPerTask, 1);
+    }
+
+    //run body over every particle in the same chunks whether or not there is a thread pool, so that results never depend on it
+    template<typename Body> void forTasks(ThreadPool *threadPool, Body body) {
+        size_t count = x.size(), size = grain();
+        if (threadPool != nullptr) {
+            threadPool->parallelFor(count, size, body);
+            return;
+        }
+        for (size_t begin = 0; begin < count; begin += size) { body(begin, std::min(count, begin + size)); }
+    }
+
+    //sort particles by cell with two stable counting passes over the digits of the cell's key, then move every particle attribute into that order
+    void sortIntoGrid(ThreadPool *threadPool) {
+        size_t count = x.size();
+        uint32_t tableBits = std::max(10, (int)std::ceil(std::log2((double)count * 2.0)));
+        uint32_t tableSize = 1u << tableBits;
+        if (tableMask != tableSize - 1) {
+            tableMask = tableSize - 1;
+            cellStart.assign(tableSize, 0);
+            cellEnd.assign(tableSize, 0);
+        } else {
+            //only the cells filled last substep need emptying
+            for (uint32_t key : sortedKeys) { cellStart[key] = cellEnd[key] = 0; }
+        }
+        keys.resize(count);
+        sortedKeys.resize(count);
+        order.resize(count);
+        sortedOrder.resize(count);
+        forTasks(threadPool, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                glm::ivec3 cell = cellOf(x[i], y[i], z[i]);
+                keys[i] = rowKey(cell.y, cell.z, cell.x) & tableMask;
+            }
+        });
+        uint32_t lowBits = (tableBits + 1) / 2;
+        sortPass(threadPool, keys.data(), nullptr, sortedKeys.data(), sortedOrder.data(), 0, lowBits);
+        sortPass(threadPool, sortedKeys.data(), sortedOrder.data(), keys.data(), order.data(), lowBits, tableBits - lowBits);
+        std::swap(keys, sortedKeys);
+        std::swap(order, sortedOrder);
+        //sortedKeys and sortedOrder now hold every particle's key and index in grid order
+        std::vector<float> *attributes[9] = {&x, &y, &z, &vX, &vY, &vZ, &previousX, &previousY, &previousZ};
+        for (std::vector<float> &array : sorted) { array.resize(count); }
+        forTasks(threadPool, [&](size_t begin, size_t end) {
+            for (int a = 0; a < 9; ++a) {
+                const float *from = attributes[a]->data();
+                float *to = sorted[a].data();
+                for (size_t i = begin; i < end; ++i) { to[i] = from[sortedOrder[i]]; }
+            }
+            for (size_t i = begin; i < end; ++i) {
+                uint32_t key = sortedKeys[i];
+                if (i == 0 || sortedKeys[i - 1] != key) { cellStart[key] = (uint32_t)i; }
+                if (i + 1 == count || sortedKeys[i + 1] != key) { cellEnd[key] = (uint32_t)i + 1; }
+            }
+        });
+        for (int a = 0; a < 9; ++a) { std::swap(*attributes[a], sorted[a]); }
+        densities.resize(count);
+        inverseDensities.resize(count);
+        pressureTerms.resize(count);
+    }
+
+    //stably sort keysIn by bits of their key from shift up, carrying each particle's index along. Every task counts the digits of its own particles, and then places them after everything of a lower digit and everything of the same digit in an earlier task.
+    void sortPass(ThreadPool *threadPool, const uint32_t *keysIn, const uint32_t *indicesIn, uint32_t *keysOut, uint32_t *indicesOut, uint32_t shift, uint32_t bits) {
+        size_t count = x.size(), size = grain(), tasks = (count + size - 1) / size;
+        uint32_t buckets = 1u << bits, digitMask = buckets - 1;
+        histograms.assign(tasks * buckets, 0);
+        forTasks(threadPool, [&](size_t begin, size_t end) {
+            uint32_t *histogram = histograms.data() + begin / size * buckets;
+            for (size_t i = begin; i < end; ++i) { ++histogram[keysIn[i] >> shift & digitMask]; }
+        });
+        uint32_t offset{};
+        for (uint32_t digit = 0; digit < buckets; ++digit) {
+            for (size_t task = 0; task < tasks; ++task) {
+                uint32_t digitCount = histograms[task * buckets + digit];
+                histograms[task * buckets + digit] = offset;
+                offset += digitCount;
+            }
+        }
+        forTasks(threadPool, [&](size_t begin, size_t end) {
+            uint32_t *histogram = histograms.data() + begin / size * buckets;
+            for (size_t i = begin; i < end; ++i) {
+                uint32_t place = histogram[keysIn[i] >> shift & digitMask]++;
+                keysOut[place] = keysIn[i];
+                indicesOut[place] = indicesIn != nullptr ? indicesIn[i] : (uint32_t)i;
+            }
+        });
+    }
+
+    //the part of the density kernel's weight that falls past a wall distance away, as though the wall were backed by liquid at rest density: the kernel integrated over the half space past the wall, which for (h - r)^3 comes to 3/2 g^5 - g^6 with g = 1 - distance / h
+    [[nodiscard]] float wallFraction(float distance) const {
+        float g = 1.0f - std::clamp(distance / h, 0.0f, 1.0f), g5 = g * g * g * g * g;
+        return g5 * (1.5f - g);
+    }
+
+    //how fast wallFraction falls as distance grows
+    [[nodiscard]] float wallSlope(float distance) const {
+        float g = 1.0f - std::clamp(distance / h, 0.0f, 1.0f), g4 = g * g * g * g;
+        return g4 * (7.5f - 6.0f * g) / h;
+    }
+
+    //call visit with every run of particles in grid order that may be within the smoothing length of particle i: the three cells of each of the nine rows around it, which are one run unless the row wraps around the table. Rows whose keys collide can share particles, so runs are merged where they overlap to visit every particle once.
+    template<typename Visit> void forNeighborRuns(size_t i, Visit visit) const {
+        glm::ivec3 cell = cellOf(x[i], y[i], z[i]);
+        uint32_t begins[27], ends[27];
+        int runs{};
+        auto addRun = [&](uint32_t begin, uint32_t end) {
+            //kept sorted by where each run begins
+            int place = runs++;
+            for (; place > 0 && begins[place - 1] > begin; --place) {
+                begins[place] = begins[place - 1];
+                ends[place] = ends[place - 1];
+            }
+            begins[place] = begin;
+            ends[place] = end;
+        };
+        for (int dz = -1; dz <= 1; ++dz) {
+            for (int dy = -1; dy <= 1; ++dy) {
+                uint32_t middle = rowKey(cell.y + dy, cell.z + dz, cell.x) & tableMask;
+                uint32_t first = (middle - 1) & tableMask, last = (middle + 1) & tableMask;
+                if (first < last) {
+                    //empty cells have an empty range, so the run starts at the first filled cell and ends after the last
+                    uint32_t begin = UINT32_MAX, end{};
+                    for (uint32_t key = first; key <= last; ++key) {
+                        if (cellStart[key] == cellEnd[key]) { continue; }
+                        begin = std::min(begin, cellStart[key]);
+                        end = std::max(end, cellEnd[key]);
+                    }
+                    if (begin < end) { addRun(begin, end); }
+                } else {
+                    for (uint32_t key : {first, middle, last}) {
+                        if (cellStart[key] != cellEnd[key]) { addRun(cellStart[key], cellEnd[key]); }
+                    }
+                }
+            }
+        }
+        for (int run = 0; run < runs;) {
+            uint32_t begin = begins[run], end = ends[run];
+            for (++run; run < runs && begins[run] <= end; ++run) { end = std::max(end, ends[run]); }
+            visit(begin, end);
+        }
+    }
+
+    //sum the density of every particle in [begin, end) from its neighbors, itself included, and turn it into a pressure
+    void sumDensities(size_t begin, size_t end) {
+        float mass = particleMass();
+        for (size_t i = begin; i < end; ++i) {
+            float sum = densityAt<Lanes>(i);
+            float walls{};
+            for (int axis = 0; axis < 3; ++axis) { walls += wallFraction(position(i)[axis] - container.min[axis]) + wallFraction(container.max[axis] - position(i)[axis]); }
+            densities[i] = mass * densityConstant * sum + restDensity * walls;
+            inverseDensities[i] = 1.0f / densities[i];
+            //liquid pulls on nothing, so pressure never goes below zero, which keeps sparse particles from clumping
+            pressureTerms[i] = std::max(stiffness * (densities[i] - restDensity), 0.0f) * inverseDensities[i] * inverseDensities[i];
+        }
+    }
+
+    //the sum of (h - r)^3, the spiky kernel without its constant, over every particle within the smoothing length of particle i. Each run of neighbors is read a whole vector at a time, lanes past the run's end masked off, except within a vector of the last particle, which is read one at a time.
+    template<typename L> [[nodiscard]] float densityAt(size_t i) const {
+        using F = typename L::Float;
+        constexpr size_t width = L::width;
+        F px = L::set(x[i]), py = L::set(y[i]), pz = L::set(z[i]), radius = L::set(h), zero = L::set(0.0f), total = zero, offsets = L::load(laneOffsets);
+        size_t vectorEnd = x.size() - std::min(x.size(), width - 1);
+        float sum{};
+        forNeighborRuns(i, [&](uint32_t first, uint32_t last) {
+            uint32_t j = first;
+            for (; j < last && j < vectorEnd; j += width) {
+                F dx = L::sub(L::load(x.data() + j), px), dy = L::sub(L::load(y.data() + j), py), dz = L::sub(L::load(z.data() + j), pz);
+                F r2 = L::add(L::add(L::mul(dx, dx), L::mul(dy, dy)), L::mul(dz, dz));
+                F gap = L::select(L::less(L::add(L::set((float)j), offsets), L::set((float)last)), L::max(L::sub(radius, L::sqrt(r2)), zero), zero);
+                total = L::add(total, L::mul(L::mul(gap, gap), gap));
+            }
+            for (; j < last; ++j) {
+                glm::vec3 d(x[j] - x[i], y[j] - y[i], z[j] - z[i]);
+                float gap = std::max(h - glm::length(d), 0.0f);
+                sum += gap * gap * gap;
+            }
+        });
+        float lanes[width];
+        L::store(lanes, total);
+        for (float lane : lanes) { sum += lane; }
+        return sum;
+    }
+
+    //accelerate every particle in [begin, end) by the pressure and viscosity of its neighbors and by gravity, move it for dt seconds, and keep it inside the container and out of the spheres. Moved positions and velocities go into sorted, so that every particle can be moved at once while its neighbors are still read where they were.
+    void applyForces(float dt, const glm::vec4 *spheres, size_t sphereCount, size_t begin, size_t end) {
+        float mass = particleMass();
+        for (size_t i = begin; i < end; ++i) {
+            glm::vec3 p(x[i], y[i], z[i]), v(vX[i], vY[i], vZ[i]);
+            //the walls push as liquid at rest density and the particle's own pressure would, so that the liquid rests against them at its own spacing
+            glm::vec3 walls{};
+            for (int axis = 0; axis < 3; ++axis) { walls[axis] = wallSlope(p[axis] - container.min[axis]) - wallSlope(container.max[axis] - p[axis]); }
+            v += (accelerationAt<Lanes>(i) * (mass * gradientConstant) + walls * (restDensity * pressureTerms[i]) + gravity) * dt;
+            p += v * dt;
+            for (size_t s = 0; s < sphereCount; ++s) {
+                glm::vec3 offset = p - glm::vec3(spheres[s]);
+                float distance2 = glm::dot(offset, offset), reach = spheres[s].w + 0.5f * spacing;
+                if (distance2 >= reach * reach || distance2 == 0.0f) { continue; }
+                float distance = std::sqrt(distance2);
+                glm::vec3 normal = offset / distance;
+                p += normal * (reach - distance);
+                float into = glm::dot(v, normal);
+                if (into < 0.0f) { v -= normal * (into * (1.0f + restitution)); }
+            }
+            //pressure keeps particles off the walls, so this only catches particles moving too fast to be stopped in a substep
+            for (int axis = 0; axis < 3; ++axis) {
+                if (p[axis] < container.min[axis]) {
+                    p[axis] = container.min[axis];
+                    v[axis] = std::max(v[axis], -v[axis] * restitution);
+                } else if (p[axis] > container.max[axis]) {
+                    p[axis] = container.max[axis];
+                    v[axis] = std::min(v[axis], -v[axis] * restitution);
+                }
+            }
+            sorted[0][i] = p.x;
+            sorted[1][i] = p.y;
+            sorted[2][i] = p.z;
+            sorted[3][i] = v.x;
+            sorted[4][i] = v.y;
+            sorted[5][i] = v.z;
+        }
+    }
+
+    //the pressure and viscosity acceleration of particle i from every other particle within the smoothing length, leaving out the mass and kernel constant shared by every term and i's own density. Runs are read as in densityAt.
+    template<typename L> [[nodiscard]] glm::vec3 accelerationAt(size_t i) const {
+        using F = typename L::Float;
+        constexpr size_t width = L::width;
+        const float *px = x.data(), *py = y.data(), *pz = z.data(), *velocityX = vX.data(), *velocityY = vY.data(), *velocityZ = vZ.data();
+        glm::vec3 p(x[i], y[i], z[i]), v(vX[i], vY[i], vZ[i]), acceleration{};
+        F zero = L::set(0.0f), radius = L::set(h), reach2 = L::set(h * h), tiny = L::set(1e-12f), offsets = L::load(laneOffsets);
+        F pointX = L::set(p.x), pointY = L::set(p.y), pointZ = L::set(p.z), velocityOfX = L::set(v.x), velocityOfY = L::set(v.y), velocityOfZ = L::set(v.z);
+        F pressure = L::set(pressureTerms[i]), drag = L::set(viscosity * inverseDensities[i]);
+        F ax = zero, ay = zero, az = zero;
+        size_t vectorEnd = x.size() - std::min(x.size(), width - 1);
+        forNeighborRuns(i, [&](uint32_t first, uint32_t last) {
+            uint32_t j = first;
+            for (; j < last && j < vectorEnd; j += width) {
+                F dx = L::sub(pointX, L::load(px + j)), dy = L::sub(pointY, L::load(py + j)), dz = L::sub(pointZ, L::load(pz + j));
+                F r2 = L::add(L::add(L::mul(dx, dx), L::mul(dy, dy)), L::mul(dz, dz));
+                auto near = L::both(L::both(L::less(r2, reach2), L::less(tiny, r2)), L::less(L::add(L::set((float)j), offsets), L::set((float)last)));
+                if (L::bits(near) == 0) { continue; }
+                F r = L::sqrt(L::max(r2, tiny));
+                F gap = L::max(L::sub(radius, r), zero);
+                F inverseDensity = L::load(inverseDensities.data() + j);
+                //the spiky kernel's gradient for pressure, pushing i away from j, and the viscosity kernel's laplacian pulling their velocities together
+                F push = L::div(L::mul(L::add(pressure, L::load(pressureTerms.data() + j)), L::mul(gap, gap)), r);
+                F pull = L::mul(L::mul(drag, gap), inverseDensity);
+                push = L::select(near, push, zero);
+                pull = L::select(near, pull, zero);
+                ax = L::add(ax, L::add(L::mul(dx, push), L::mul(L::sub(L::load(velocityX + j), velocityOfX), pull)));
+                ay = L::add(ay, L::add(L::mul(dy, push), L::mul(L::sub(L::load(velocityY + j), velocityOfY), pull)));
+                az = L::add(az, L::add(L::mul(dz, push), L::mul(L::sub(L::load(velocityZ + j), velocityOfZ), pull)));
+            }
+            for (; j < last; ++j) {
+                glm::vec3 d = p - glm::vec3(x[j], y[j], z[j]);
+                float r2 = glm::dot(d, d);
+                if (r2 >= h * h || r2 <= 1e-12f) { continue; }
+                float r = std::sqrt(r2), gap = h - r;
+                acceleration += d * ((pressureTerms[i] + pressureTerms[j]) * gap * gap / r) + (glm::vec3(vX[j], vY[j], vZ[j]) - v) * (viscosity * inverseDensities[i] * gap * inverseDensities[j]);
+            }
+        });
+        float lanes[3][width];
+        L::store(lanes[0], ax);
+        L::store(lanes[1], ay);
+        L::store(lanes[2], az);
+        for (size_t lane = 0; lane < width; ++lane) { acceleration += glm::vec3(lanes[0][lane], lanes[1][lane], lanes[2][lane]); }
+        return acceleration;
+    }
+};
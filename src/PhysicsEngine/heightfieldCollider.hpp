@@ -0,0 +1,415 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "aabbTree.hpp"
+#include "bodyStore.hpp"
+#include "narrowphase.hpp"
+
+//the first hit of a ray on a heightfield
+struct HeightfieldHit {
+    uint32_t triangle{UINT32_MAX}; //two for every cell, row by row, or UINT32_MAX if the ray hit nothing
+    float t{INFINITY}; //how far along the ray the hit is, in lengths of its direction
+    glm::vec3 normal{}; //unit normal of the triangle hit, facing back along the ray
+    glm::vec3 point{};
+};
+
+//static terrain given as heights sampled on a regular grid over x and y, with z up, such as a displacement image. Only the 16 bit samples are kept, so a large terrain costs two bytes a sample rather than the triangles of a mesh collider, plus a pyramid of the lowest and highest sample of every tile of cells and of every square of tiles above that, which lets queries skip whatever they pass over or under.
+class HeightfieldCollider {
+public:
+    static constexpr uint32_t tileSize = 8; //cells along each side of a tile at the bottom of the pyramid
+    static constexpr uint32_t maxContacts = 4; //the most contacts a sphere gets, so that a fine grid under a large sphere does not swamp the solver
+    static constexpr float mergeCosine = 0.95f; //contacts whose normals are closer than this are merged into the one with the least separation
+
+    HeightfieldCollider() = default;
+
+    //build from columns by rows samples, row by row along y. Sample 0 lies at origin, the last sample of the last row at origin + size, and a sample of 65535 is size.z above origin.
+    HeightfieldCollider(const uint16_t *samples, uint32_t columns, uint32_t rows, glm::vec3 origin, glm::vec3 size) {
+        build(samples, columns, rows, origin, size, 1);
+    }
+
+    //build from 8 bit samples, such as an image loaded with one channel, so that a sample of 255 is size.z above origin
+    HeightfieldCollider(const uint8_t *samples, uint32_t columns, uint32_t rows, glm::vec3 origin, glm::vec3 size) {
+        build(samples, columns, rows, origin, size, 257);
+    }
+
+    [[nodiscard]] uint32_t columnCount() const {
+        return columns;
+    }
+
+    [[nodiscard]] uint32_t rowCount() const {
+        return rows;
+    }
+
+    //the box holding every sample
+    [[nodiscard]] AABB bounds() const {
+        if (levels.empty()) { return {}; }
+        Range root = levels.back().ranges[0];
+        return {{origin.x, origin.y, heightOf(root.min)}, {origin.x + (float)(columns - 1) * spacing.x, origin.y + (float)(rows - 1) * spacing.y, heightOf(root.max)}};
+    }
+
+    //the height of the surface above x, y, or NAN off the heightfield
+    [[nodiscard]] float height(float x, float y) const {
+        glm::ivec2 cell;
+        glm::vec2 inside;
+        if (!locate(x, y, cell, inside)) { return NAN; }
+        Corners corners = cornersOf((uint32_t)cell.x, (uint32_t)cell.y);
+        return inside.x >= inside.y ? corners.a.z + (corners.b.z - corners.a.z) * inside.x + (corners.d.z - corners.b.z) * inside.y : corners.a.z + (corners.d.z - corners.c.z) * inside.x + (corners.c.z - corners.a.z) * inside.y;
+    }
+
+    //append a contact to contacts for the parts of the surface that sphere body of the store comes within reach of over the next dt seconds, keeping at most maxContacts. The contacts are between body and fieldBody, the static body standing in for this heightfield, and keep the triangle as their feature. A sphere whose center has sunk below the surface is pushed straight back out of the triangle under it. Safe to call from several threads at once.
+    void collide(const BodyStore &store, uint32_t body, uint32_t fieldBody, float dt, std::vector<Contact> &contacts) const {
+        if (levels.empty()) { return; }
+        glm::vec3 center(store.posX[body], store.posY[body], store.posZ[body]), displacement = glm::vec3(store.vX[body], store.vY[body], store.vZ[body]) * dt;
+        float radius = store.r[body];
+        float reach = radius + glm::length(displacement);
+        glm::ivec2 cell;
+        glm::vec2 inside;
+        if (locate(center.x, center.y, cell, inside)) {
+            Corners corners = cornersOf((uint32_t)cell.x, (uint32_t)cell.y);
+            uint32_t half = inside.x >= inside.y ? 0 : 1;
+            glm::vec3 a = corners.a, b = half == 0 ? corners.b : corners.d, c = half == 0 ? corners.d : corners.c;
+            glm::vec3 up = glm::normalize(glm::cross(b - a, c - a));
+            float above = glm::dot(center - a, up);
+            if (above < 0.0f) {
+                glm::vec3 surface = center - up * above;
+                contacts.push_back({body, fieldBody, 0.0f, -up, radius - above, surface + up * (0.5f * (above - radius)), triangleOf((uint32_t)cell.x, (uint32_t)cell.y, half) + 1, above - radius});
+                return;
+            }
+        }
+        //the cells under the sphere's reach
+        glm::vec2 low = (glm::vec2(center) - reach - glm::vec2(origin)) / spacing, high = (glm::vec2(center) + reach - glm::vec2(origin)) / spacing;
+        if (high.x < 0.0f || high.y < 0.0f || low.x > (float)(columns - 1) || low.y > (float)(rows - 1)) { return; }
+        glm::uvec2 first(clampCell(low.x, columns), clampCell(low.y, rows)), last(clampCell(high.x, columns), clampCell(high.y, rows));
+        float bottom = center.z - reach;
+        Contact kept[maxContacts];
+        uint32_t keptCount{};
+        Node stack[maxLevels * 3 + 1];
+        uint32_t size{};
+        stack[size++] = {(uint32_t)levels.size() - 1, 0, 0};
+        while (size != 0) {
+            Node node = stack[--size];
+            uint32_t span = tileSize << node.level;
+            glm::uvec2 from = glm::max(first, glm::uvec2(node.x, node.y) * span), to = glm::min(last, (glm::uvec2(node.x, node.y) + 1u) * span - 1u);
+            if (from.x > to.x || from.y > to.y) { continue; }
+            if (heightOf(rangeOf(node).max) < bottom) { continue; }
+            if (node.level != 0) {
+                pushChildren(node, stack, size);
+                continue;
+            }
+            for (uint32_t j = from.y; j <= to.y; ++j) {
+                for (uint32_t i = from.x; i <= to.x; ++i) {
+                    Corners corners = cornersOf(i, j);
+                    if (std::max(std::max(corners.a.z, corners.b.z), std::max(corners.c.z, corners.d.z)) < bottom) { continue; }
+                    for (uint32_t half = 0; half < 2; ++half) {
+                        glm::vec3 a = corners.a, b = half == 0 ? corners.b : corners.d, c = half == 0 ? corners.d : corners.c;
+                        //only the top of the surface is solid, and a center under it was handled above
+                        glm::vec3 up = glm::cross(b - a, c - a);
+                        if (glm::dot(center - a, up) < 0.0f) { continue; }
+                        glm::vec3 point = closestPoint(a, b, c, center);
+                        float d = glm::length(point - center);
+                        if (d > reach) { continue; }
+                        glm::vec3 normal = d > 0.0f ? (point - center) / d : -glm::normalize(up);
+                        float closing = glm::dot(displacement, normal);
+                        float toi = d <= radius ? 0.0f : closing > 0.0f ? std::min((d - radius) / closing, 1.0f) : 1.0f;
+                        keep({body, fieldBody, toi, normal, std::max(radius - d, 0.0f), point - normal * (0.5f * (d - radius)), triangleOf(i, j, half) + 1, d - radius}, kept, keptCount);
+                    }
+                }
+            }
+        }
+        contacts.insert(contacts.end(), kept, kept + keptCount);
+    }
+
+    //find where ray first hits the surface from above or below, walking down the pyramid front to back and then cell by cell through the tiles it reaches. Returns false, leaving hit untouched, if it hits nothing within ray.maxT.
+    bool raycast(const Ray &ray, HeightfieldHit &hit) const {
+        if (levels.empty()) { return false; }
+        glm::vec3 inverseDirection = 1.0f / ray.direction;
+        float enter{}, exit{};
+        if (!clip(ray, inverseDirection, bounds(), 0.0f, ray.maxT, enter, exit)) { return false; }
+        Node stack[maxLevels * 3 + 1];
+        uint32_t size{};
+        stack[size++] = {(uint32_t)levels.size() - 1, 0, 0};
+        while (size != 0) {
+            Node node = stack[--size];
+            float from{}, to{};
+            if (!crosses(ray, inverseDirection, node, enter, exit, from, to)) { continue; }
+            if (node.level == 0) {
+                if (walkTile(ray, inverseDirection, node, from, to, hit)) { return true; }
+                continue;
+            }
+            //the nearest child is pushed last, so that it is walked first; a hit in it is nearer than anything in the others, since the columns over the children split the ray between them
+            Node children[4];
+            float entries[4];
+            uint32_t count{};
+            for (uint32_t k = 0; k < 4; ++k) {
+                Node child{node.level - 1, node.x * 2 + (k & 1), node.y * 2 + (k >> 1)};
+                if (child.x >= levels[child.level].columns || child.y >= levels[child.level].rows) { continue; }
+                float childFrom{}, childTo{};
+                if (!crosses(ray, inverseDirection, child, enter, exit, childFrom, childTo)) { continue; }
+                uint32_t place = count++;
+                for (; place > 0 && entries[place - 1] < childFrom; --place) {
+                    children[place] = children[place - 1];
+                    entries[place] = entries[place - 1];
+                }
+                children[place] = child;
+                entries[place] = childFrom;
+            }
+            for (uint32_t k = 0; k < count; ++k) { stack[size++] = children[k]; }
+        }
+        return false;
+    }
+
+    //cast count rays, writing the first hit of each to hits. Rays that hit nothing get a hit with triangle UINT32_MAX. Returns the number of rays that hit the heightfield.
+    size_t raycast(const Ray *rays, size_t count, HeightfieldHit *hits) const {
+        size_t found{};
+        for (size_t i = 0; i < count; ++i) {
+            hits[i] = {};
+            if (raycast(rays[i], hits[i])) { ++found; }
+        }
+        return found;
+    }
+
+private:
+    static constexpr uint32_t maxLevels = 32;
+
+    //the lowest and highest sample of a tile, or of a square of tiles higher up the pyramid
+    struct Range {
+        uint16_t min, max;
+    };
+
+    struct Level {
+        uint32_t columns, rows;
+        std::vector<Range> ranges;
+    };
+
+    struct Node {
+        uint32_t level, x, y;
+    };
+
+    //the samples at the corners of a cell: a at its lowest x and y, b along x from a, c along y from a, and d across from a. The cell is split along a to d into triangles abd and adc.
+    struct Corners {
+        glm::vec3 a, b, c, d;
+    };
+
+    uint32_t columns{}, rows{};
+    glm::vec3 origin{};
+    glm::vec2 spacing{1.0f};
+    float heightScale{};
+    std::vector<uint16_t> samples;
+    std::vector<Level> levels; //tiles first, up to a single range over everything
+
+    template<typename Sample> void build(const Sample *from, uint32_t columnCount, uint32_t rowCount, glm::vec3 at, glm::vec3 size, uint16_t scale) {
+        if (columnCount < 2 || rowCount < 2) { return; }
+        columns = columnCount;
+        rows = rowCount;
+        origin = at;
+        spacing = glm::vec2(size) / glm::vec2((float)(columns - 1), (float)(rows - 1));
+        heightScale = size.z / 65535.0f;
+        samples.resize((size_t)columns * rows);
+        for (size_t i = 0; i < samples.size(); ++i) { samples[i] = (uint16_t)(from[i] * scale); }
+        //every tile covers the samples on its far edges too, which it shares with the next tile, so that it bounds every triangle in it
+        Level tiles{(columns - 2) / tileSize + 1, (rows - 2) / tileSize + 1, {}};
+        tiles.ranges.resize((size_t)tiles.columns * tiles.rows);
+        for (uint32_t y = 0; y < tiles.rows; ++y) {
+            for (uint32_t x = 0; x < tiles.columns; ++x) {
+                Range range{UINT16_MAX, 0};
+                for (uint32_t j = y * tileSize; j <= std::min((y + 1) * tileSize, rows - 1); ++j) {
+                    for (uint32_t i = x * tileSize; i <= std::min((x + 1) * tileSize, columns - 1); ++i) {
+                        uint16_t sample = samples[(size_t)j * columns + i];
+                        range = {std::min(range.min, sample), std::max(range.max, sample)};
+                    }
+                }
+                tiles.ranges[(size_t)y * tiles.columns + x] = range;
+            }
+        }
+        levels.push_back(std::move(tiles));
+        while (levels.back().columns > 1 || levels.back().rows > 1) {
+            const Level &below = levels.back();
+            Level level{(below.columns + 1) / 2, (below.rows + 1) / 2, {}};
+            level.ranges.resize((size_t)level.columns * level.rows);
+            for (uint32_t y = 0; y < level.rows; ++y) {
+                for (uint32_t x = 0; x < level.columns; ++x) {
+                    Range range{UINT16_MAX, 0};
+                    for (uint32_t k = 0; k < 4; ++k) {
+                        uint32_t childX = x * 2 + (k & 1), childY = y * 2 + (k >> 1);
+                        if (childX >= below.columns || childY >= below.rows) { continue; }
+                        Range child = below.ranges[(size_t)childY * below.columns + childX];
+                        range = {std::min(range.min, child.min), std::max(range.max, child.max)};
+                    }
+                    level.ranges[(size_t)y * level.columns + x] = range;
+                }
+            }
+            levels.push_back(std::move(level));
+        }
+    }
+
+    [[nodiscard]] float heightOf(uint16_t sample) const {
+        return origin.z + (float)sample * heightScale;
+    }
+
+    [[nodiscard]] glm::vec3 sampleAt(uint32_t i, uint32_t j) const {
+        return {origin.x + (float)i * spacing.x, origin.y + (float)j * spacing.y, heightOf(samples[(size_t)j * columns + i])};
+    }
+
+    [[nodiscard]] Corners cornersOf(uint32_t i, uint32_t j) const {
+        return {sampleAt(i, j), sampleAt(i + 1, j), sampleAt(i, j + 1), sampleAt(i + 1, j + 1)};
+    }
+
+    [[nodiscard]] uint32_t triangleOf(uint32_t i, uint32_t j, uint32_t half) const {
+        return (j * (columns - 1) + i) * 2 + half;
+    }
+
+    [[nodiscard]] Range rangeOf(const Node &node) const {
+        const Level &level = levels[node.level];
+        return level.ranges[(size_t)node.y * level.columns + node.x];
+    }
+
+    //the cell of a coordinate in cells, clamped to the grid
+    static uint32_t clampCell(float cell, uint32_t samplesAlong) {
+        return (uint32_t)std::clamp(cell, 0.0f, (float)(samplesAlong - 2));
+    }
+
+    //find the cell over x, y and how far across it x, y is. Returns false off the heightfield.
+    bool locate(float x, float y, glm::ivec2 &cell, glm::vec2 &inside) const {
+        glm::vec2 at = (glm::vec2(x, y) - glm::vec2(origin)) / spacing;
+        if (!(at.x >= 0.0f && at.y >= 0.0f && at.x <= (float)(columns - 1) && at.y <= (float)(rows - 1))) { return false; }
+        cell = {clampCell(at.x, columns), clampCell(at.y, rows)};
+        inside = at - glm::vec2(cell);
+        return true;
+    }
+
+    void pushChildren(const Node &node, Node *stack, uint32_t &size) const {
+        for (uint32_t k = 0; k < 4; ++k) {
+            Node child{node.level - 1, node.x * 2 + (k & 1), node.y * 2 + (k >> 1)};
+            if (child.x < levels[child.level].columns && child.y < levels[child.level].rows) { stack[size++] = child; }
+        }
+    }
+
+    //keep candidate among the contacts kept so far: in place of a kept contact facing the same way if it is closer, in a free place, or in place of the farthest contact if it is closer
+    static void keep(const Contact &candidate, Contact *kept, uint32_t &count) {
+        uint32_t farthest{};
+        for (uint32_t k = 0; k < count; ++k) {
+            if (glm::dot(kept[k].normal, candidate.normal) > mergeCosine) {
+                if (candidate.separation < kept[k].separation) { kept[k] = candidate; }
+                return;
+            }
+            if (kept[k].separation > kept[farthest].separation) { farthest = k; }
+        }
+        if (count < maxContacts) { kept[count++] = candidate; }
+        else if (candidate.separation < kept[farthest].separation) { kept[farthest] = candidate; }
+    }
+
+    //the point of triangle abc closest to p, by which Voronoi region of the triangle p lies in
+    static glm::vec3 closestPoint(glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec3 p) {
+        glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+        float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+        if (d1 <= 0.0f && d2 <= 0.0f) { return a; }
+        glm::vec3 bp = p - b;
+        float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+        if (d3 >= 0.0f && d4 <= d3) { return b; }
+        float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) { return a + ab * (d1 / (d1 - d3)); }
+        glm::vec3 cp = p - c;
+        float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+        if (d6 >= 0.0f && d5 <= d6) { return c; }
+        float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) { return a + ac * (d2 / (d2 - d6)); }
+        float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) { return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6))); }
+        float denominator = 1.0f / (va + vb + vc);
+        return a + ab * (vb * denominator) + ac * (vc * denominator);
+    }
+
+    //the part [enter, exit] of [from, to] along ray inside box. Returns false if there is none.
+    static bool clip(const Ray &ray, glm::vec3 inverseDirection, const AABB &box, float from, float to, float &enter, float &exit) {
+        enter = from;
+        exit = to;
+        for (int axis = 0; axis < 3; ++axis) {
+            //a ray along the side of a box would otherwise multiply zero by infinity there
+            if (ray.direction[axis] == 0.0f) {
+                if (ray.origin[axis] < box.min[axis] || ray.origin[axis] > box.max[axis]) { return false; }
+                continue;
+            }
+            float t1 = (box.min[axis] - ray.origin[axis]) * inverseDirection[axis], t2 = (box.max[axis] - ray.origin[axis]) * inverseDirection[axis];
+            enter = std::max(enter, std::min(t1, t2));
+            exit = std::min(exit, std::max(t1, t2));
+        }
+        return enter <= exit;
+    }
+
+    //the part [from, to] of [enter, exit] along ray over node's columns of cells. Returns false if there is none, or if the ray stays above or below every sample under it there.
+    bool crosses(const Ray &ray, glm::vec3 inverseDirection, const Node &node, float enter, float exit, float &from, float &to) const {
+        uint32_t span = tileSize << node.level;
+        glm::vec2 low = glm::vec2(origin) + glm::vec2(glm::uvec2(node.x, node.y) * span) * spacing;
+        glm::vec2 high = glm::vec2(origin) + glm::vec2(glm::min((glm::uvec2(node.x, node.y) + 1u) * span, glm::uvec2(columns - 1, rows - 1))) * spacing;
+        Range range = rangeOf(node);
+        return clip(ray, inverseDirection, {{low, heightOf(range.min)}, {high, heightOf(range.max)}}, enter, exit, from, to);
+    }
+
+    //walk the cells of tile node that ray crosses in [from, to], nearest first, stopping at the first triangle hit
+    bool walkTile(const Ray &ray, glm::vec3 inverseDirection, const Node &node, float from, float to, HeightfieldHit &hit) const {
+        glm::uvec2 first = glm::uvec2(node.x, node.y) * tileSize, last = glm::min(first + tileSize, glm::uvec2(columns - 1, rows - 1)) - 1u;
+        glm::vec3 start = ray.origin + ray.direction * from;
+        glm::ivec2 cell = glm::clamp(glm::ivec2(glm::floor((glm::vec2(start) - glm::vec2(origin)) / spacing)), glm::ivec2(first), glm::ivec2(last));
+        glm::ivec2 step(ray.direction.x > 0.0f ? 1 : -1, ray.direction.y > 0.0f ? 1 : -1);
+        //the ray's distance to the next cell boundary along x and y, and between boundaries
+        glm::vec2 next, delta = glm::abs(spacing * glm::vec2(inverseDirection));
+        for (int axis = 0; axis < 2; ++axis) {
+            float boundary = origin[axis] + (float)(cell[axis] + (step[axis] > 0 ? 1 : 0)) * spacing[axis];
+            next[axis] = ray.direction[axis] != 0.0f ? (boundary - ray.origin[axis]) * inverseDirection[axis] : INFINITY;
+        }
+        float cellFrom = from;
+        while (true) {
+            float cellTo = std::min(std::min(next.x, next.y), to);
+            Corners corners = cornersOf((uint32_t)cell.x, (uint32_t)cell.y);
+            float rayLow = std::min(ray.origin.z + ray.direction.z * cellFrom, ray.origin.z + ray.direction.z * cellTo);
+            float rayHigh = std::max(ray.origin.z + ray.direction.z * cellFrom, ray.origin.z + ray.direction.z * cellTo);
+            if (rayLow <= std::max(std::max(corners.a.z, corners.b.z), std::max(corners.c.z, corners.d.z)) && rayHigh >= std::min(std::min(corners.a.z, corners.b.z), std::min(corners.c.z, corners.d.z))) {
+                float best = INFINITY;
+                uint32_t bestHalf{};
+                for (uint32_t half = 0; half < 2; ++half) {
+                    float t = rayTriangle(ray, corners.a, half == 0 ? corners.b : corners.d, half == 0 ? corners.d : corners.c);
+                    if (t >= from && t <= to && t < best) {
+                        best = t;
+                        bestHalf = half;
+                    }
+                }
+                if (best != INFINITY) {
+                    glm::vec3 b = bestHalf == 0 ? corners.b : corners.d, c = bestHalf == 0 ? corners.d : corners.c;
+                    glm::vec3 normal = glm::normalize(glm::cross(b - corners.a, c - corners.a));
+                    hit.triangle = triangleOf((uint32_t)cell.x, (uint32_t)cell.y, bestHalf);
+                    hit.t = best;
+                    hit.normal = glm::dot(normal, ray.direction) > 0.0f ? -normal : normal;
+                    hit.point = ray.origin + ray.direction * best;
+                    return true;
+                }
+            }
+            if (cellTo >= to) { return false; }
+            int axis = next.x < next.y ? 0 : 1;
+            cell[axis] += step[axis];
+            if (cell[axis] < (int)first[axis] || cell[axis] > (int)last[axis]) { return false; }
+            cellFrom = next[axis];
+            next[axis] += delta[axis];
+        }
+    }
+
+    //how far along ray it crosses triangle abc from either side, or INFINITY if it does not
+    static float rayTriangle(const Ray &ray, glm::vec3 a, glm::vec3 b, glm::vec3 c) {
+        glm::vec3 ab = b - a, ac = c - a;
+        glm::vec3 p = glm::cross(ray.direction, ac);
+        float determinant = glm::dot(ab, p);
+        if (determinant == 0.0f) { return INFINITY; }
+        float inverse = 1.0f / determinant;
+        glm::vec3 offset = ray.origin - a;
+        float u = glm::dot(offset, p) * inverse;
+        if (u < 0.0f || u > 1.0f) { return INFINITY; }
+        glm::vec3 q = glm::cross(offset, ab);
+        float v = glm::dot(ray.direction, q) * inverse;
+        if (v < 0.0f || u + v > 1.0f) { return INFINITY; }
+        return glm::dot(ac, q) * inverse;
+    }
+};
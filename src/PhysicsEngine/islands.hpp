@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "broadphase.hpp"
+
+//partitions bodies into islands: groups that are connected, directly or through other bodies, by pairs such as contacts. Bodies in different islands do not touch this step, so islands can be simulated independently.
+class IslandBuilder {
+public:
+    //islands are numbered in order of their lowest body, and bodies and pairs keep their relative order within an island, so the partition does not depend on how it is later scheduled
+    std::vector<uint32_t> islandOfBody; //the island each body belongs to
+    std::vector<uint32_t> bodyStart; //island i holds bodies[bodyStart[i], bodyStart[i + 1])
+    std::vector<uint32_t> bodies; //body indices grouped by island
+    std::vector<uint32_t> pairStart; //island i holds pairs[pairStart[i], pairStart[i + 1])
+    std::vector<uint32_t> pairs; //indices into the pair list the islands were built from, grouped by island
+
+    [[nodiscard]] size_t islandCount() const {
+        return bodyStart.empty() ? 0 : bodyStart.size() - 1;
+    }
+
+    //bodyPairs is any indexable list of elements with body indices a and b
+    template<typename Pairs> void build(size_t bodyCount, const Pairs &bodyPairs) {
+        build(bodyCount, bodyPairs, [](uint32_t) { return false; });
+    }
+
+    //static bodies do not join the islands they touch, since nothing that happens in one island can move them. Each is an island of its own, and its pairs belong to the island of the other body.
+    template<typename Pairs, typename IsStatic> void build(size_t bodyCount, const Pairs &bodyPairs, IsStatic isStatic) {
+        //union-find with path halving. The lower root always wins, so each root is the lowest body of its island.
+        parent.resize(bodyCount);
+        std::iota(parent.begin(), parent.end(), 0u);
+        for (const auto &pair : bodyPairs) {
+            if (isStatic(pair.a) || isStatic(pair.b)) { continue; }
+            uint32_t a = find(pair.a), b = find(pair.b);
+            if (a < b) { parent[b] = a; }
+            else if (b < a) { parent[a] = b; }
+        }
+        //number islands by their root and count their members
+        islandOfBody.resize(bodyCount);
+        bodyStart.clear();
+        bodyStart.push_back(0);
+        for (uint32_t i = 0; i < bodyCount; ++i) {
+            uint32_t root = find(i);
+            if (root == i) {
+                islandOfBody[i] = (uint32_t)bodyStart.size() - 1;
+                bodyStart.push_back(0);
+            } else { islandOfBody[i] = islandOfBody[root]; }
+            ++bodyStart[islandOfBody[i] + 1];
+        }
+        size_t islands = bodyStart.size() - 1;
+        pairStart.assign(islands + 1, 0);
+        for (const auto &pair : bodyPairs) { ++pairStart[islandOfPair(pair, isStatic) + 1]; }
+        for (size_t i = 1; i <= islands; ++i) {
+            bodyStart[i] += bodyStart[i - 1];
+            pairStart[i] += pairStart[i - 1];
+        }
+        //scatter bodies and pairs into their islands
+        bodies.resize(bodyCount);
+        fill.assign(bodyStart.begin(), bodyStart.end() - 1);
+        for (uint32_t i = 0; i < bodyCount; ++i) { bodies[fill[islandOfBody[i]]++] = i; }
+        pairs.resize(bodyPairs.size());
+        fill.assign(pairStart.begin(), pairStart.end() - 1);
+        for (uint32_t i = 0; i < bodyPairs.size(); ++i) { pairs[fill[islandOfPair(bodyPairs[i], isStatic)]++] = i; }
+    }
+
+private:
+    std::vector<uint32_t> parent;
+    std::vector<uint32_t> fill;
+
+    template<typename Pair, typename IsStatic> uint32_t islandOfPair(const Pair &pair, IsStatic isStatic) const {
+        return islandOfBody[isStatic(pair.a) ? pair.b : pair.a];
+    }
+
+    uint32_t find(uint32_t i) {
+        while (parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    }
+};
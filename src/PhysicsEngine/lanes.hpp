@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#include "bodyStore.hpp"
+
+//one float per lane, with the handful of operations the SIMD kernels need. Kernels are written once against these and run as wide as the build allows.
+struct ScalarLanes {
+    static constexpr size_t width = 1;
+    using Float = float;
+    using Mask = bool;
+    static Float load(const float *p) { return *p; }
+    static void store(float *p, Float a) { *p = a; }
+    static Float set(float a) { return a; }
+    static Float add(Float a, Float b) { return a + b; }
+    static Float sub(Float a, Float b) { return a - b; }
+    static Float mul(Float a, Float b) { return a * b; }
+    static Float div(Float a, Float b) { return a / b; }
+    static Float sqrt(Float a) { return std::sqrt(a); }
+    static Float max(Float a, Float b) { return a > b ? a : b; }
+    static Float min(Float a, Float b) { return a < b ? a : b; }
+    static Mask less(Float a, Float b) { return a < b; }
+    static Mask lessEqual(Float a, Float b) { return a <= b; }
+    static Mask both(Mask a, Mask b) { return a & b; }
+    static Mask either(Mask a, Mask b) { return a | b; }
+    static Float select(Mask m, Float a, Float b) { return m ? a : b; }
+    static int bits(Mask m) { return m ? 1 : 0; }
+};
+
+#if defined(CRYSTAL_ENGINE_PHYSICS_AVX)
+struct AVXLanes {
+    static constexpr size_t width = 8;
+    using Float = __m256;
+    using Mask = __m256;
+    static Float load(const float *p) { return _mm256_loadu_ps(p); }
+    static void store(float *p, Float a) { _mm256_storeu_ps(p, a); }
+    static Float set(float a) { return _mm256_set1_ps(a); }
+    static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+    static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+    static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+    static Float div(Float a, Float b) { return _mm256_div_ps(a, b); }
+    static Float sqrt(Float a) { return _mm256_sqrt_ps(a); }
+    static Float max(Float a, Float b) { return _mm256_max_ps(a, b); }
+    static Float min(Float a, Float b) { return _mm256_min_ps(a, b); }
+    static Mask less(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static Mask lessEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static Mask both(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+    static Mask either(Mask a, Mask b) { return _mm256_or_ps(a, b); }
+    static Float select(Mask m, Float a, Float b) { return _mm256_or_ps(_mm256_and_ps(m, a), _mm256_andnot_ps(m, b)); } //GCC rewrites blendv into a lane by lane select when only AVX is enabled
+    static int bits(Mask m) { return _mm256_movemask_ps(m); }
+};
+#elif defined(CRYSTAL_ENGINE_PHYSICS_SSE)
+struct SSELanes {
+    static constexpr size_t width = 4;
+    using Float = __m128;
+    using Mask = __m128;
+    static Float load(const float *p) { return _mm_loadu_ps(p); }
+    static void store(float *p, Float a) { _mm_storeu_ps(p, a); }
+    static Float set(float a) { return _mm_set1_ps(a); }
+    static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+    static Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+    static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+    static Float div(Float a, Float b) { return _mm_div_ps(a, b); }
+    static Float sqrt(Float a) { return _mm_sqrt_ps(a); }
+    static Float max(Float a, Float b) { return _mm_max_ps(a, b); }
+    static Float min(Float a, Float b) { return _mm_min_ps(a, b); }
+    static Mask less(Float a, Float b) { return _mm_cmplt_ps(a, b); }
+    static Mask lessEqual(Float a, Float b) { return _mm_cmple_ps(a, b); }
+    static Mask both(Mask a, Mask b) { return _mm_and_ps(a, b); }
+    static Mask either(Mask a, Mask b) { return _mm_or_ps(a, b); }
+    static Float select(Mask m, Float a, Float b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); } //SSE2 has no blend
+    static int bits(Mask m) { return _mm_movemask_ps(m); }
+};
+#endif
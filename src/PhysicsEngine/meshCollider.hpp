@@ -0,0 +1,474 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "aabbTree.hpp"
+#include "bodyStore.hpp"
+#include "lanes.hpp"
+#include "narrowphase.hpp"
+
+//the first touch of a sphere swept along a mesh
+struct MeshHit {
+    uint32_t triangle{UINT32_MAX}; //the index of the triangle hit in the mesh's index data, or UINT32_MAX if the sweep hit nothing
+    float toi{1.0f}; //the fraction of the displacement at which the sphere first touches the mesh
+    glm::vec3 normal{}; //unit normal pointing from the mesh towards the sphere's center at toi
+    glm::vec3 point{}; //where the sphere touches the mesh at toi
+};
+
+//static triangle mesh in world space, such as level geometry. Triangles are kept in a bounding volume hierarchy built once by binned surface area heuristic, with the corners of each leaf's triangles stored side by side so that a sphere is tested against a whole leaf at once.
+class MeshCollider {
+public:
+    static constexpr uint32_t binCount = 16; //the candidate splits tried along each axis of every node
+    static constexpr uint32_t maxLeafTriangles = 8; //one batch of the widest lanes
+    static constexpr uint32_t maxDepth = 64; //deeper nodes are made leaves whatever their size, so that traversal needs a fixed stack
+
+    MeshCollider() = default;
+
+    //build from indexed triangles. positions points at the first vertex position, and stride is the number of bytes from one vertex position to the next, so that the vertices of an Asset are read in place: MeshCollider(&asset.vertices[0].pos, sizeof(Vertex), asset.vertices.size(), asset.indices.data(), asset.indices.size(), model). Triangles with no area or with indices past vertexCount are left out.
+    MeshCollider(const glm::vec3 *positions, size_t stride, size_t vertexCount, const uint32_t *indices, size_t indexCount, const glm::mat4 &transform = glm::mat4(1.0f)) {
+        build(positions, stride, vertexCount, indices, indexCount, transform);
+    }
+
+    void build(const glm::vec3 *positions, size_t stride, size_t vertexCount, const uint32_t *indices, size_t indexCount, const glm::mat4 &transform = glm::mat4(1.0f)) {
+        std::vector<glm::vec3> vertices(vertexCount);
+        const auto *bytes = reinterpret_cast<const uint8_t *>(positions);
+        for (size_t i = 0; i < vertexCount; ++i) { vertices[i] = glm::vec3(transform * glm::vec4(*reinterpret_cast<const glm::vec3 *>(bytes + i * stride), 1.0f)); }
+        std::vector<Reference> references;
+        references.reserve(indexCount / 3);
+        for (size_t i = 0; i + 2 < indexCount; i += 3) {
+            if (indices[i] >= vertexCount || indices[i + 1] >= vertexCount || indices[i + 2] >= vertexCount) { continue; }
+            glm::vec3 a = vertices[indices[i]], b = vertices[indices[i + 1]], c = vertices[indices[i + 2]];
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            if (glm::dot(normal, normal) == 0.0f) { continue; }
+            references.push_back({glm::min(glm::min(a, b), c), (uint32_t)(i / 3), glm::max(glm::max(a, b), c), {}});
+        }
+        buildHierarchy(references);
+        //lay the corners out in leaf order, padded so that the last leaf can be loaded a whole batch at a time
+        size_t count = references.size(), padded = count + maxLeafTriangles;
+        for (std::vector<float> *corner : {&ax, &ay, &az, &bx, &by, &bz, &cx, &cy, &cz}) { corner->assign(padded, 0.0f); }
+        triangleIds.resize(count);
+        for (size_t k = 0; k < count; ++k) {
+            uint32_t id = references[k].id;
+            triangleIds[k] = id;
+            glm::vec3 a = vertices[indices[3 * id]], b = vertices[indices[3 * id + 1]], c = vertices[indices[3 * id + 2]];
+            ax[k] = a.x; ay[k] = a.y; az[k] = a.z;
+            bx[k] = b.x; by[k] = b.y; bz[k] = b.z;
+            cx[k] = c.x; cy[k] = c.y; cz[k] = c.z;
+        }
+    }
+
+    [[nodiscard]] size_t triangleCount() const {
+        return triangleIds.size();
+    }
+
+    [[nodiscard]] size_t nodeCount() const {
+        return nodes.size();
+    }
+
+    [[nodiscard]] AABB bounds() const {
+        return nodes.empty() ? AABB{} : AABB{nodes[0].min, nodes[0].max};
+    }
+
+    //append a contact to contacts for every triangle that sphere body of the store comes within reach of over the next dt seconds. The contacts are between body and meshBody, the static body standing in for this mesh, and keep the triangle as their feature so that the solver warm starts each one on its own. Safe to call from several threads at once.
+    void collide(const BodyStore &store, uint32_t body, uint32_t meshBody, float dt, std::vector<Contact> &contacts) const {
+        if (nodes.empty()) { return; }
+        glm::vec3 center(store.posX[body], store.posY[body], store.posZ[body]), displacement = glm::vec3(store.vX[body], store.vY[body], store.vZ[body]) * dt;
+        float radius = store.r[body];
+        //triangles closer than the distance the sphere could travel get a speculative contact, which the solver only lets it close
+        float reach = radius + glm::length(displacement);
+        uint32_t stack[maxDepth + 2];
+        uint32_t size{};
+        stack[size++] = 0;
+        while (size != 0) {
+            const Node &node = nodes[stack[--size]];
+            glm::vec3 outside = center - glm::clamp(center, node.min, node.max);
+            if (glm::dot(outside, outside) > reach * reach) { continue; }
+            if (node.count == 0) {
+                stack[size++] = node.leftOrFirst;
+                stack[size++] = node.leftOrFirst + 1;
+                continue;
+            }
+#if defined(CRYSTAL_ENGINE_PHYSICS_AVX)
+            collideLeaf<AVXLanes>(node, center, displacement, radius, reach, body, meshBody, contacts);
+#elif defined(CRYSTAL_ENGINE_PHYSICS_SSE)
+            collideLeaf<SSELanes>(node, center, displacement, radius, reach, body, meshBody, contacts);
+#else
+            collideLeaf<ScalarLanes>(node, center, displacement, radius, reach, body, meshBody, contacts);
+#endif
+        }
+    }
+
+    //find where a sphere moved from center by displacement first touches the mesh. Returns false, leaving hit untouched, if it never does.
+    bool sweep(glm::vec3 center, glm::vec3 displacement, float radius, MeshHit &hit) const {
+        if (nodes.empty()) { return false; }
+        glm::vec3 inverseDisplacement = 1.0f / displacement;
+        float best = 1.0f;
+        uint32_t bestTriangle = UINT32_MAX;
+        uint32_t stack[maxDepth + 2];
+        uint32_t size{};
+        stack[size++] = 0;
+        while (size != 0) {
+            const Node &node = nodes[stack[--size]];
+            if (!segmentHitsBox(center, inverseDisplacement, node.min - radius, node.max + radius, best)) { continue; }
+            if (node.count == 0) {
+                stack[size++] = node.leftOrFirst;
+                stack[size++] = node.leftOrFirst + 1;
+                continue;
+            }
+            for (uint32_t k = node.leftOrFirst; k < node.leftOrFirst + node.count; ++k) {
+                float t = sweepTriangle(k, center, displacement, radius, best);
+                if (t > best || (t == best && bestTriangle != UINT32_MAX)) { continue; }
+                best = t;
+                bestTriangle = k;
+            }
+        }
+        if (bestTriangle == UINT32_MAX) { return false; }
+        glm::vec3 at = center + displacement * best;
+        hit.triangle = triangleIds[bestTriangle];
+        hit.toi = best;
+        hit.point = closestPoint(bestTriangle, at);
+        glm::vec3 offset = at - hit.point;
+        float distance = glm::length(offset);
+        if (distance > 0.0f) { hit.normal = offset / distance; }
+        else {
+            hit.normal = glm::normalize(glm::cross(corner(bestTriangle, 1) - corner(bestTriangle, 0), corner(bestTriangle, 2) - corner(bestTriangle, 0)));
+            if (glm::dot(hit.normal, displacement) > 0.0f) { hit.normal = -hit.normal; }
+        }
+        return true;
+    }
+
+    //sweep count spheres, writing the first hit of each to hits. Spheres that hit nothing get a hit with triangle UINT32_MAX. Returns the number of spheres that hit the mesh.
+    size_t sweep(const glm::vec3 *centers, const glm::vec3 *displacements, const float *radii, size_t count, MeshHit *hits) const {
+        size_t found{};
+        for (size_t i = 0; i < count; ++i) {
+            hits[i] = {};
+            if (sweep(centers[i], displacements[i], radii[i], hits[i])) { ++found; }
+        }
+        return found;
+    }
+
+private:
+    //a node of the hierarchy. The children of an inner node are stored next to each other, so one index finds both.
+    struct Node {
+        glm::vec3 min;
+        uint32_t leftOrFirst; //the first child of an inner node, or the first triangle of a leaf
+        glm::vec3 max;
+        uint32_t count; //the number of triangles in a leaf, zero for inner nodes
+    };
+
+    //a triangle's bounds while the hierarchy is built. These are sorted into leaf order in place, so that every pass over a node reads memory in order.
+    struct Reference {
+        glm::vec3 min;
+        uint32_t id;
+        glm::vec3 max;
+        float padding;
+
+        [[nodiscard]] glm::vec3 centroid() const {
+            return (min + max) * 0.5f;
+        }
+    };
+
+    struct Bin {
+        AABB bounds{glm::vec3(INFINITY), glm::vec3(-INFINITY)};
+        uint32_t count{};
+
+        void add(const Bin &other) {
+            bounds = AABB::merge(bounds, other.bounds);
+            count += other.count;
+        }
+    };
+
+    struct BuildTask {
+        uint32_t node, first, count, depth;
+        AABB bounds, centroids;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<float> ax, ay, az, bx, by, bz, cx, cy, cz; //the corners of each triangle in leaf order
+    std::vector<uint32_t> triangleIds; //the index of each triangle in the mesh's index data, in leaf order
+
+    void buildHierarchy(std::vector<Reference> &references) {
+        nodes.clear();
+        if (references.empty()) { return; }
+        AABB bounds = emptyBox(), centroids = emptyBox();
+        for (const Reference &reference : references) {
+            bounds = AABB::merge(bounds, {reference.min, reference.max});
+            grow(centroids, reference.centroid());
+        }
+        nodes.reserve(references.size() / 2 + 1);
+        nodes.push_back({});
+        std::vector<BuildTask> tasks{{0, 0, (uint32_t)references.size(), 0, bounds, centroids}};
+        while (!tasks.empty()) {
+            BuildTask task = tasks.back();
+            tasks.pop_back();
+            nodes[task.node] = {task.bounds.min, task.first, task.bounds.max, task.count};
+            //a leaf of up to one batch costs a single test, so splitting it further never pays
+            if (task.count <= maxLeafTriangles || task.depth >= maxDepth) { continue; }
+            //bin every centroid along all three axes in one pass, then try the split between each pair of neighbouring bins
+            Bin bins[3][binCount];
+            glm::vec3 extent = task.centroids.max - task.centroids.min;
+            glm::vec3 scale = glm::vec3((float)binCount) / glm::max(extent, glm::vec3(1e-30f));
+            for (uint32_t i = task.first; i < task.first + task.count; ++i) {
+                const Reference &reference = references[i];
+                glm::vec3 centroid = reference.centroid();
+                for (int axis = 0; axis < 3; ++axis) {
+                    Bin &bin = bins[axis][binOf(centroid[axis], task.centroids.min[axis], scale[axis])];
+                    bin.bounds.min = glm::min(bin.bounds.min, reference.min);
+                    bin.bounds.max = glm::max(bin.bounds.max, reference.max);
+                    ++bin.count;
+                }
+            }
+            float bestCost = INFINITY;
+            int bestAxis = -1;
+            uint32_t bestSplit{};
+            for (int axis = 0; axis < 3; ++axis) {
+                if (extent[axis] <= 0.0f) { continue; }
+                //the area and count of everything right of each split, swept from the right
+                float rightArea[binCount];
+                uint32_t rightCount[binCount];
+                Bin right;
+                for (uint32_t split = binCount - 1; split > 0; --split) {
+                    right.add(bins[axis][split]);
+                    rightArea[split] = right.count == 0 ? 0.0f : right.bounds.surfaceArea();
+                    rightCount[split] = right.count;
+                }
+                Bin left;
+                for (uint32_t split = 0; split + 1 < binCount; ++split) {
+                    left.add(bins[axis][split]);
+                    if (left.count == 0 || rightCount[split + 1] == 0) { continue; }
+                    float cost = left.bounds.surfaceArea() * (float)left.count + rightArea[split + 1] * (float)rightCount[split + 1];
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestSplit = split;
+                    }
+                }
+            }
+            Bin left, right;
+            AABB leftCentroids = emptyBox(), rightCentroids = emptyBox();
+            uint32_t middle = task.first, end = task.first + task.count;
+            if (bestAxis >= 0) {
+                for (uint32_t split = 0; split < binCount; ++split) { (split <= bestSplit ? left : right).add(bins[bestAxis][split]); }
+                //partition in place, picking up the centroid bounds of both sides on the way
+                float origin = task.centroids.min[bestAxis], axisScale = scale[bestAxis];
+                while (middle < end) {
+                    glm::vec3 centroid = references[middle].centroid();
+                    if (binOf(centroid[bestAxis], origin, axisScale) <= bestSplit) {
+                        grow(leftCentroids, centroid);
+                        ++middle;
+                    } else {
+                        grow(rightCentroids, centroid);
+                        std::swap(references[middle], references[--end]);
+                    }
+                }
+            } else {
+                //every centroid is in the same place, so any halves are as good as any other
+                middle = task.first + task.count / 2;
+                leftCentroids = rightCentroids = task.centroids;
+                for (uint32_t i = task.first; i < task.first + task.count; ++i) {
+                    AABB &box = (i < middle ? left : right).bounds;
+                    box = AABB::merge(box, {references[i].min, references[i].max});
+                }
+            }
+            auto child = (uint32_t)nodes.size();
+            nodes.push_back({});
+            nodes.push_back({});
+            nodes[task.node].leftOrFirst = child;
+            nodes[task.node].count = 0;
+            tasks.push_back({child, task.first, middle - task.first, task.depth + 1, left.bounds, leftCentroids});
+            tasks.push_back({child + 1, middle, task.first + task.count - middle, task.depth + 1, right.bounds, rightCentroids});
+        }
+    }
+
+    static AABB emptyBox() {
+        return {glm::vec3(INFINITY), glm::vec3(-INFINITY)};
+    }
+
+    static void grow(AABB &box, glm::vec3 point) {
+        box.min = glm::min(box.min, point);
+        box.max = glm::max(box.max, point);
+    }
+
+    static uint32_t binOf(float value, float origin, float scale) {
+        return std::min((uint32_t)std::max((value - origin) * scale, 0.0f), binCount - 1);
+    }
+
+    [[nodiscard]] glm::vec3 corner(uint32_t k, int i) const {
+        if (i == 0) { return {ax[k], ay[k], az[k]}; }
+        if (i == 1) { return {bx[k], by[k], bz[k]}; }
+        return {cx[k], cy[k], cz[k]};
+    }
+
+    //the point on triangles [k, k + width) closest to p in each lane, returning the squared distance to it. Each Voronoi region of the triangle is tested in turn and the later, more specific ones win, so every lane takes the same path.
+    template<typename L> void closestPoints(size_t k, typename L::Float px, typename L::Float py, typename L::Float pz, typename L::Float &qx, typename L::Float &qy, typename L::Float &qz) const {
+        using F = typename L::Float;
+        F aX = L::load(ax.data() + k), aY = L::load(ay.data() + k), aZ = L::load(az.data() + k);
+        F bX = L::load(bx.data() + k), bY = L::load(by.data() + k), bZ = L::load(bz.data() + k);
+        F cX = L::load(cx.data() + k), cY = L::load(cy.data() + k), cZ = L::load(cz.data() + k);
+        F abX = L::sub(bX, aX), abY = L::sub(bY, aY), abZ = L::sub(bZ, aZ);
+        F acX = L::sub(cX, aX), acY = L::sub(cY, aY), acZ = L::sub(cZ, aZ);
+        F apX = L::sub(px, aX), apY = L::sub(py, aY), apZ = L::sub(pz, aZ);
+        F bpX = L::sub(px, bX), bpY = L::sub(py, bY), bpZ = L::sub(pz, bZ);
+        F cpX = L::sub(px, cX), cpY = L::sub(py, cY), cpZ = L::sub(pz, cZ);
+        F d1 = dot<L>(abX, abY, abZ, apX, apY, apZ), d2 = dot<L>(acX, acY, acZ, apX, apY, apZ);
+        F d3 = dot<L>(abX, abY, abZ, bpX, bpY, bpZ), d4 = dot<L>(acX, acY, acZ, bpX, bpY, bpZ);
+        F d5 = dot<L>(abX, abY, abZ, cpX, cpY, cpZ), d6 = dot<L>(acX, acY, acZ, cpX, cpY, cpZ);
+        F va = L::sub(L::mul(d3, d6), L::mul(d5, d4));
+        F vb = L::sub(L::mul(d5, d2), L::mul(d1, d6));
+        F vc = L::sub(L::mul(d1, d4), L::mul(d3, d2));
+        F zero = L::set(0.0f);
+        //inside the face
+        F denominator = L::div(L::set(1.0f), L::add(L::add(va, vb), vc));
+        F v = L::mul(vb, denominator), w = L::mul(vc, denominator);
+        qx = L::add(aX, L::add(L::mul(abX, v), L::mul(acX, w)));
+        qy = L::add(aY, L::add(L::mul(abY, v), L::mul(acY, w)));
+        qz = L::add(aZ, L::add(L::mul(abZ, v), L::mul(acZ, w)));
+        //on edge bc
+        F bcNear = L::sub(d4, d3), bcFar = L::sub(d5, d6);
+        auto onBC = L::both(L::lessEqual(va, zero), L::both(L::lessEqual(zero, bcNear), L::lessEqual(zero, bcFar)));
+        F t = L::div(bcNear, L::add(bcNear, bcFar));
+        qx = L::select(onBC, L::add(bX, L::mul(L::sub(cX, bX), t)), qx);
+        qy = L::select(onBC, L::add(bY, L::mul(L::sub(cY, bY), t)), qy);
+        qz = L::select(onBC, L::add(bZ, L::mul(L::sub(cZ, bZ), t)), qz);
+        //on edge ac
+        auto onAC = L::both(L::lessEqual(vb, zero), L::both(L::lessEqual(zero, d2), L::lessEqual(d6, zero)));
+        t = L::div(d2, L::sub(d2, d6));
+        qx = L::select(onAC, L::add(aX, L::mul(acX, t)), qx);
+        qy = L::select(onAC, L::add(aY, L::mul(acY, t)), qy);
+        qz = L::select(onAC, L::add(aZ, L::mul(acZ, t)), qz);
+        //at corner c
+        auto atC = L::both(L::lessEqual(zero, d6), L::lessEqual(d5, d6));
+        qx = L::select(atC, cX, qx);
+        qy = L::select(atC, cY, qy);
+        qz = L::select(atC, cZ, qz);
+        //on edge ab
+        auto onAB = L::both(L::lessEqual(vc, zero), L::both(L::lessEqual(zero, d1), L::lessEqual(d3, zero)));
+        t = L::div(d1, L::sub(d1, d3));
+        qx = L::select(onAB, L::add(aX, L::mul(abX, t)), qx);
+        qy = L::select(onAB, L::add(aY, L::mul(abY, t)), qy);
+        qz = L::select(onAB, L::add(aZ, L::mul(abZ, t)), qz);
+        //at corner b
+        auto atB = L::both(L::lessEqual(zero, d3), L::lessEqual(d4, d3));
+        qx = L::select(atB, bX, qx);
+        qy = L::select(atB, bY, qy);
+        qz = L::select(atB, bZ, qz);
+        //at corner a
+        auto atA = L::both(L::lessEqual(d1, zero), L::lessEqual(d2, zero));
+        qx = L::select(atA, aX, qx);
+        qy = L::select(atA, aY, qy);
+        qz = L::select(atA, aZ, qz);
+    }
+
+    [[nodiscard]] glm::vec3 closestPoint(uint32_t k, glm::vec3 p) const {
+        float qx, qy, qz;
+        closestPoints<ScalarLanes>(k, p.x, p.y, p.z, qx, qy, qz);
+        return {qx, qy, qz};
+    }
+
+    template<typename L> void collideLeaf(const Node &node, glm::vec3 center, glm::vec3 displacement, float radius, float reach, uint32_t body, uint32_t meshBody, std::vector<Contact> &contacts) const {
+        using F = typename L::Float;
+        constexpr size_t width = L::width;
+        F px = L::set(center.x), py = L::set(center.y), pz = L::set(center.z);
+        float closest[3][width], distances[width];
+        for (uint32_t k = node.leftOrFirst; k < node.leftOrFirst + node.count; k += (uint32_t)width) {
+            F qx, qy, qz;
+            closestPoints<L>(k, px, py, pz, qx, qy, qz);
+            F dx = L::sub(qx, px), dy = L::sub(qy, py), dz = L::sub(qz, pz);
+            F distance = dot<L>(dx, dy, dz, dx, dy, dz);
+            size_t lanes = std::min<size_t>(width, node.leftOrFirst + node.count - k);
+            int hits = L::bits(L::lessEqual(distance, L::set(reach * reach))) & (int)((1u << lanes) - 1);
+            if (hits == 0) { continue; }
+            L::store(closest[0], qx);
+            L::store(closest[1], qy);
+            L::store(closest[2], qz);
+            L::store(distances, distance);
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                if ((hits >> lane & 1) == 0) { continue; }
+                glm::vec3 point(closest[0][lane], closest[1][lane], closest[2][lane]);
+                float d = std::sqrt(distances[lane]);
+                glm::vec3 normal;
+                if (d > 0.0f) { normal = (point - center) / d; }
+                else {
+                    //the center lies on the triangle, so push it out of the front face
+                    uint32_t triangle = k + (uint32_t)lane;
+                    normal = -glm::normalize(glm::cross(corner(triangle, 1) - corner(triangle, 0), corner(triangle, 2) - corner(triangle, 0)));
+                }
+                //how soon the sphere reaches the triangle moving straight at it, which is only an estimate when it moves at an angle
+                float closing = glm::dot(displacement, normal);
+                float toi = d <= radius ? 0.0f : closing > 0.0f ? std::min((d - radius) / closing, 1.0f) : 1.0f;
+                contacts.push_back({body, meshBody, toi, normal, std::max(radius - d, 0.0f), point - normal * (0.5f * (d - radius)), triangleIds[k + lane] + 1, d - radius});
+            }
+        }
+    }
+
+    //the fraction of displacement at which a sphere starting at center first touches triangle k, or more than best if it does not touch it by then
+    [[nodiscard]] float sweepTriangle(uint32_t k, glm::vec3 center, glm::vec3 displacement, float radius, float best) const {
+        glm::vec3 offset = center - closestPoint(k, center);
+        if (glm::dot(offset, offset) <= radius * radius) { return 0.0f; }
+        glm::vec3 a = corner(k, 0), b = corner(k, 1), c = corner(k, 2);
+        glm::vec3 faceNormal = glm::cross(b - a, c - a);
+        //the face is touched first if the sphere meets its plane inside the triangle. A sphere already cutting the plane can only touch an edge or corner first.
+        glm::vec3 n = glm::normalize(faceNormal);
+        float height = glm::dot(center - a, n);
+        if (height < 0.0f) {
+            n = -n;
+            height = -height;
+        }
+        float approach = -glm::dot(displacement, n);
+        if (approach > 0.0f && height > radius) {
+            float t = (height - radius) / approach;
+            if (t > best) { return t; }
+            glm::vec3 p = center + displacement * t - n * radius;
+            if (glm::dot(glm::cross(b - a, p - a), faceNormal) >= 0.0f && glm::dot(glm::cross(c - b, p - b), faceNormal) >= 0.0f && glm::dot(glm::cross(a - c, p - c), faceNormal) >= 0.0f) { return t; }
+        }
+        //otherwise it is touched first on an edge or a corner
+        float first = INFINITY;
+        const glm::vec3 corners[3] = {a, b, c};
+        for (int i = 0; i < 3; ++i) {
+            first = std::min(first, sweepEdge(center, displacement, radius, corners[i], corners[(i + 1) % 3]));
+            first = std::min(first, sweepPoint(center, displacement, radius, corners[i]));
+        }
+        return first;
+    }
+
+    //the fraction of displacement at which a sphere starting at center, clear of the edge from a to b, first touches the side of that edge. Touching its ends is left to sweepPoint.
+    static float sweepEdge(glm::vec3 center, glm::vec3 displacement, float radius, glm::vec3 a, glm::vec3 b) {
+        glm::vec3 edge = b - a, offset = center - a;
+        float length2 = glm::dot(edge, edge);
+        //only the parts of the offset and displacement across the edge bring the sphere closer to it
+        glm::vec3 across = offset - edge * (glm::dot(offset, edge) / length2), acrossDisplacement = displacement - edge * (glm::dot(displacement, edge) / length2);
+        float t = firstRoot(glm::dot(acrossDisplacement, acrossDisplacement), glm::dot(across, acrossDisplacement), glm::dot(across, across) - radius * radius);
+        float along = glm::dot(offset + displacement * t, edge);
+        return along >= 0.0f && along <= length2 ? t : INFINITY;
+    }
+
+    //the fraction of displacement at which a sphere starting at center, clear of point, first touches it
+    static float sweepPoint(glm::vec3 center, glm::vec3 displacement, float radius, glm::vec3 point) {
+        glm::vec3 offset = center - point;
+        return firstRoot(glm::dot(displacement, displacement), glm::dot(offset, displacement), glm::dot(offset, offset) - radius * radius);
+    }
+
+    //the smaller root of a t^2 + 2 b t + c, or infinity if there is none ahead. A negative c means the sphere already reaches the infinite line or point, which for an edge means it is past one of its ends and will touch that corner first.
+    static float firstRoot(float a, float b, float c) {
+        float discriminant = b * b - a * c;
+        if (a <= 0.0f || c < 0.0f || discriminant < 0.0f || b >= 0.0f) { return INFINITY; }
+        return (-b - std::sqrt(discriminant)) / a;
+    }
+
+    static bool segmentHitsBox(glm::vec3 origin, glm::vec3 inverseDirection, glm::vec3 min, glm::vec3 max, float maxT) {
+        glm::vec3 t1 = (min - origin) * inverseDirection;
+        glm::vec3 t2 = (max - origin) * inverseDirection;
+        glm::vec3 tMin = glm::min(t1, t2), tMax = glm::max(t1, t2);
+        float enter = std::max({tMin.x, tMin.y, tMin.z, 0.0f});
+        float exit = std::min({tMax.x, tMax.y, tMax.z, maxT});
+        return enter <= exit;
+    }
+
+    template<typename L> static typename L::Float dot(typename L::Float ax, typename L::Float ay, typename L::Float az, typename L::Float bx, typename L::Float by, typename L::Float bz) {
+        return L::add(L::add(L::mul(ax, bx), L::mul(ay, by)), L::mul(az, bz));
+    }
+};
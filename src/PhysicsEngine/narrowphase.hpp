@@ -0,0 +1,177 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "bodyStore.hpp"
+#include "broadphase.hpp"
+#include "lanes.hpp"
+
+//where and when two bodies touch
+struct Contact {
+    uint32_t a; //store index of the first body
+    uint32_t b; //store index of the second body
+    float toi; //the fraction of the tick at which the bodies first touch, zero if they already overlapped at its start
+    glm::vec3 normal; //unit normal pointing from a towards b
+    float depth; //how far the bodies overlap at toi
+    glm::vec3 point; //the middle of the overlap at toi, or for contacts with a separation, the middle of the closest points at the start of the tick
+    uint32_t feature{}; //which part of b was touched, such as one plus the index of a mesh triangle, or zero for the whole of b. Contacts with different parts of one body are kept apart by the solver.
+    float separation{NAN}; //the distance between the surfaces along normal at the start of the tick, negative where they overlap. Left as NAN for pairs of spheres, whose separation the solver works out from their centers and radii.
+};
+
+//contact storage that only ever grows, so refilling it every step allocates nothing once it has reached its working size
+class ContactManifold {
+public:
+    //make room for at least capacity contacts and return the start of the storage. The contacts already held are kept.
+    Contact *prepare(size_t capacity) {
+        if (storage.size() < capacity) { storage.resize(capacity); }
+        return storage.data();
+    }
+
+    //mark the first count contacts of the storage as the current ones
+    void setSize(size_t count) {
+        live = count;
+    }
+
+    void clear() {
+        live = 0;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return live;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return live == 0;
+    }
+
+    const Contact &operator[](size_t i) const {
+        return storage[i];
+    }
+
+    [[nodiscard]] const Contact *begin() const {
+        return storage.data();
+    }
+
+    [[nodiscard]] const Contact *end() const {
+        return storage.data() + live;
+    }
+
+private:
+    std::vector<Contact> storage{};
+    size_t live{};
+};
+
+//swept sphere narrowphase. Pairs are gathered out of the body store a batch at a time and solved for their time of impact across every lane at once.
+class SphereNarrowphase {
+public:
+    //sweep count pairs of spheres across dt seconds and write a contact for each pair that touches to contacts, in pair order. contacts must have room for count contacts. Returns the number written.
+    static size_t sweep(const BodyStore &store, const BodyPair *pairs, size_t count, float dt, Contact *contacts) {
+        size_t i{}, found{};
+#if defined(CRYSTAL_ENGINE_PHYSICS_AVX)
+        found += sweepBatches<AVXLanes>(store, pairs, count, dt, contacts + found, i);
+#elif defined(CRYSTAL_ENGINE_PHYSICS_SSE)
+        found += sweepBatches<SSELanes>(store, pairs, count, dt, contacts + found, i);
+#endif
+        found += sweepBatches<ScalarLanes>(store, pairs, count, dt, contacts + found, i);
+        return found;
+    }
+
+    //sweep a single pair of spheres given their positions, displacements over the tick, and radii, filling in everything but the body indices of contact if they touch. This runs the same arithmetic as the batched kernels, so it agrees with them exactly.
+    static bool sweep(glm::vec3 pos1, glm::vec3 d1, float r1, glm::vec3 pos2, glm::vec3 d2, float r2, Contact &contact) {
+        float in[inputCount] = {pos1.x, pos1.y, pos1.z, d1.x, d1.y, d1.z, r1, pos2.x, pos2.y, pos2.z, d2.x, d2.y, d2.z, r2};
+        float out[outputCount];
+        if (!solve<ScalarLanes>(in, 1.0f, out)) { return false; }
+        contact.toi = out[0];
+        contact.normal = {out[1], out[2], out[3]};
+        contact.depth = out[4];
+        contact.point = {out[5], out[6], out[7]};
+        return true;
+    }
+
+private:
+    static constexpr int inputCount = 14; //position, velocity, and radius of each sphere
+    static constexpr int outputCount = 8; //toi, normal, depth, and point
+
+    //sweep whole batches of L::width pairs starting at i, advancing i past them. Returns the number of contacts written.
+    template<typename L> static size_t sweepBatches(const BodyStore &store, const BodyPair *pairs, size_t count, float dt, Contact *contacts, size_t &i) {
+        constexpr size_t width = L::width;
+        float in[inputCount][width];
+        float out[outputCount][width];
+        typename L::Float lanesIn[inputCount], lanesOut[outputCount];
+        size_t found{};
+        for (; i + width <= count; i += width) {
+            //gather each pair's bodies into one lane of every input
+            for (size_t lane = 0; lane < width; ++lane) {
+                uint32_t a = pairs[i + lane].a, b = pairs[i + lane].b;
+                in[0][lane] = store.posX[a]; in[1][lane] = store.posY[a]; in[2][lane] = store.posZ[a];
+                in[3][lane] = store.vX[a]; in[4][lane] = store.vY[a]; in[5][lane] = store.vZ[a];
+                in[6][lane] = store.r[a];
+                in[7][lane] = store.posX[b]; in[8][lane] = store.posY[b]; in[9][lane] = store.posZ[b];
+                in[10][lane] = store.vX[b]; in[11][lane] = store.vY[b]; in[12][lane] = store.vZ[b];
+                in[13][lane] = store.r[b];
+            }
+            for (int k = 0; k < inputCount; ++k) { lanesIn[k] = L::load(in[k]); }
+            int hits = L::bits(solveLanes<L>(lanesIn, dt, lanesOut));
+            if (hits == 0) { continue; }
+            for (int k = 0; k < outputCount; ++k) { L::store(out[k], lanesOut[k]); }
+            for (size_t lane = 0; lane < width; ++lane) {
+                if (!(hits >> lane & 1)) { continue; }
+                contacts[found++] = {pairs[i + lane].a, pairs[i + lane].b, out[0][lane], {out[1][lane], out[2][lane], out[3][lane]}, out[4][lane], {out[5][lane], out[6][lane], out[7][lane]}};
+            }
+        }
+        return found;
+    }
+
+    template<typename L> static bool solve(const float in[inputCount], float dt, float out[outputCount]) {
+        typename L::Float lanesIn[inputCount], lanesOut[outputCount];
+        for (int k = 0; k < inputCount; ++k) { lanesIn[k] = L::load(in + k); }
+        bool hit = L::bits(solveLanes<L>(lanesIn, dt, lanesOut)) != 0;
+        for (int k = 0; k < outputCount; ++k) { L::store(out + k, lanesOut[k]); }
+        return hit;
+    }
+
+    //solve |p + d t| = ra + rb for the earliest t in [0, 1], where p is the offset from a to b and d is how far b moves relative to a over the tick. Returns the lanes that touch.
+    template<typename L> static typename L::Mask solveLanes(const typename L::Float in[inputCount], float dt, typename L::Float out[outputCount]) {
+        using F = typename L::Float;
+        F step = L::set(dt), zero = L::set(0.0f), one = L::set(1.0f), half = L::set(0.5f);
+        F dax = L::mul(in[3], step), day = L::mul(in[4], step), daz = L::mul(in[5], step);
+        F px = L::sub(in[7], in[0]), py = L::sub(in[8], in[1]), pz = L::sub(in[9], in[2]);
+        F dx = L::sub(L::mul(in[10], step), dax), dy = L::sub(L::mul(in[11], step), day), dz = L::sub(L::mul(in[12], step), daz);
+        F reach = L::add(in[6], in[13]);
+        F c = L::sub(dot<L>(px, py, pz, px, py, pz), L::mul(reach, reach));
+        F a = dot<L>(dx, dy, dz, dx, dy, dz);
+        F b = dot<L>(px, py, pz, dx, dy, dz);
+        F discriminant = L::sub(L::mul(b, b), L::mul(a, c));
+        //spheres that already overlap touch at the start of the tick. Otherwise they must be closing, and their paths must come within reach before the tick ends.
+        auto overlapping = L::lessEqual(c, zero);
+        auto closing = L::both(L::less(b, zero), L::lessEqual(zero, discriminant));
+        F t = L::select(overlapping, zero, L::div(L::sub(L::sub(zero, b), L::sqrt(L::max(discriminant, zero))), a));
+        auto hit = L::either(overlapping, L::both(closing, L::lessEqual(t, one)));
+        //the offset between the centers at the time of impact gives the normal, and its shortfall from reach the depth. Coincident centers get an upward normal.
+        F nx = L::add(px, L::mul(dx, t)), ny = L::add(py, L::mul(dy, t)), nz = L::add(pz, L::mul(dz, t));
+        F distance = L::sqrt(dot<L>(nx, ny, nz, nx, ny, nz));
+        auto separated = L::less(zero, distance);
+        F inverse = L::div(one, distance);
+        nx = L::select(separated, L::mul(nx, inverse), zero);
+        ny = L::select(separated, L::mul(ny, inverse), zero);
+        nz = L::select(separated, L::mul(nz, inverse), one);
+        F depth = L::max(L::sub(reach, distance), zero);
+        F surface = L::sub(in[6], L::mul(depth, half));
+        out[0] = t;
+        out[1] = nx;
+        out[2] = ny;
+        out[3] = nz;
+        out[4] = depth;
+        out[5] = L::add(L::add(in[0], L::mul(dax, t)), L::mul(nx, surface));
+        out[6] = L::add(L::add(in[1], L::mul(day, t)), L::mul(ny, surface));
+        out[7] = L::add(L::add(in[2], L::mul(daz, t)), L::mul(nz, surface));
+        return hit;
+    }
+
+    template<typename L> static typename L::Float dot(typename L::Float ax, typename L::Float ay, typename L::Float az, typename L::Float bx, typename L::Float by, typename L::Float bz) {
+        return L::add(L::add(L::mul(ax, bx), L::mul(ay, by)), L::mul(az, bz));
+    }
+};
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "aabbTree.hpp"
+#include "lanes.hpp"
+#include "publishedState.hpp"
+#include "../Core/threadPool.hpp"
+
+//a pool of short lived particles such as sparks and debris, far too many to be bodies. The pool holds up to a fixed number of particles side by side in arrays, living ones first: every step they are moved, aged and resized a whole vector at a time, the dead are swapped out for the last living particle, and new ones are emitted after the living. Particles can bounce off bodies, but push nothing back.
+class ParticleEmitter {
+public:
+    static constexpr size_t maxLanes = 8;
+
+    glm::vec3 origin{}; //where particles are emitted
+    glm::vec3 velocity{}; //the velocity particles are emitted at
+    glm::vec3 spread{}; //how far each particle's starting velocity can be off velocity along each axis, either way
+    float rate{}; //particles emitted per second, on top of any emitted with emit
+    float lifetime{1.0f}; //how many seconds a particle lives
+    float lifetimeSpread{}; //how many seconds a particle's lifetime can be off lifetime, either way
+    float startSize{0.05f}, endSize{0.0f}; //a particle's size is blended from one to the other over its life
+    float drag{}; //the fraction of its velocity each particle loses per second
+    float restitution{0.3f}; //the fraction of its speed into a body a particle keeps after bouncing off it
+    glm::vec3 gravity{0.0f, 0.0f, -9.81f}; //acceleration of every particle, kept apart from the world's gravity as cloth's is
+    bool collide{}; //whether a world pushes particles out of the bounding sphere of every body near them. Off, particles fly through everything and cost nothing more.
+    size_t particlesPerTask{16384}; //the most particles in one task when stepped on a thread pool
+    TripleBuffer<PublishedParticles> published; //every living particle as of the last publish, for a renderer on another thread to read with published.acquire()
+
+    //a pool holding at most capacity particles, whose random starting velocities and lifetimes come from seed
+    explicit ParticleEmitter(size_t capacity, uint32_t seed = 1) : limit(capacity), random(seed != 0 ? seed : 1) {
+        size_t padded = (capacity + maxLanes - 1) / maxLanes * maxLanes;
+        for (std::vector<float> *array : {&x, &y, &z, &vX, &vY, &vZ, &ages, &inverseLifetimes, &sizes}) { array->resize(padded); }
+    }
+
+    [[nodiscard]] size_t capacity() const {
+        return limit;
+    }
+
+    [[nodiscard]] size_t liveCount() const {
+        return live;
+    }
+
+    //living particles are kept first, but move whenever one before them dies
+    [[nodiscard]] glm::vec3 position(size_t particle) const {
+        return {x[particle], y[particle], z[particle]};
+    }
+
+    [[nodiscard]] glm::vec3 particleVelocity(size_t particle) const {
+        return {vX[particle], vY[particle], vZ[particle]};
+    }
+
+    [[nodiscard]] float age(size_t particle) const {
+        return ages[particle];
+    }
+
+    [[nodiscard]] float size(size_t particle) const {
+        return sizes[particle];
+    }
+
+    //the box every living particle was in at the end of the last step
+    [[nodiscard]] AABB bounds() const {
+        return box;
+    }
+
+    //bounds grown by as far as the fastest particle of the last step could move in the next dt seconds
+    [[nodiscard]] AABB sweptBounds(float dt) const {
+        float reach = (fastest + glm::length(gravity) * dt) * dt;
+        return {box.min - reach, box.max + reach};
+    }
+
+    //emit count particles at once, or as many as there is room for. Returns the number emitted.
+    size_t emit(size_t count) {
+        count = std::min(count, limit - live);
+        for (size_t i = live; i < live + count; ++i) {
+            glm::vec3 v = velocity + spread * glm::vec3(signedRandom(), signedRandom(), signedRandom());
+            x[i] = origin.x;
+            y[i] = origin.y;
+            z[i] = origin.z;
+            vX[i] = v.x;
+            vY[i] = v.y;
+            vZ[i] = v.z;
+            ages[i] = 0.0f;
+            inverseLifetimes[i] = 1.0f / std::max(lifetime + lifetimeSpread * signedRandom(), 1e-6f);
+            sizes[i] = startSize;
+        }
+        if (count != 0) {
+            box = live == 0 ? AABB{origin, origin} : AABB::merge(box, {origin, origin});
+            fastest = std::max(fastest, glm::length(glm::abs(velocity) + spread));
+            live += count;
+        }
+        return count;
+    }
+
+    //kill every particle
+    void clear() {
+        live = 0;
+        box = {};
+        fastest = 0.0f;
+    }
+
+    //advance every particle by dt seconds, bouncing it off count spheres, each a center and radius, then remove the particles that died and emit rate's share of new ones. Stepping on threadPool gives the same result as stepping without one.
+    void step(float dt, const glm::vec4 *spheres, size_t sphereCount, ThreadPool *threadPool = nullptr) {
+        lastDt = dt;
+        if (live != 0) {
+            size_t padded = (live + maxLanes - 1) / maxLanes * maxLanes, chunk = grain(), tasks = (padded + chunk - 1) / chunk;
+            taskDeaths.resize(tasks);
+            taskBoxes.resize(tasks);
+            taskSpeeds.resize(tasks);
+            auto body = [&](size_t begin, size_t end) { taskDeaths[begin / chunk] = update(dt, spheres, sphereCount, begin, end, taskBoxes[begin / chunk], taskSpeeds[begin / chunk]); };
+            if (threadPool == nullptr) {
+                for (size_t begin = 0; begin < padded; begin += chunk) { body(begin, std::min(padded, begin + chunk)); }
+            } else { threadPool->parallelFor(padded, chunk, body); }
+            box = taskBoxes[0];
+            fastest = 0.0f;
+            for (size_t task = 1; task < tasks; ++task) { box = AABB::merge(box, taskBoxes[task]); }
+            for (float speed2 : taskSpeeds) { fastest = std::max(fastest, speed2); }
+            fastest = std::sqrt(fastest);
+            removeDead();
+        }
+        emitted += rate * dt;
+        auto due = (size_t)emitted;
+        emitted -= (float)due;
+        emit(due);
+    }
+
+    //place every living particle back along its velocity by what is left of the tick, 1 - alpha of the last step, and hand the particles to the reader through published. Particles move in straight lines between steps, which is all the blending needs, so no previous positions are kept. Called by World::publish.
+    void publish(float alpha) {
+        PublishedParticles &state = published.back();
+        state.instances.resize(live);
+        float back = (alpha - 1.0f) * lastDt;
+        for (size_t i = 0; i < live; ++i) { state.instances[i] = {x[i] + vX[i] * back, y[i] + vY[i] * back, z[i] + vZ[i] * back, sizes[i]}; }
+        state.frame = ++publishedFrames;
+        published.publish();
+    }
+
+private:
+#if defined(CRYSTAL_ENGINE_PHYSICS_AVX)
+    using Lanes = AVXLanes;
+#elif defined(CRYSTAL_ENGINE_PHYSICS_SSE)
+    using Lanes = SSELanes;
+#else
+    using Lanes = ScalarLanes;
+#endif
+
+    static constexpr float laneOffsets[8]{0, 1, 2, 3, 4, 5, 6, 7}; //the index of every lane, to mask off lanes past the last living particle
+
+    size_t limit, live{};
+    std::vector<float> x, y, z, vX, vY, vZ, ages, inverseLifetimes, sizes; //padded to a whole vector, so the kernel never needs a narrower one
+    AABB box{};
+    float fastest{}; //the speed of the fastest living particle at the end of the last step
+    float emitted{}; //the fraction of a particle rate has built up towards
+    float lastDt{};
+    uint32_t random;
+    uint64_t publishedFrames{};
+    std::vector<uint32_t> taskDeaths; //the particles that died in each task of the last step
+    std::vector<AABB> taskBoxes; //the box of each task's living particles
+    std::vector<float> taskSpeeds; //the squared speed of each task's fastest living particle
+
+    [[nodiscard]] size_t grain() const {
+        return std::max<size_t>(particlesPerTask / maxLanes, 1) * maxLanes;
+    }
+
+    //a number from -1 to 1, by xorshift
+    float signedRandom() {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        return (float)(random >> 8) * (2.0f / 16777216.0f) - 1.0f;
+    }
+
+    //move, age and resize the particles in [begin, end), a whole number of vectors, bouncing them off the spheres. Writes the box of the living ones to taskBox and the squared speed of the fastest to taskSpeed, and returns how many died.
+    uint32_t update(float dt, const glm::vec4 *spheres, size_t sphereCount, size_t begin, size_t end, AABB &taskBox, float &taskSpeed) {
+        using L = Lanes;
+        using F = typename L::Float;
+        F step = L::set(dt), keep = L::set(std::max(1.0f - drag * dt, 0.0f)), zero = L::set(0.0f), one = L::set(1.0f), tiny = L::set(1e-12f);
+        F bounce = L::set(1.0f + restitution), firstSize = L::set(startSize), growth = L::set(endSize - startSize), count = L::set((float)live), offsets = L::load(laneOffsets);
+        F dv[3] = {L::set(gravity.x * dt), L::set(gravity.y * dt), L::set(gravity.z * dt)};
+        F low[3] = {L::set(INFINITY), L::set(INFINITY), L::set(INFINITY)}, high[3] = {L::set(-INFINITY), L::set(-INFINITY), L::set(-INFINITY)}, speed2 = zero;
+        float *positions[3] = {x.data(), y.data(), z.data()}, *velocities[3] = {vX.data(), vY.data(), vZ.data()};
+        uint32_t deaths{};
+        for (size_t i = begin; i < end; i += L::width) {
+            F p[3], v[3];
+            for (int axis = 0; axis < 3; ++axis) {
+                v[axis] = L::add(L::mul(L::load(velocities[axis] + i), keep), dv[axis]);
+                p[axis] = L::add(L::load(positions[axis] + i), L::mul(v[axis], step));
+            }
+            for (size_t s = 0; s < sphereCount; ++s) {
+                glm::vec4 sphere = spheres[s];
+                F d[3] = {L::sub(p[0], L::set(sphere.x)), L::sub(p[1], L::set(sphere.y)), L::sub(p[2], L::set(sphere.z))};
+                F distance2 = L::add(L::add(L::mul(d[0], d[0]), L::mul(d[1], d[1])), L::mul(d[2], d[2]));
+                auto inside = L::less(distance2, L::set(sphere.w * sphere.w));
+                if (L::bits(inside) == 0) { continue; }
+                F distance = L::max(L::sqrt(distance2), tiny);
+                F n[3], into = zero;
+                for (int axis = 0; axis < 3; ++axis) {
+                    n[axis] = L::div(d[axis], distance);
+                    into = L::add(into, L::mul(v[axis], n[axis]));
+                }
+                //out to the surface, losing all but restitution of the speed into it
+                F push = L::sub(L::set(sphere.w), distance), reflect = L::mul(L::min(into, zero), bounce);
+                for (int axis = 0; axis < 3; ++axis) {
+                    p[axis] = L::select(inside, L::add(p[axis], L::mul(n[axis], push)), p[axis]);
+                    v[axis] = L::select(inside, L::sub(v[axis], L::mul(n[axis], reflect)), v[axis]);
+                }
+            }
+            F age = L::add(L::load(ages.data() + i), step);
+            F fraction = L::mul(age, L::load(inverseLifetimes.data() + i));
+            auto living = L::less(L::add(L::set((float)i), offsets), count);
+            for (int axis = 0; axis < 3; ++axis) {
+                L::store(positions[axis] + i, p[axis]);
+                L::store(velocities[axis] + i, v[axis]);
+                low[axis] = L::select(living, L::min(low[axis], p[axis]), low[axis]);
+                high[axis] = L::select(living, L::max(high[axis], p[axis]), high[axis]);
+            }
+            speed2 = L::select(living, L::max(speed2, L::add(L::add(L::mul(v[0], v[0]), L::mul(v[1], v[1])), L::mul(v[2], v[2]))), speed2);
+            L::store(ages.data() + i, age);
+            L::store(sizes.data() + i, L::add(firstSize, L::mul(growth, L::min(fraction, one))));
+            deaths += (uint32_t)std::popcount((uint32_t)L::bits(L::both(living, L::lessEqual(one, fraction))));
+        }
+        float lanes[2][3][L::width], speeds[L::width];
+        for (int axis = 0; axis < 3; ++axis) {
+            L::store(lanes[0][axis], low[axis]);
+            L::store(lanes[1][axis], high[axis]);
+        }
+        L::store(speeds, speed2);
+        taskBox = {glm::vec3(INFINITY), glm::vec3(-INFINITY)};
+        taskSpeed = 0.0f;
+        for (size_t lane = 0; lane < L::width; ++lane) {
+            taskBox = AABB::merge(taskBox, {{lanes[0][0][lane], lanes[0][1][lane], lanes[0][2][lane]}, {lanes[1][0][lane], lanes[1][1][lane], lanes[1][2][lane]}});
+            taskSpeed = std::max(taskSpeed, speeds[lane]);
+        }
+        return deaths;
+    }
+
+    [[nodiscard]] bool dead(size_t i) const {
+        return ages[i] * inverseLifetimes[i] >= 1.0f;
+    }
+
+    //swap every dead particle out for the last living one. Only tasks that saw a death are searched, a vector at a time, so a step in which few die costs next to nothing here.
+    void removeDead() {
+        using L = Lanes;
+        typename L::Float one = L::set(1.0f);
+        size_t chunk = grain();
+        for (size_t task = 0; task < taskDeaths.size() && task * chunk < live; ++task) {
+            if (taskDeaths[task] == 0) { continue; }
+            for (size_t j = task * chunk; j < std::min((task + 1) * chunk, live); j += L::width) {
+                auto lanes = (uint32_t)L::bits(L::lessEqual(one, L::mul(L::load(ages.data() + j), L::load(inverseLifetimes.data() + j))));
+                for (; lanes != 0; lanes &= lanes - 1) {
+                    size_t i = j + (size_t)std::countr_zero(lanes);
+                    if (i >= live) { break; }
+                    //the particle moved in from the end must be living, so it is never looked at again
+                    while (live > i + 1 && dead(live - 1)) { --live; }
+                    if (--live == i) { break; }
+                    for (std::vector<float> *array : {&x, &y, &z, &vX, &vY, &vZ, &ages, &inverseLifetimes, &sizes}) { (*array)[i] = (*array)[live]; }
+                }
+            }
+        }
+    }
+};
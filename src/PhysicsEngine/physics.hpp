@@ -1,9 +1,29 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <algorithm>
+#include <cstring>
+#include <functional>
 #include <iostream>
 #include <vector>
 
+#include "aabbTree.hpp"
+#include "bodyRegistry.hpp"
+#include "bodyStore.hpp"
+#include "broadphase.hpp"
+#include "cloth.hpp"
+#include "fluid.hpp"
+#include "convexNarrowphase.hpp"
+#include "heightfieldCollider.hpp"
+#include "islands.hpp"
+#include "meshCollider.hpp"
+#include "narrowphase.hpp"
+#include "particleEmitter.hpp"
+#include "publishedState.hpp"
+#include "snapshot.hpp"
+#include "solver.hpp"
+#include "../Core/threadPool.hpp"
+
 //returns the distance between two lines in 3d space
 float distLineLine(glm::vec3 pos1, glm::vec3 v1, glm::vec3 pos2, glm::vec3 v2) {
     glm::vec3 as1,as2,n,d;
@@ -26,57 +46,141 @@ std::vector<glm::vec3> getClosestPoints(glm::vec3 as1, glm::vec3 v1, glm::vec3 a
     return results;
 }
 
-//A particle with a position, velocity, and mass.
+//A particle with a position, velocity, and mass. Once added to a world it is a view over that world's body store, so its state lives in the world's arrays.
 class Particle {
 public:
 
-    glm::vec3 pos{}; //position
-    glm::vec3 v{}; //velocity
-    float m; //mass
-
     //constructor
     Particle(float x, float y, float z, float mass) {
-        pos = glm::vec3(x, y, z);
-        v = glm::vec3(0.0f,0.0f,0.0f);
-        m = mass;
+        local.pos = glm::vec3(x, y, z);
+        local.m = mass;
+    }
+
+    virtual ~Particle() = default;
+
+    [[nodiscard]] glm::vec3 getPosition() const {
+        return store == nullptr ? local.pos : glm::vec3(store->posX[index], store->posY[index], store->posZ[index]);
+    }
+
+    void setPosition(glm::vec3 pos) {
+        if (store == nullptr) { local.pos = pos; return; }
+        store->wake(index);
+        store->posX[index] = pos.x;
+        store->posY[index] = pos.y;
+        store->posZ[index] = pos.z;
+    }
+
+    [[nodiscard]] glm::vec3 getVelocity() const {
+        return store == nullptr ? local.v : glm::vec3(store->vX[index], store->vY[index], store->vZ[index]);
+    }
+
+    void setVelocity(glm::vec3 v) {
+        if (store == nullptr) { local.v = v; return; }
+        store->wake(index);
+        store->vX[index] = v.x;
+        store->vY[index] = v.y;
+        store->vZ[index] = v.z;
     }
 
-    //step forward in time. Should be called every tick
-    virtual void step() {
-        pos += v;
+    [[nodiscard]] float getMass() const {
+        return store == nullptr ? local.m : store->m[index];
+    }
+
+    //the position to draw this body at, blended between its last two ticks by how far the world's clock has run past the last one
+    [[nodiscard]] glm::vec3 getInterpolatedPosition() const {
+        return store == nullptr ? local.pos : store->interpolatedPosition(index);
+    }
+
+    //step forward dt seconds. Should be called every tick for bodies that are not in a world; a world integrates its own bodies in bulk.
+    virtual void step(float dt) {
+        setPosition(getPosition() + getVelocity() * dt);
     }
 
     //apply an impulse to the body
     void applyImpulse(glm::vec3 impulse) {
-        v += impulse;
+        wake();
+        setVelocity(getVelocity() + impulse);
     }
 
     void applyImpulse(float x, float y, float z) {
-        v.x += (x/m);
-        v.y += (y/m);
-        v.z += (z/m);
+        float m = getMass();
+        wake();
+        setVelocity(getVelocity() + glm::vec3(x / m, y / m, z / m));
+    }
+
+    //the index of this body in its world's store, which is where writeTransforms reads it from
+    [[nodiscard]] uint32_t getIndex() const {
+        return index;
     }
+
+    //whether the world has put this body to sleep. Moving, pushing, or touching a sleeping body wakes it, along with every body that fell asleep with it.
+    [[nodiscard]] bool isAsleep() const {
+        return store != nullptr && store->asleep[index];
+    }
+
+    void wake() {
+        if (store != nullptr) { store->wake(index); }
+    }
+
 protected:
-    Particle() {
-        pos = glm::vec3(0.0f,0.0f,0.0f);
-        v = glm::vec3(0.0f,0.0f,0.0f);
-        m = 0.0f;
+    friend class World;
+
+    Particle() = default;
+
+    //move this body's state into the store and become a view over it
+    void attach(BodyStore *bodyStore) {
+        index = bodyStore->add(local);
+        store = bodyStore;
+    }
+
+    //stop viewing the store, keeping this body's state locally
+    void detach() {
+        local = store->get(index);
+        store = nullptr;
     }
+
+    BodyState local{}; //state used until the body is added to a world
+    BodyStore *store{}; //the store this body lives in, if any
+    uint32_t index{}; //the index of this body in the store
 };
 
 class RigidBody: public Particle {
 public:
-    glm::vec3 rot{}; //the current angular position of the rigidbody
-    glm::vec3 rotV{}; //the current angular velocity of the rigidbody
+    RigidBody(float x,float y,float z,float m) : Particle(x,y,z,m) {}
+
+    //the current angular position of the rigidbody
+    [[nodiscard]] glm::vec3 getRotation() const {
+        return store == nullptr ? local.rot : glm::vec3(store->rotX[index], store->rotY[index], store->rotZ[index]);
+    }
+
+    void setRotation(glm::vec3 rot) {
+        if (store == nullptr) { local.rot = rot; return; }
+        store->wake(index);
+        store->rotX[index] = rot.x;
+        store->rotY[index] = rot.y;
+        store->rotZ[index] = rot.z;
+    }
+
+    //the current angular velocity of the rigidbody
+    [[nodiscard]] glm::vec3 getAngularVelocity() const {
+        return store == nullptr ? local.rotV : glm::vec3(store->rotVX[index], store->rotVY[index], store->rotVZ[index]);
+    }
 
-    RigidBody(float x,float y,float z,float m) : Particle(x,y,z,m) {
-        rot = glm::vec3();
-        rotV = glm::vec3();
+    void setAngularVelocity(glm::vec3 rotV) {
+        if (store == nullptr) { local.rotV = rotV; return; }
+        store->wake(index);
+        store->rotVX[index] = rotV.x;
+        store->rotVY[index] = rotV.y;
+        store->rotVZ[index] = rotV.z;
     }
 
-    void step() override {
-        Particle::step();
-        rot += rotV;
+    [[nodiscard]] glm::vec3 getInterpolatedRotation() const {
+        return store == nullptr ? local.rot : store->interpolatedRotation(index);
+    }
+
+    void step(float dt) override {
+        Particle::step(dt);
+        setRotation(getRotation() + getAngularVelocity() * dt);
     }
 
 protected:
@@ -86,55 +190,705 @@ protected:
 class SphereBody: public RigidBody {
 public:
 
-    float r; //radius
-
     SphereBody(float x,float y,float z,float mass,float radius) {
-        pos = glm::vec4(x,y,z,0.0f);
-        m=mass;
-        r=radius;
+        local.pos = glm::vec3(x,y,z);
+        local.m = mass;
+        local.r = radius;
+    }
+
+    //radius
+    [[nodiscard]] float getRadius() const {
+        return store == nullptr ? local.r : store->r[index];
+    }
+};
+
+//a rigid body shaped like a convex collider, such as a box, capsule, or hull. Its radius is that of a sphere holding the collider, which is what the broadphase and scene queries see, and what its inertia and collisions with meshes are worked out from.
+class ConvexBody: public RigidBody {
+public:
+
+    //the collider must outlive the body's world
+    ConvexBody(float x, float y, float z, float mass, const ConvexCollider *collider) : RigidBody(x, y, z, mass), collider(collider) {
+        local.r = collider->boundingRadius();
     }
+
+    [[nodiscard]] const ConvexCollider *getCollider() const {
+        return collider;
+    }
+
+private:
+    const ConvexCollider *collider;
 };
 
 //creates a world
 class World {
 public:
 
-    std::vector<Particle*> bodies;
+    std::vector<Particle*> bodies; //the view over each body in the store, or null for bodies created without one
+    BodyStore store; //the state of every body in this world
 
-    void addBody(Particle *body) {
+    //add a body to the world. The body becomes a view over the world's store, so it must outlive the world or be removed from it first.
+    BodyHandle addBody(Particle *body) {
+        body->attach(&store);
         bodies.push_back(body);
+        addCollider(nullptr);
+        queryTreeDirty = true;
+        return registry.add(body->index);
+    }
+
+    BodyHandle addBody(ConvexBody *body) {
+        BodyHandle handle = addBody(static_cast<Particle *>(body));
+        colliders.back() = body->getCollider();
+        ++convexBodies;
+        return handle;
+    }
+
+    //add a body that lives only in the world's store, with no view over it. Once the store and registry have grown to their peak, adding and removing bodies allocates nothing.
+    BodyHandle createBody(const BodyState &state) {
+        uint32_t index = store.add(state);
+        bodies.push_back(nullptr);
+        addCollider(nullptr);
+        queryTreeDirty = true;
+        return registry.add(index);
+    }
+
+    //the same for a body shaped like collider, whose radius is taken from it. The collider must outlive the world.
+    BodyHandle createBody(BodyState state, const ConvexCollider *collider) {
+        state.r = collider->boundingRadius();
+        BodyHandle handle = createBody(state);
+        colliders.back() = collider;
+        ++convexBodies;
+        return handle;
+    }
+
+    //add a static triangle mesh for spheres to collide with. The mesh is already in world space, so it is stood in for by a body with no mass or radius at the origin, whose handle is returned; removing that body removes the mesh. The mesh must outlive the world or be removed from it first.
+    BodyHandle addMesh(const MeshCollider *mesh) {
+        BodyHandle handle = createBody({});
+        meshes.push_back({mesh, nullptr, handle});
+        return handle;
+    }
+
+    //add a static heightfield for spheres to collide with and rays to hit, stood in for by a body as a mesh is. The heightfield must outlive the world or be removed from it first.
+    BodyHandle addHeightfield(const HeightfieldCollider *heightfield) {
+        BodyHandle handle = createBody({});
+        meshes.push_back({nullptr, heightfield, handle});
+        return handle;
+    }
+
+    //where in every tick a stage added with addStage runs
+    enum class TickStage : uint8_t {
+        beforeCollisions, //after preTick and gravity, so that changes to velocities are seen by the broadphase and solver
+        afterIntegration //once bodies have moved, before cloth, fluids and particles are stepped and bodies are put to sleep
+    };
+
+    //run stage every tick at when, after any stage already added there. Stages are for work written apart from the world, such as force fields and integrators compiled from other languages.
+    void addStage(TickStage when, std::function<void(World &world, float dt)> stage) {
+        (when == TickStage::beforeCollisions ? stagesBeforeCollisions : stagesAfterIntegration).push_back(std::move(stage));
+    }
+
+    //add a cloth to be stepped after the bodies every tick. Cloth is pushed out of every body with a radius, taking each as its bounding sphere, but pushes nothing back. The cloth must outlive the world or be removed from it first.
+    void addCloth(Cloth *cloth) {
+        cloths.push_back(cloth);
+    }
+
+    //returns false if the cloth was not in the world
+    bool removeCloth(Cloth *cloth) {
+        auto found = std::find(cloths.begin(), cloths.end(), cloth);
+        if (found == cloths.end()) { return false; }
+        cloths.erase(found);
+        return true;
+    }
+
+    //add a fluid to be stepped after cloth every tick. Like cloth, it is pushed out of the bounding sphere of every body in its container and pushes nothing back. The fluid must outlive the world or be removed from it first.
+    void addFluid(Fluid *fluid) {
+        fluids.push_back(fluid);
+    }
+
+    //returns false if the fluid was not in the world
+    bool removeFluid(Fluid *fluid) {
+        auto found = std::find(fluids.begin(), fluids.end(), fluid);
+        if (found == fluids.end()) { return false; }
+        fluids.erase(found);
+        return true;
+    }
+
+    //add a particle emitter to be stepped after fluids every tick. With collide set, its particles bounce off the bounding sphere of every body near them and push nothing back. The emitter must outlive the world or be removed from it first.
+    void addEmitter(ParticleEmitter *emitter) {
+        emitters.push_back(emitter);
+    }
+
+    //returns false if the emitter was not in the world
+    bool removeEmitter(ParticleEmitter *emitter) {
+        auto found = std::find(emitters.begin(), emitters.end(), emitter);
+        if (found == emitters.end()) { return false; }
+        emitters.erase(found);
+        return true;
+    }
+
+    //remove handle's body by moving the last body into its place, so that the store stays dense. A view over the removed body keeps its state but leaves the world. Returns false if the body was already removed.
+    bool removeBody(BodyHandle handle) {
+        uint32_t index = registry.indexOf(handle);
+        if (index == BodyRegistry::invalidIndex) { return false; }
+        //the solver's cached impulses are renumbered once before the next step, however many bodies are removed until then
+        if (!bodiesMoved) {
+            handlesBeforeRemoval.clear();
+            for (uint32_t i = 0; i < store.size(); ++i) { handlesBeforeRemoval.push_back(registry.handleOf(i)); }
+            bodiesMoved = true;
+        }
+        if (bodies[index] != nullptr) { bodies[index]->detach(); }
+        uint32_t last = store.remove(index);
+        registry.remove(index, last);
+        bodies[index] = bodies[last];
+        if (bodies[index] != nullptr) { bodies[index]->index = index; }
+        bodies.pop_back();
+        if (colliders[index] != nullptr) { --convexBodies; }
+        colliders[index] = colliders[last];
+        colliders.pop_back();
+        if (index < proxies.size() && proxies[index] != DynamicAABBTree::nullNode) { queryTree.remove(proxies[index]); }
+        if (index < proxies.size() && index != last) {
+            proxies[index] = last < proxies.size() ? proxies[last] : DynamicAABBTree::nullNode;
+            if (proxies[index] != DynamicAABBTree::nullNode) { queryTree.setUserData(proxies[index], index); }
+        }
+        if (proxies.size() > last) { proxies.resize(last); }
+        queryTreeDirty = true;
+        return true;
+    }
+
+    //the current index of handle's body in the store, or BodyRegistry::invalidIndex if it was removed
+    [[nodiscard]] uint32_t indexOf(BodyHandle handle) const {
+        return registry.indexOf(handle);
+    }
+
+    [[nodiscard]] bool contains(BodyHandle handle) const {
+        return registry.indexOf(handle) != BodyRegistry::invalidIndex;
+    }
+
+    [[nodiscard]] BodyHandle handleOf(uint32_t index) const {
+        return registry.handleOf(index);
+    }
+
+    SpatialHashGrid broadphase; //bins spheres so that only nearby pairs reach the narrowphase
+    std::vector<BodyPair> candidatePairs; //pairs of spheres found by the broadphase during the last step
+    std::vector<BodyPair> convexPairs; //pairs found by the broadphase during the last step with a convex body in them
+    std::vector<const ConvexCollider *> colliders; //the collider of each body in the store, or null for spheres
+    ConvexNarrowphase convexNarrowphase; //finds the contacts of convex pairs
+    ContactManifold contacts; //contacts found during the last step, in candidate pair order
+    ContactSolver solver; //turns contacts into impulses
+    IslandBuilder islands; //the islands built from the contacts during the last step, used to solve them in parallel and to put them to sleep
+    ThreadPool *threadPool{}; //when set, steps are split into tasks and run on this pool. The results are bit-identical to stepping without one, given the build's -ffp-contract=off.
+    size_t bodiesPerTask{4096}; //the most bodies to integrate in one task of a parallel step
+    size_t pairsPerTask{256}; //the most candidate pairs to sweep, and roughly how many contacts to solve, in one task of a parallel step
+    float tickRate{60.0f}; //fixed ticks per second run by update
+    int maxTicksPerUpdate{8}; //the most ticks one update may run. Time beyond that is dropped so that a slow frame cannot make the next one slower.
+    std::function<void(World &world, float dt)> preTick{}; //called at the start of every tick, before collisions are found, to apply forces and the like. Velocities written straight to the store of sleeping bodies are ignored.
+    bool publishState{}; //whether update publishes the state of every body to published
+    TripleBuffer<PublishedBodies> published; //the state of every body as of the last publish, for a renderer on another thread to read with published.acquire() without locking or waiting on the simulation
+    glm::vec3 gravity{}; //acceleration applied to every awake body with mass
+    bool allowSleep{true}; //whether islands that come to rest are put to sleep
+    float sleepLinearEnergy{0.005f}; //the most linear kinetic energy per unit of mass a body may have and still be at rest
+    float sleepAngularEnergy{0.005f}; //the same for angular kinetic energy, taking each body's inertia as its mass
+    float sleepDelay{0.5f}; //how many seconds every body in an island must stay at rest before the island sleeps
+
+    //advance the world by frameTime seconds of real time in fixed ticks, carrying any leftover time to the next call. Returns the number of ticks run.
+    int update(double frameTime) {
+        double tick = 1.0 / tickRate;
+        accumulator += frameTime;
+        int ticks = (int)std::min(std::floor(accumulator / tick), (double)maxTicksPerUpdate);
+        for (int i = 0; i < ticks; ++i) {
+            //only the state before the last tick is kept, since that is all the renderer blends between
+            if (i == ticks - 1) {
+                store.savePrevious();
+                for (Cloth *cloth : cloths) { cloth->savePrevious(); }
+                for (Fluid *fluid : fluids) { fluid->savePrevious(); }
+            }
+            step((float)tick);
+        }
+        accumulator -= ticks * tick;
+        if (ticks == maxTicksPerUpdate) { accumulator = std::min(accumulator, tick); }
+        store.alpha = (float)(accumulator / tick);
+        if (publishState) { publish(); }
+        return ticks;
+    }
+
+    //advance the world by a single tick of dt seconds
+    void step(float dt) {
+        if (bodiesMoved) { remapSolverCache(); }
+        if (preTick) { preTick(*this, dt); }
+        applyGravity(dt);
+        for (const auto &stage : stagesBeforeCollisions) { stage(*this, dt); }
+        if (threadPool != nullptr && threadPool->concurrency() > 1) { stepParallel(dt); }
+        else {
+            findCollisions(dt);
+            if (allowSleep) { islands.build(store.size(), contacts, [&](uint32_t i) { return store.invM[i] == 0.0f; }); }
+            solver.prepare(contacts.size());
+            solver.solve(store, contacts, nullptr, contacts.size(), dt);
+            solver.cacheImpulses(contacts, store);
+            store.integrateAwake(dt);
+        }
+        for (const auto &stage : stagesAfterIntegration) { stage(*this, dt); }
+        stepCloths(dt);
+        stepFluids(dt);
+        stepEmitters(dt);
+        updateSleep(dt);
+        queryTreeDirty = true;
+        lastDt = dt;
+        ++tickCount;
     }
 
     void step() {
-        for(auto & body : bodies) {
-            body -> step();
+        step(1.0f / tickRate);
+    }
+
+    //the number of bodies with mass that were awake at the end of the last step
+    [[nodiscard]] size_t awakeBodyCount() const {
+        return awakeBodies;
+    }
+
+    //the number of bodies with mass that were asleep at the end of the last step
+    [[nodiscard]] size_t sleepingBodyCount() const {
+        return sleepingBodies;
+    }
+
+    //write the interpolated model matrix of bodies [firstBody, firstBody + count) to transforms, scaled by scale. The matrices are written in order and never read back, so transforms may point straight into mapped GPU memory such as the render engine's instance transform buffer.
+    void writeTransforms(uint32_t firstBody, size_t count, glm::mat4 *transforms, glm::vec3 scale = glm::vec3(1.0f)) const {
+        for (size_t i = 0; i < count; ++i) {
+            auto body = (uint32_t)(firstBody + i);
+            transforms[i] = bodyTransform(store.interpolatedPosition(body), store.interpolatedRotation(body), scale);
         }
     }
 
-    //check for collision between two spheres
-    static bool checkCollision(SphereBody s1, SphereBody s2) {
+    //copy the interpolated position and rotation of every body into the back of published, then hand it to the reader. Called by update when publishState is set. Only one thread may publish, and nothing is allocated once each copy has grown to the size of the world.
+    void publish() {
+        PublishedBodies &state = published.back();
+        state.positions.resize(store.size());
+        state.rotations.resize(store.size());
+        for (uint32_t i = 0; i < store.size(); ++i) {
+            state.positions[i] = store.interpolatedPosition(i);
+            state.rotations[i] = store.interpolatedRotation(i);
+        }
+        state.tick = tickCount;
+        state.frame = ++publishedFrames;
+        published.publish();
+        for (Cloth *cloth : cloths) { cloth->publish(store.alpha); }
+        for (Fluid *fluid : fluids) { fluid->publish(store.alpha); }
+        for (ParticleEmitter *emitter : emitters) { emitter->publish(store.alpha); }
+    }
 
-        //store the distance between the spheres' vectors
-        float l = s1.r + s2.r + 1;
+    //the number of ticks stepped so far
+    [[nodiscard]] uint64_t getTick() const {
+        return tickCount;
+    }
 
-        //get the closest points to each other on the spheres' vectors
-        std::vector<glm::vec3> closestPoints = getClosestPoints(s1.pos,s1.v,s2.pos,s2.v);
+    //write everything the next tick depends on to snapshot: the body store, the handle registry, the solver's cached impulses, the convex narrowphase's cached axes, and update's leftover time. The broadphase, narrowphase and islands are rebuilt from the store every tick, so they are not saved. Cloth, fluids and particles are not saved either, since nothing in the world depends on them. Reuses the snapshot's buffer, so saving into the same snapshot again does not allocate unless the world grew.
+    void saveSnapshot(WorldSnapshot &snapshot) {
+        //impulses are saved under the bodies' current indices
+        if (bodiesMoved) { remapSolverCache(); }
+        SnapshotHeader header{snapshotMagic, snapshotVersion, (uint32_t)store.size(), lastDt, accumulator, tickCount, awakeBodies, sleepingBodies};
+        snapshot.data.resize(sizeof(header) + store.serializedSize() + registry.serializedSize() + solver.serializedSize() + convexNarrowphase.serializedSize());
+        snapshot.tick = tickCount;
+        uint8_t *out = snapshot.data.data();
+        std::memcpy(out, &header, sizeof(header));
+        out = store.write(out + sizeof(header));
+        out = registry.write(out);
+        out = solver.write(out);
+        convexNarrowphase.write(out);
+    }
 
-        //make sure the closest points are on the vectors, not behind or past them
-        if(glm::length(closestPoints[0]) <= std::max(glm::length(s1.pos+s1.v),glm::length(s1.pos)) && glm::length(closestPoints[0]) >= std::min(glm::length(s1.pos),glm::length(s1.pos+s1.v))) {
-            if(glm::length(closestPoints[1]) <= std::max(glm::length(s2.pos+s2.v),glm::length(s2.pos)) && glm::length(closestPoints[1]) >= std::min(glm::length(s2.pos+s2.v),glm::length(s2.pos))) {
-                //record the distance between the vectors
-                l = distLineLine(s1.pos, s1.v, s2.pos, s2.v);
-            } else {
+    //roll the world back to the state saved in snapshot. Stepping from there repeats the ticks that followed it bit for bit, given the same inputs. Handles come back as they were, but views over bodies added or removed since the snapshot are not put back. Returns false and leaves the world untouched if the snapshot was taken of a world with a different number of bodies, or is truncated or corrupt.
+    bool restoreSnapshot(const WorldSnapshot &snapshot) {
+        SnapshotHeader header;
+        if (snapshot.data.size() < sizeof(header)) { return false; }
+        std::memcpy(&header, snapshot.data.data(), sizeof(header));
+        if (header.magic != snapshotMagic || header.version != snapshotVersion || header.bodyCount != store.size()) { return false; }
+        //the counts inside come from the payload, so every part is checked against the bytes left before any of the world is overwritten
+        const uint8_t *begin = snapshot.data.data() + sizeof(header), *end = snapshot.data.data() + snapshot.data.size(), *in = begin;
+        in = store.validate(in, end);
+        if (in != nullptr) { in = BodyRegistry::validate(in, end, store.size()); }
+        if (in != nullptr) { in = ContactSolver::validate(in, end, store.size()); }
+        if (in != nullptr) { in = ConvexNarrowphase::validate(in, end, store.size()); }
+        if (in != end) { return false; }
+        in = store.read(begin, end);
+        in = registry.read(in, end, store.size());
+        in = solver.read(in, end, store.size());
+        convexNarrowphase.read(in, end, store.size());
+        bodiesMoved = false;
+        lastDt = header.lastDt;
+        accumulator = header.accumulator;
+        tickCount = header.tick;
+        awakeBodies = header.awakeBodies;
+        sleepingBodies = header.sleepingBodies;
+        queryTreeDirty = true;
+        return true;
+    }
 
+    //find the closest body or heightfield hit by each ray, writing one hit per ray to hits. A heightfield's hits are given as its body.
+    void raycast(const Ray *rays, size_t count, RayHit *hits) {
+        updateQueryTree();
+        findMeshBodies();
+        for (size_t i = 0; i < count; ++i) {
+            Ray ray = rays[i];
+            hits[i] = queryTree.raycast(ray, [&](uint32_t body) { return raySphere(ray, body); });
+            for (size_t mesh = 0; mesh < meshes.size(); ++mesh) {
+                if (meshes[mesh].heightfield == nullptr) { continue; }
+                //only hits nearer than the closest so far are looked for
+                ray.maxT = std::min(ray.maxT, hits[i].t);
+                HeightfieldHit hit;
+                if (meshes[mesh].heightfield->raycast(ray, hit)) { hits[i] = {meshBodies[mesh], hit.t}; }
             }
-        } else {
         }
+    }
 
-        //check whether the spheres' current location, next tick location, or paths intercept
-        if (s1.r + s2.r > glm::length(s2.pos - s1.pos) || s1.r + s2.r > glm::length((s2.pos + s2.v) - (s1.pos + s1.v)) || l < s1.r + s2.r) {
-            return true;
+    //find every body overlapping each sphere. Returns the number of overlaps found; only the first capacity of them are written to hits.
+    size_t overlapSpheres(const glm::vec3 *centers, const float *radii, size_t count, QueryHit *hits, size_t capacity) {
+        updateQueryTree();
+        size_t found{};
+        for (uint32_t i = 0; i < count; ++i) {
+            glm::vec3 center = centers[i];
+            float radius = radii[i];
+            queryTree.query({center - radius, center + radius}, [&](uint32_t body) {
+                glm::vec3 d = glm::vec3(store.posX[body], store.posY[body], store.posZ[body]) - center;
+                float reach = radius + store.r[body];
+                if (glm::dot(d, d) > reach * reach) { return; }
+                if (found < capacity) { hits[found] = {i, body}; }
+                ++found;
+            });
         }
-        return false;
+        return found;
+    }
+
+    //find every body overlapping each box. Returns the number of overlaps found; only the first capacity of them are written to hits.
+    size_t queryAABBs(const AABB *boxes, size_t count, QueryHit *hits, size_t capacity) {
+        updateQueryTree();
+        size_t found{};
+        for (uint32_t i = 0; i < count; ++i) {
+            const AABB &box = boxes[i];
+            queryTree.query(box, [&](uint32_t body) {
+                glm::vec3 pos(store.posX[body], store.posY[body], store.posZ[body]);
+                glm::vec3 d = pos - glm::clamp(pos, box.min, box.max);
+                if (glm::dot(d, d) > store.r[body] * store.r[body]) { return; }
+                if (found < capacity) { hits[found] = {i, body}; }
+                ++found;
+            });
+        }
+        return found;
+    }
+
+    //find every pair of spheres whose paths over the next dt seconds intersect
+    void findCollisions(float dt) {
+        findPairs(dt);
+        Contact *found = contacts.prepare(candidatePairs.size());
+        contacts.setSize(SphereNarrowphase::sweep(store, candidatePairs.data(), candidatePairs.size(), dt, found));
+        if (!convexPairs.empty()) {
+            convexStates.resize(convexPairs.size());
+            contactRuns.resize(1);
+            contactRuns[0].clear();
+            size_t iterations = convexNarrowphase.collide(store, colliders, convexPairs.data(), convexPairs.size(), dt, contactRuns[0], convexStates.data());
+            appendContacts();
+            convexNarrowphase.remember(convexPairs.data(), convexPairs.size(), convexStates.data(), iterations);
+        } else if (convexBodies != 0) { convexNarrowphase.remember(nullptr, 0, nullptr, 0); }
+        if (findMeshBodies()) {
+            contactRuns.resize(1);
+            contactRuns[0].clear();
+            collideMeshes(0, store.size(), dt, contactRuns[0]);
+            appendContacts();
+        }
+    }
+
+private:
+    std::vector<size_t> taskContacts; //the number of contacts each narrowphase task of a parallel step found
+    std::vector<uint32_t> islandBatchStart; //islands [islandBatchStart[i], islandBatchStart[i + 1]) make up the i-th solver task of a parallel step
+    double accumulator{}; //real time not yet simulated by update
+    float lastDt{}; //the length of the last tick
+    size_t awakeBodies{}, sleepingBodies{};
+    uint64_t tickCount{};
+    uint64_t publishedFrames{};
+    BodyRegistry registry; //maps handles to bodies in the store
+    bool bodiesMoved{}; //whether bodies were removed since the solver's cache was last renumbered
+    std::vector<BodyHandle> handlesBeforeRemoval; //the handle of each body in the store before the first of those removals
+    std::vector<uint32_t> newIndex; //the index each of those bodies has now
+
+    //a mesh or a heightfield, whichever is set
+    struct MeshBinding {
+        const MeshCollider *mesh;
+        const HeightfieldCollider *heightfield;
+        BodyHandle body; //the static body standing in for the mesh
+    };
+
+    std::vector<MeshBinding> meshes; //every mesh and heightfield added to the world
+    std::vector<uint32_t> meshBodies; //the store index of each mesh's body this tick
+    std::vector<std::vector<Contact>> contactRuns; //the convex or mesh contacts found by each task, waiting to be appended to the manifold in order
+    std::vector<ConvexNarrowphase::PairState> convexStates; //the state each convex pair ended this tick with
+    std::vector<size_t> taskIterations; //the GJK iterations each convex task ran
+    size_t convexBodies{}; //the number of bodies with a convex collider
+    std::vector<Cloth *> cloths; //every cloth added to the world
+    std::vector<std::function<void(World &world, float dt)>> stagesBeforeCollisions, stagesAfterIntegration;
+    std::vector<Fluid *> fluids; //every fluid added to the world
+    std::vector<ParticleEmitter *> emitters; //every particle emitter added to the world
+    std::vector<glm::vec4> nearbySpheres; //the bodies near the cloth, fluid or particles being stepped, as a center and radius each
+
+    //step every cloth against the bodies whose spheres overlap its bounds, as they are at the end of the tick
+    void stepCloths(float dt) {
+        ThreadPool *pool = threadPool != nullptr && threadPool->concurrency() > 1 ? threadPool : nullptr;
+        for (Cloth *cloth : cloths) {
+            gatherSpheres(cloth->bounds(dt));
+            cloth->step(dt, nearbySpheres.data(), nearbySpheres.size(), pool);
+        }
+    }
+
+    //step every fluid against the bodies whose spheres overlap its container
+    void stepFluids(float dt) {
+        ThreadPool *pool = threadPool != nullptr && threadPool->concurrency() > 1 ? threadPool : nullptr;
+        for (Fluid *fluid : fluids) {
+            gatherSpheres(fluid->container);
+            fluid->step(dt, nearbySpheres.data(), nearbySpheres.size(), pool);
+        }
+    }
+
+    //step every emitter, against the bodies whose spheres its particles could reach in the tick if they collide
+    void stepEmitters(float dt) {
+        ThreadPool *pool = threadPool != nullptr && threadPool->concurrency() > 1 ? threadPool : nullptr;
+        for (ParticleEmitter *emitter : emitters) {
+            nearbySpheres.clear();
+            if (emitter->collide && emitter->liveCount() != 0) { gatherSpheres(emitter->sweptBounds(dt)); }
+            emitter->step(dt, nearbySpheres.data(), nearbySpheres.size(), pool);
+        }
+    }
+
+    //fill nearbySpheres with the bodies whose spheres overlap bounds
+    void gatherSpheres(const AABB &bounds) {
+        nearbySpheres.clear();
+        for (uint32_t i = 0; i < store.size(); ++i) {
+            if (store.r[i] <= 0.0f) { continue; }
+            glm::vec3 pos(store.posX[i], store.posY[i], store.posZ[i]);
+            if (AABB{pos - store.r[i], pos + store.r[i]}.overlaps(bounds)) { nearbySpheres.emplace_back(pos, store.r[i]); }
+        }
+    }
+
+    void addCollider(const ConvexCollider *collider) {
+        colliders.push_back(collider);
+        if (collider != nullptr) { ++convexBodies; }
+    }
+
+    //move every pair with a convex body out of the broadphase's pairs, keeping both lists in order
+    void splitConvexPairs() {
+        convexPairs.clear();
+        if (convexBodies == 0) { return; }
+        size_t kept{};
+        for (const BodyPair &pair : candidatePairs) {
+            if (colliders[pair.a] != nullptr || colliders[pair.b] != nullptr) { convexPairs.push_back(pair); }
+            else { candidatePairs[kept++] = pair; }
+        }
+        candidatePairs.resize(kept);
+    }
+
+    //look up the body of every mesh, forgetting meshes whose body was removed. Returns false if there are no meshes.
+    bool findMeshBodies() {
+        meshes.erase(std::remove_if(meshes.begin(), meshes.end(), [&](const MeshBinding &binding) { return registry.indexOf(binding.body) == BodyRegistry::invalidIndex; }), meshes.end());
+        meshBodies.clear();
+        for (const MeshBinding &binding : meshes) { meshBodies.push_back(registry.indexOf(binding.body)); }
+        return !meshes.empty();
     }
-};
\ No newline at end of file
+
+    //collide every awake sphere in [begin, end) with every mesh and heightfield. Sleeping spheres keep their cached impulses until something wakes them.
+    void collideMeshes(size_t begin, size_t end, float dt, std::vector<Contact> &found) const {
+        for (auto i = (uint32_t)begin; i < end; ++i) {
+            if (store.asleep[i] || store.invM[i] == 0.0f || store.r[i] <= 0.0f) { continue; }
+            for (size_t mesh = 0; mesh < meshes.size(); ++mesh) {
+                if (meshes[mesh].mesh != nullptr) { meshes[mesh].mesh->collide(store, i, meshBodies[mesh], dt, found); }
+                else { meshes[mesh].heightfield->collide(store, i, meshBodies[mesh], dt, found); }
+            }
+        }
+    }
+
+    void appendContacts() {
+        size_t count = contacts.size(), added{};
+        for (const std::vector<Contact> &run : contactRuns) { added += run.size(); }
+        Contact *found = contacts.prepare(count + added);
+        for (const std::vector<Contact> &run : contactRuns) { count = std::copy(run.begin(), run.end(), found + count) - found; }
+        contacts.setSize(count);
+    }
+
+    void remapSolverCache() {
+        newIndex.resize(handlesBeforeRemoval.size());
+        for (size_t i = 0; i < handlesBeforeRemoval.size(); ++i) { newIndex[i] = registry.indexOf(handlesBeforeRemoval[i]); }
+        solver.remapBodies(newIndex);
+        convexNarrowphase.remapBodies(newIndex);
+        bodiesMoved = false;
+    }
+
+    static constexpr uint32_t snapshotMagic{0x50534543}; //"CESP"
+    static constexpr uint32_t snapshotVersion{4};
+
+    struct SnapshotHeader {
+        uint32_t magic, version, bodyCount;
+        float lastDt;
+        double accumulator;
+        uint64_t tick, awakeBodies, sleepingBodies;
+    };
+
+    void applyGravity(float dt) {
+        if (gravity == glm::vec3(0.0f)) { return; }
+        glm::vec3 dv = gravity * dt;
+        for (uint32_t i = 0; i < store.size(); ++i) {
+            if (store.asleep[i] || store.invM[i] == 0.0f) { continue; }
+            store.vX[i] += dv.x;
+            store.vY[i] += dv.y;
+            store.vZ[i] += dv.z;
+        }
+    }
+
+    //run the broadphase, waking any sleeping body that something awake may touch. Pairs between bodies that were asleep when the broadphase ran were left out, so it runs again if anything woke.
+    void findPairs(float dt) {
+        broadphase.findPairs(store, candidatePairs, dt);
+        bool woke{};
+        for (const BodyPair &pair : candidatePairs) {
+            if (store.asleep[pair.a] == store.asleep[pair.b]) { continue; }
+            store.wake(store.asleep[pair.a] ? pair.a : pair.b);
+            woke = true;
+        }
+        if (woke) { broadphase.findPairs(store, candidatePairs, dt); }
+        splitConvexPairs();
+    }
+
+    //count down towards sleep for every awake body at rest, then put to sleep every island whose bodies have all been at rest for sleepDelay
+    void updateSleep(float dt) {
+        awakeBodies = sleepingBodies = 0;
+        for (uint32_t i = 0; i < store.size(); ++i) {
+            if (store.invM[i] == 0.0f) { continue; }
+            if (store.asleep[i]) {
+                ++sleepingBodies;
+                continue;
+            }
+            ++awakeBodies;
+            glm::vec3 v(store.vX[i], store.vY[i], store.vZ[i]), w(store.rotVX[i], store.rotVY[i], store.rotVZ[i]);
+            bool resting = 0.5f * glm::dot(v, v) < sleepLinearEnergy && 0.5f * glm::dot(w, w) < sleepAngularEnergy;
+            store.sleepTimer[i] = resting ? store.sleepTimer[i] + dt : 0.0f;
+        }
+        if (!allowSleep) { return; }
+        //sleeping and static bodies touch nothing this tick, so they are always islands of their own
+        for (uint32_t island = 0; island < islands.islandCount(); ++island) {
+            const uint32_t *members = islands.bodies.data() + islands.bodyStart[island];
+            size_t count = islands.bodyStart[island + 1] - islands.bodyStart[island];
+            if (store.asleep[members[0]] || store.invM[members[0]] == 0.0f) { continue; }
+            bool ready = true;
+            for (size_t i = 0; i < count && ready; ++i) { ready = store.sleepTimer[members[i]] >= sleepDelay; }
+            if (!ready) { continue; }
+            store.sleep(members, count);
+            awakeBodies -= count;
+            sleepingBodies += count;
+        }
+    }
+
+    void stepParallel(float dt) {
+        findPairs(dt);
+        //each task sweeps a contiguous run of pairs into the same run of the contact buffer, then the runs are packed together in order so that the contacts match a serial step
+        size_t grain = std::max<size_t>(pairsPerTask, 1);
+        Contact *found = contacts.prepare(candidatePairs.size());
+        taskContacts.resize((candidatePairs.size() + grain - 1) / grain);
+        threadPool->parallelFor(candidatePairs.size(), grain, [&](size_t begin, size_t end) {
+            taskContacts[begin / grain] = SphereNarrowphase::sweep(store, candidatePairs.data() + begin, end - begin, dt, found + begin);
+        });
+        size_t count{};
+        for (size_t task = 0; task < taskContacts.size(); ++task) {
+            Contact *first = found + task * grain;
+            count = std::copy(first, first + taskContacts[task], found + count) - found;
+        }
+        contacts.setSize(count);
+        //convex and then mesh contacts follow the sphere contacts, gathered a run of pairs or bodies per task and appended in order, as in a serial step
+        if (!convexPairs.empty()) {
+            convexStates.resize(convexPairs.size());
+            contactRuns.resize((convexPairs.size() + grain - 1) / grain);
+            taskIterations.resize(contactRuns.size());
+            threadPool->parallelFor(convexPairs.size(), grain, [&](size_t begin, size_t end) {
+                std::vector<Contact> &run = contactRuns[begin / grain];
+                run.clear();
+                taskIterations[begin / grain] = convexNarrowphase.collide(store, colliders, convexPairs.data() + begin, end - begin, dt, run, convexStates.data() + begin);
+            });
+            appendContacts();
+            size_t iterations{};
+            for (size_t taskIteration : taskIterations) { iterations += taskIteration; }
+            convexNarrowphase.remember(convexPairs.data(), convexPairs.size(), convexStates.data(), iterations);
+        } else if (convexBodies != 0) { convexNarrowphase.remember(nullptr, 0, nullptr, 0); }
+        if (findMeshBodies()) {
+            contactRuns.resize((store.size() + bodiesPerTask - 1) / bodiesPerTask);
+            threadPool->parallelFor(store.size(), bodiesPerTask, [&](size_t begin, size_t end) {
+                std::vector<Contact> &run = contactRuns[begin / bodiesPerTask];
+                run.clear();
+                collideMeshes(begin, end, dt, run);
+            });
+            appendContacts();
+        }
+        solveIslands(dt);
+        //integration only reads and writes each body's own state, so it is split into contiguous ranges to keep the SIMD kernel
+        threadPool->parallelFor(store.size(), bodiesPerTask, [&](size_t begin, size_t end) { store.integrateAwake(dt, begin, end); });
+    }
+
+    //every island task only touches the contacts and bodies of its own islands, so no task writes anything another reads, and solving each island's contacts in their original order gives the same result as a serial step
+    void solveIslands(float dt) {
+        islands.build(store.size(), contacts, [&](uint32_t i) { return store.invM[i] == 0.0f; });
+        //batch islands into tasks of roughly pairsPerTask contacts. Islands without contacts have nothing to solve.
+        islandBatchStart.clear();
+        size_t batchContacts{};
+        for (uint32_t i = 0; i < islands.islandCount(); ++i) {
+            size_t contactCount = islands.pairStart[i + 1] - islands.pairStart[i];
+            if (contactCount == 0) { continue; }
+            if (islandBatchStart.empty() || batchContacts >= pairsPerTask) {
+                islandBatchStart.push_back(i);
+                batchContacts = 0;
+            }
+            batchContacts += contactCount;
+        }
+        islandBatchStart.push_back((uint32_t)islands.islandCount());
+        solver.prepare(contacts.size());
+        threadPool->parallelFor(islandBatchStart.size() - 1, 1, [&](size_t begin, size_t end) {
+            for (size_t batch = begin; batch < end; ++batch) {
+                for (uint32_t island = islandBatchStart[batch]; island < islandBatchStart[batch + 1]; ++island) {
+                    uint32_t first = islands.pairStart[island];
+                    solver.solve(store, contacts, islands.pairs.data() + first, islands.pairStart[island + 1] - first, dt);
+                }
+            }
+        });
+        solver.cacheImpulses(contacts, store);
+    }
+
+    DynamicAABBTree queryTree; //bounds every body for scene queries. Only brought up to date when a query needs it, so worlds that are never queried never pay for it.
+    std::vector<int32_t> proxies; //the query tree proxy of each body in the store, or nullNode for bodies moved into the place of a removed one before they had a proxy
+    bool queryTreeDirty{};
+
+    void updateQueryTree() {
+        if (!queryTreeDirty) { return; }
+        for (uint32_t i = 0; i < store.size(); ++i) {
+            glm::vec3 pos(store.posX[i], store.posY[i], store.posZ[i]);
+            AABB box{pos - store.r[i], pos + store.r[i]};
+            glm::vec3 displacement = glm::vec3(store.vX[i], store.vY[i], store.vZ[i]) * lastDt;
+            if (i >= proxies.size()) { proxies.push_back(DynamicAABBTree::nullNode); }
+            if (proxies[i] != DynamicAABBTree::nullNode) { queryTree.move(proxies[i], box, displacement); }
+            else { proxies[i] = queryTree.insert(box, i, displacement); }
+        }
+        queryTreeDirty = false;
+    }
+
+    //returns the distance along the ray to the surface of a body, or -1 if the ray misses it. Bodies without a radius, such as those standing in for meshes and heightfields, are never hit.
+    float raySphere(const Ray &ray, uint32_t body) const {
+        if (store.r[body] <= 0.0f) { return -1.0f; }
+        glm::vec3 offset = ray.origin - glm::vec3(store.posX[body], store.posY[body], store.posZ[body]);
+        float a = glm::dot(ray.direction, ray.direction);
+        float b = glm::dot(offset, ray.direction);
+        float c = glm::dot(offset, offset) - store.r[body] * store.r[body];
+        if (c <= 0.0f) { return 0.0f; }
+        float discriminant = b * b - a * c;
+        if (discriminant < 0.0f || b > 0.0f) { return -1.0f; }
+        return (-b - std::sqrt(discriminant)) / a;
+    }
+
+public:
+    //check for collision between two spheres over the next dt seconds
+    static bool checkCollision(const SphereBody &s1, const SphereBody &s2, float dt) {
+        return checkCollision(s1.getPosition(), s1.getVelocity() * dt, s1.getRadius(), s2.getPosition(), s2.getVelocity() * dt, s2.getRadius());
+    }
+
+    //check for collision between two spheres given their positions, displacements over the tick, and radii
+    static bool checkCollision(glm::vec3 pos1, glm::vec3 v1, float r1, glm::vec3 pos2, glm::vec3 v2, float r2) {
+        Contact contact{};
+        return SphereNarrowphase::sweep(pos1, v1, r1, pos2, v2, r2, contact);
+    }
+};
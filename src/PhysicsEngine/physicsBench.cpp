@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "physics.hpp"
+
+//steps parameterized scenes for a number of ticks at several body and thread counts, and prints one JSON object describing every run
+//usage: PhysicsBench [--scenes falling,pile,sparse] [--bodies 1000,10000,100000] [--threads 1,N] [--ticks 300] [--warmup 30]
+
+struct BenchRun {
+    std::string scene;
+    size_t bodies;
+    unsigned threads;
+    int ticks;
+    double nsPerBodyTick;
+    double tickP50Ms;
+    double tickP99Ms;
+    double pairsPerTick;
+    double contactsPerTick;
+    size_t sleepingBodies;
+};
+
+//a world and the bodies it views. The bodies must not move in memory once added, so they are reserved up front.
+struct BenchScene {
+    World world;
+    std::vector<SphereBody> spheres;
+};
+
+//spheres of radius 0.5 on a jittered lattice above the ground, falling onto it and each other
+void buildFalling(BenchScene &scene, size_t count, std::mt19937 &rng) {
+    std::uniform_real_distribution<float> jitter(-0.1f, 0.1f);
+    auto side = (size_t)std::ceil(std::sqrt((double)count / 8.0));
+    for (size_t i = 0; i < count; ++i) {
+        size_t x = i % side, y = i / side % side, z = i / (side * side);
+        scene.spheres.emplace_back((float)x * 1.5f + jitter(rng), (float)y * 1.5f + jitter(rng), 2.0f + (float)z * 1.5f, 1.0f, 0.5f);
+    }
+    scene.world.gravity = {0.0f, 0.0f, -9.81f};
+}
+
+//spheres packed into a box a little too small for them, so that nearly every sphere touches several others from the first tick
+void buildPile(BenchScene &scene, size_t count, std::mt19937 &rng) {
+    auto side = (float)std::cbrt((double)count) * 0.9f;
+    std::uniform_real_distribution<float> across(0.0f, side), up(0.5f, 0.5f + side);
+    for (size_t i = 0; i < count; ++i) { scene.spheres.emplace_back(across(rng), across(rng), up(rng), 1.0f, 0.5f); }
+    scene.world.gravity = {0.0f, 0.0f, -9.81f};
+}
+
+//spheres scattered through a large volume with random velocities and no gravity, so that they rarely meet
+void buildSparse(BenchScene &scene, size_t count, std::mt19937 &rng) {
+    auto side = (float)std::cbrt((double)count) * 8.0f;
+    std::uniform_real_distribution<float> across(-side, side), speed(-5.0f, 5.0f);
+    for (size_t i = 0; i < count; ++i) {
+        scene.spheres.emplace_back(across(rng), across(rng), across(rng), 1.0f, 0.5f);
+        scene.spheres.back().setVelocity({speed(rng), speed(rng), speed(rng)});
+    }
+}
+
+std::unique_ptr<BenchScene> buildScene(const std::string &name, size_t count) {
+    auto scene = std::make_unique<BenchScene>();
+    scene->spheres.reserve(count + 1);
+    std::mt19937 rng(1234);
+    if (name == "falling") { buildFalling(*scene, count, rng); }
+    else if (name == "pile") { buildPile(*scene, count, rng); }
+    else if (name == "sparse") { buildSparse(*scene, count, rng); }
+    else { return nullptr; }
+    //scenes with gravity rest on a static sphere large enough to be nearly flat
+    if (scene->world.gravity != glm::vec3(0.0f)) { scene->spheres.emplace_back(0.0f, 0.0f, -10000.0f, 0.0f, 10000.0f); }
+    scene->world.store.reserve(scene->spheres.size());
+    for (SphereBody &sphere : scene->spheres) { scene->world.addBody(&sphere); }
+    return scene;
+}
+
+BenchRun run(const std::string &name, size_t count, unsigned threads, int ticks, int warmup) {
+    std::unique_ptr<BenchScene> scene = buildScene(name, count);
+    std::unique_ptr<ThreadPool> pool;
+    if (threads > 1) {
+        pool = std::make_unique<ThreadPool>(threads - 1);
+        scene->world.threadPool = pool.get();
+    }
+    World &world = scene->world;
+    for (int i = 0; i < warmup; ++i) { world.step(); }
+    std::vector<double> tickMs;
+    tickMs.reserve(ticks);
+    double pairs{}, contacts{};
+    for (int i = 0; i < ticks; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        world.step();
+        tickMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        pairs += (double)world.candidatePairs.size();
+        contacts += (double)world.contacts.size();
+    }
+    double total{};
+    for (double ms : tickMs) { total += ms; }
+    std::sort(tickMs.begin(), tickMs.end());
+    auto percentile = [&](double p) { return tickMs[std::min(tickMs.size() - 1, (size_t)(p * (double)tickMs.size()))]; };
+    return {name, count, threads, ticks, total * 1e6 / ((double)ticks * (double)count), percentile(0.5), percentile(0.99), pairs / ticks, contacts / ticks, world.sleepingBodyCount()};
+}
+
+template<typename T> std::vector<T> parseList(const char *text) {
+    std::vector<T> values;
+    std::string item;
+    for (const char *c = text;; ++c) {
+        if (*c == ',' || *c == '\0') {
+            if (!item.empty()) {
+                if constexpr (std::is_same_v<T, std::string>) { values.push_back(item); }
+                else { values.push_back((T)std::stoull(item)); }
+            }
+            item.clear();
+            if (*c == '\0') { break; }
+        } else { item += *c; }
+    }
+    return values;
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::string> scenes{"falling", "pile", "sparse"};
+    std::vector<size_t> bodyCounts{1000, 10000, 100000};
+    std::vector<unsigned> threadCounts{1, std::max(1u, std::thread::hardware_concurrency())};
+    int ticks{300}, warmup{30};
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--scenes") == 0) { scenes = parseList<std::string>(argv[i + 1]); }
+        else if (std::strcmp(argv[i], "--bodies") == 0) { bodyCounts = parseList<size_t>(argv[i + 1]); }
+        else if (std::strcmp(argv[i], "--threads") == 0) { threadCounts = parseList<unsigned>(argv[i + 1]); }
+        else if (std::strcmp(argv[i], "--ticks") == 0) { ticks = std::max(1, std::stoi(argv[i + 1])); }
+        else if (std::strcmp(argv[i], "--warmup") == 0) { warmup = std::max(0, std::stoi(argv[i + 1])); }
+        else {
+            std::cerr << "unknown option " << argv[i] << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    for (const std::string &scene : scenes) {
+        if (buildScene(scene, 0) == nullptr) {
+            std::cerr << "unknown scene " << scene << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+    std::cout << "{\"ticks\":" << ticks << ",\"warmup\":" << warmup << ",\"runs\":[";
+    bool first = true;
+    for (const std::string &scene : scenes) {
+        for (size_t bodies : bodyCounts) {
+            for (unsigned threads : threadCounts) {
+                BenchRun r = run(scene, bodies, std::max(1u, threads), ticks, warmup);
+                std::cout << (first ? "" : ",") << "\n{\"scene\":\"" << r.scene << "\",\"bodies\":" << r.bodies << ",\"threads\":" << r.threads
+                          << ",\"nsPerBodyTick\":" << r.nsPerBodyTick << ",\"tickP50Ms\":" << r.tickP50Ms << ",\"tickP99Ms\":" << r.tickP99Ms
+                          << ",\"pairsPerTick\":" << r.pairsPerTick << ",\"contactsPerTick\":" << r.contactsPerTick << ",\"sleepingBodies\":" << r.sleepingBodies << "}";
+                std::cout.flush();
+                first = false;
+            }
+        }
+    }
+    std::cout << "\n]}" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+//the model matrix of a body at position, turned by the euler angles rotation, and scaled by scale
+inline glm::mat4 bodyTransform(glm::vec3 position, glm::vec3 rotation, glm::vec3 scale) {
+    glm::mat3 turn = glm::mat3_cast(glm::quat(rotation));
+    return {glm::vec4(turn[0] * scale.x, 0.0f), glm::vec4(turn[1] * scale.y, 0.0f), glm::vec4(turn[2] * scale.z, 0.0f), glm::vec4(position, 1.0f)};
+}
+
+//three copies of a value shared between one writer thread and one reader thread, neither of which ever waits for the other. The writer fills the back copy and publishes it; the reader takes the most recently published copy, which the writer will not touch again until the reader has moved on to a newer one.
+template<typename T> class TripleBuffer {
+public:
+    //the copy only the writer may touch
+    T &back() {
+        return buffers[backIndex];
+    }
+
+    //swap the back copy into the middle, where the reader will find it
+    void publish() {
+        backIndex = middle.exchange(backIndex | freshBit, std::memory_order_acq_rel) & indexMask;
+    }
+
+    //take the most recently published copy if there is one the reader has not seen, and return the copy the reader now holds. Only the reader may call this.
+    const T &acquire() {
+        if (middle.load(std::memory_order_relaxed) & freshBit) { frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & indexMask; }
+        return buffers[frontIndex];
+    }
+
+private:
+    static constexpr uint8_t freshBit = 4;
+    static constexpr uint8_t indexMask = 3;
+
+    std::array<T, 3> buffers{};
+    uint8_t backIndex{0}; //owned by the writer
+    uint8_t frontIndex{1}; //owned by the reader
+    std::atomic<uint8_t> middle{2}; //the copy between them, and whether the writer published it since the reader last took it
+};
+
+//the interpolated state of every body at the end of an update, as published for the renderer
+struct PublishedBodies {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> rotations;
+    uint64_t tick{}; //the tick the world had reached
+    uint64_t frame{}; //counts up by one with every publish, so readers can tell whether anything changed
+
+    [[nodiscard]] size_t size() const {
+        return positions.size();
+    }
+
+    //write the model matrix of bodies [firstBody, firstBody + count) to transforms, scaled by scale, in the same way as World::writeTransforms
+    void writeTransforms(uint32_t firstBody, size_t count, glm::mat4 *transforms, glm::vec3 scale = glm::vec3(1.0f)) const {
+        for (size_t i = 0; i < count; ++i) { transforms[i] = bodyTransform(positions[firstBody + i], rotations[firstBody + i], scale); }
+    }
+};
+
+//the interpolated shape of a cloth at the end of an update, as published for the renderer
+struct PublishedCloth {
+    std::vector<glm::vec3> positions; //one for each vertex of the mesh the cloth was built from, in the same order
+    std::vector<glm::vec3> normals;
+    uint64_t frame{}; //counts up by one with every publish, so readers can tell whether anything changed
+
+    [[nodiscard]] size_t size() const {
+        return positions.size();
+    }
+
+    //write the position and normal of every vertex, with stride bytes from one vertex to the next, so that they go straight into an asset's vertices in mapped GPU memory: writeVertices(&vertices[0].pos, &vertices[0].normal, sizeof(Vertex)). Nothing is read back.
+    void writeVertices(glm::vec3 *positionsOut, glm::vec3 *normalsOut, size_t stride) const {
+        auto *positionBytes = reinterpret_cast<uint8_t *>(positionsOut), *normalBytes = reinterpret_cast<uint8_t *>(normalsOut);
+        for (size_t i = 0; i < positions.size(); ++i) {
+            *reinterpret_cast<glm::vec3 *>(positionBytes + i * stride) = positions[i];
+            *reinterpret_cast<glm::vec3 *>(normalBytes + i * stride) = normals[i];
+        }
+    }
+};
+
+//the particles of a fluid as of one publish
+struct PublishedFluid {
+    std::vector<glm::vec3> positions; //one for each particle, in no lasting order
+    uint64_t frame{};
+
+    [[nodiscard]] size_t size() const {
+        return positions.size();
+    }
+
+    //write a copy of a small shape at every particle, shapeCount vertices each, with stride bytes from one vertex to the next: writeVertices(&vertices[0].pos, &vertices[0].normal, sizeof(Vertex), corners, normals, 4). Only position and normal are written, so everything else about the vertices, indices included, can be set up once.
+    void writeVertices(glm::vec3 *positionsOut, glm::vec3 *normalsOut, size_t stride, const glm::vec3 *shape, const glm::vec3 *shapeNormals, size_t shapeCount) const {
+        auto *positionBytes = reinterpret_cast<uint8_t *>(positionsOut), *normalBytes = reinterpret_cast<uint8_t *>(normalsOut);
+        for (size_t i = 0; i < positions.size(); ++i) {
+            for (size_t k = 0; k < shapeCount; ++k) {
+                size_t offset = (i * shapeCount + k) * stride;
+                *reinterpret_cast<glm::vec3 *>(positionBytes + offset) = positions[i] + shape[k];
+                *reinterpret_cast<glm::vec3 *>(normalBytes + offset) = shapeNormals[k];
+            }
+        }
+    }
+};
+
+//the living particles of an emitter as of one publish
+struct PublishedParticles {
+    std::vector<glm::vec4> instances; //the position and size of every living particle, packed one to an instance, in no lasting order
+    uint64_t frame{};
+
+    [[nodiscard]] size_t size() const {
+        return instances.size();
+    }
+
+    //copy up to capacity packed instances to out, so that they go straight into an asset's packed instance buffer and are drawn with one instanced call, the vertex shader scaling a shape of unit size to each particle's size and moving it to its position. Returns the number written.
+    size_t writeInstances(glm::vec4 *out, size_t capacity) const {
+        size_t count = std::min(capacity, instances.size());
+        if (count != 0) { std::memcpy(out, instances.data(), count * sizeof(glm::vec4)); }
+        return count;
+    }
+};
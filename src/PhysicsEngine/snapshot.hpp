@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+//the whole simulation state of a world at the end of a tick, as written by World::saveSnapshot
+struct WorldSnapshot {
+    std::vector<uint8_t> data;
+    uint64_t tick{UINT64_MAX}; //the tick this snapshot was taken after, or UINT64_MAX if it holds nothing
+};
+
+//a fixed number of snapshots, one per tick, overwriting the oldest. Slots keep their buffers, so once every slot has been filled once saving a snapshot does not allocate.
+class SnapshotRing {
+public:
+    explicit SnapshotRing(size_t capacity) : slots(std::max<size_t>(capacity, 1)) {}
+
+    //the slot to save the snapshot of tick into, which is the one holding the snapshot from capacity ticks ago
+    WorldSnapshot &acquire(uint64_t tick) {
+        WorldSnapshot &slot = slots[tick % slots.size()];
+        slot.tick = tick;
+        return slot;
+    }
+
+    //the snapshot of tick, or null if it was never saved or has since been overwritten
+    [[nodiscard]] const WorldSnapshot *find(uint64_t tick) const {
+        const WorldSnapshot &slot = slots[tick % slots.size()];
+        return slot.tick == tick ? &slot : nullptr;
+    }
+
+    [[nodiscard]] size_t capacity() const {
+        return slots.size();
+    }
+
+    //forget every snapshot, keeping the buffers
+    void clear() {
+        for (WorldSnapshot &slot : slots) { slot.tick = UINT64_MAX; }
+    }
+
+private:
+    std::vector<WorldSnapshot> slots;
+};
+
+//encodes a snapshot as the 4 byte words that differ from another one, such as the snapshot of the tick before. Most of a world that is partly asleep does not change from tick to tick, so deltas are far smaller than the snapshots they encode.
+//a delta is the target size followed by runs of (words to keep from the base, words to copy, the copied words)
+class SnapshotDelta {
+public:
+    static void encode(const WorldSnapshot &base, const WorldSnapshot &target, std::vector<uint8_t> &delta) {
+        delta.clear();
+        put(delta, (uint32_t)target.data.size());
+        size_t words = (target.data.size() + 3) / 4, shared = std::min(base.data.size(), target.data.size()) / 4;
+        size_t i{};
+        while (i < words) {
+            size_t runStart = i;
+            while (i < shared && sameWord(base, target, i)) { ++i; }
+            size_t copyStart = i;
+            //short matches inside a changed run cost more to encode as a new run than to copy
+            while (i < words && (i >= shared || !sameWord(base, target, i) || (i + 1 < shared && !sameWord(base, target, i + 1)))) { ++i; }
+            put(delta, (uint32_t)(copyStart - runStart));
+            put(delta, (uint32_t)(i - copyStart));
+            size_t from = copyStart * 4, to = std::min(i * 4, target.data.size());
+            delta.insert(delta.end(), target.data.begin() + (ptrdiff_t)from, target.data.begin() + (ptrdiff_t)to);
+        }
+    }
+
+    //rebuild the target of delta from the base it was encoded against. Returns false if the delta does not fit the base.
+    static bool decode(const WorldSnapshot &base, const std::vector<uint8_t> &delta, WorldSnapshot &target) {
+        const uint8_t *in = delta.data(), *end = delta.data() + delta.size();
+        uint32_t size;
+        if (!get(in, end, size)) { return false; }
+        target.data.resize(size);
+        size_t at{};
+        while (in < end) {
+            uint32_t keep, copy;
+            if (!get(in, end, keep) || !get(in, end, copy)) { return false; }
+            size_t keepBytes = (size_t)keep * 4, copyBytes = std::min((size_t)copy * 4, size - std::min<size_t>(size, at + keepBytes));
+            if (at + keepBytes > std::min(base.data.size(), (size_t)size) || (size_t)(end - in) < copyBytes) { return false; }
+            std::memcpy(target.data.data() + at, base.data.data() + at, keepBytes);
+            at += keepBytes;
+            std::memcpy(target.data.data() + at, in, copyBytes);
+            at += copyBytes;
+            in += copyBytes;
+        }
+        return at == size;
+    }
+
+private:
+    static bool sameWord(const WorldSnapshot &base, const WorldSnapshot &target, size_t word) {
+        return std::memcmp(base.data.data() + word * 4, target.data.data() + word * 4, 4) == 0;
+    }
+
+    static void put(std::vector<uint8_t> &out, uint32_t value) {
+        uint8_t bytes[sizeof(value)];
+        std::memcpy(bytes, &value, sizeof(value));
+        out.insert(out.end(), bytes, bytes + sizeof(value));
+    }
+
+    static bool get(const uint8_t *&in, const uint8_t *end, uint32_t &value) {
+        if ((size_t)(end - in) < sizeof(value)) { return false; }
+        std::memcpy(&value, in, sizeof(value));
+        in += sizeof(value);
+        return true;
+    }
+};
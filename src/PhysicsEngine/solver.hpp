@@ -0,0 +1,284 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "bodyStore.hpp"
+#include "narrowphase.hpp"
+
+//sequential impulse contact solver. Each contact is pushed apart along its normal and held back along its surface by Coulomb friction, one contact at a time, for a few passes. The impulses each contact ends a tick with are kept and applied up front the next tick, so resting contacts start close to their answer and need few passes to converge.
+class ContactSolver {
+public:
+    int iterations{6}; //passes over every contact per tick
+    float restitution{0.2f}; //how much of the closing speed a contact gives back
+    float restitutionThreshold{1.0f}; //closing speeds below this do not bounce, so that resting bodies settle
+    float friction{0.5f}; //how much tangential impulse a contact may take per unit of normal impulse
+    float baumgarte{0.2f}; //the fraction of penetration pushed out per tick
+    float slop{0.005f}; //penetration allowed before it is pushed out, so that resting contacts do not jitter
+
+    //size the solver for count contacts. Must be called before any of them are solved.
+    void prepare(size_t count) {
+        constraints.resize(count);
+    }
+
+    //solve the listed contacts, or every contact if indices is null. Contacts that share a body must be solved in the same call, but separate islands may be solved concurrently.
+    void solve(BodyStore &store, const ContactManifold &contacts, const uint32_t *indices, size_t count, float dt) {
+        auto contactAt = [&](size_t i) { return indices == nullptr ? (uint32_t)i : indices[i]; };
+        for (size_t i = 0; i < count; ++i) { setUp(store, contacts[contactAt(i)], constraints[contactAt(i)], dt); }
+        for (size_t i = 0; i < count; ++i) {
+            Constraint &c = constraints[contactAt(i)];
+            applyImpulse(store, c, c.normal * c.normalImpulse + c.tangent1 * c.tangentImpulse1 + c.tangent2 * c.tangentImpulse2);
+        }
+        for (int iteration = 0; iteration < iterations; ++iteration) {
+            for (size_t i = 0; i < count; ++i) { solveConstraint(store, constraints[contactAt(i)]); }
+        }
+    }
+
+    //remember the impulse of every contact solved this tick for warm starting the next one. Contacts that ended are forgotten, except those of sleeping bodies, which are kept for when they wake.
+    void cacheImpulses(const ContactManifold &contacts, const BodyStore &store) {
+        ++tick;
+        for (size_t i = 0; i < contacts.size(); ++i) {
+            const Constraint &c = constraints[i];
+            cache[key(contacts[i])] = {c.normalImpulse, c.tangent1 * c.tangentImpulse1 + c.tangent2 * c.tangentImpulse2, tick};
+        }
+        //no contact solved this tick involves a sleeping body, so only the keys of awake pairs need looking up
+        keptKeys.clear();
+        for (const ContactKey &k : cachedKeys) {
+            if (store.asleep[k.a] || store.asleep[k.b]) { keptKeys.push_back(k); }
+            else {
+                auto cached = cache.find(k);
+                if (cached != cache.end() && cached->second.tick != tick) { cache.erase(cached); }
+            }
+        }
+        for (const Contact &contact : contacts) { keptKeys.push_back(key(contact)); }
+        std::swap(cachedKeys, keptKeys);
+    }
+
+    //the number of bytes write needs
+    [[nodiscard]] size_t serializedSize() const {
+        return 2 * sizeof(uint32_t) + cachedKeys.size() * sizeof(CachedRecord);
+    }
+
+    //copy every cached impulse to out in the order they were cached, and return the end of what was written
+    uint8_t *write(uint8_t *out) const {
+        auto count = (uint32_t)cachedKeys.size();
+        std::memcpy(out, &tick, sizeof(tick));
+        std::memcpy(out + sizeof(tick), &count, sizeof(count));
+        out += sizeof(tick) + sizeof(count);
+        for (const ContactKey &k : cachedKeys) {
+            CachedRecord record{k, cache.at(k)};
+            std::memcpy(out, &record, sizeof(record));
+            out += sizeof(record);
+        }
+        return out;
+    }
+
+    //check that [in, end) starts with impulses written by write for a store of bodyCount bodies, without changing anything. Returns the end of them, or null if they run past end or a key names a body outside the store.
+    [[nodiscard]] static const uint8_t *validate(const uint8_t *in, const uint8_t *end, size_t bodyCount) {
+        uint32_t count;
+        if ((size_t)(end - in) < sizeof(tick) + sizeof(count)) { return nullptr; }
+        std::memcpy(&count, in + sizeof(tick), sizeof(count));
+        in += sizeof(tick) + sizeof(count);
+        if ((size_t)(end - in) / sizeof(CachedRecord) < count) { return nullptr; }
+        for (uint32_t i = 0; i < count; ++i, in += sizeof(CachedRecord)) {
+            CachedRecord record;
+            std::memcpy(&record, in, sizeof(record));
+            if (record.key.a >= bodyCount || record.key.b >= bodyCount) { return nullptr; }
+        }
+        return in;
+    }
+
+    //replace the cache with impulses written by write. Returns the end of what was read, or null, changing nothing, if validate fails.
+    const uint8_t *read(const uint8_t *in, const uint8_t *end, size_t bodyCount) {
+        if (validate(in, end, bodyCount) == nullptr) { return nullptr; }
+        uint32_t count;
+        std::memcpy(&tick, in, sizeof(tick));
+        std::memcpy(&count, in + sizeof(tick), sizeof(count));
+        in += sizeof(tick) + sizeof(count);
+        clear();
+        cachedKeys.resize(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            CachedRecord record;
+            std::memcpy(&record, in, sizeof(record));
+            in += sizeof(record);
+            cachedKeys[i] = record.key;
+            cache.emplace(record.key, record.impulse);
+        }
+        return in;
+    }
+
+    //renumber the bodies of every cached impulse after bodies were moved within the store. newIndex holds the new index of each old one, or UINT32_MAX for bodies that were removed, whose impulses are dropped.
+    void remapBodies(const std::vector<uint32_t> &newIndex) {
+        remapped.clear();
+        keptKeys.clear();
+        for (const ContactKey &k : cachedKeys) {
+            ContactKey remappedKey{newIndex[k.a], newIndex[k.b], k.feature};
+            if (remappedKey.a == UINT32_MAX || remappedKey.b == UINT32_MAX) { continue; }
+            CachedImpulse impulse = cache.at(k);
+            //pairs of whole bodies are keyed lowest body first, and the friction impulse is the one applied to the second body
+            if (remappedKey.feature == 0 && remappedKey.a > remappedKey.b) {
+                std::swap(remappedKey.a, remappedKey.b);
+                impulse.tangent = -impulse.tangent;
+            }
+            remapped.emplace(remappedKey, impulse);
+            keptKeys.push_back(remappedKey);
+        }
+        std::swap(cache, remapped);
+        std::swap(cachedKeys, keptKeys);
+    }
+
+    //forget every cached impulse
+    void clear() {
+        cache.clear();
+        cachedKeys.clear();
+    }
+
+private:
+    struct ContactKey {
+        uint32_t a, b, feature;
+
+        bool operator==(const ContactKey &other) const {
+            return a == other.a && b == other.b && feature == other.feature;
+        }
+    };
+
+    struct ContactKeyHash {
+        size_t operator()(const ContactKey &k) const {
+            return std::hash<uint64_t>()((uint64_t)k.a << 32 | k.b) ^ (size_t)k.feature * 0x9E3779B97F4A7C15ull;
+        }
+    };
+
+    struct CachedImpulse {
+        float normal;
+        glm::vec3 tangent; //kept in world space, since the tangent axes are rebuilt each tick
+        uint32_t tick; //the tick the impulse was last solved in
+    };
+
+    struct CachedRecord {
+        ContactKey key;
+        CachedImpulse impulse;
+    };
+
+    struct Constraint {
+        uint32_t a, b;
+        glm::vec3 normal, tangent1, tangent2;
+        glm::vec3 armA, armB; //from each body's center to the contact
+        float invMassA, invMassB, invInertiaA, invInertiaB;
+        float normalMass, tangentMass1, tangentMass2; //the inverse of the effective mass along each axis
+        float bias; //the normal speed the contact aims for
+        float normalImpulse, tangentImpulse1, tangentImpulse2; //accumulated over the tick
+    };
+
+    std::vector<Constraint> constraints{};
+    std::unordered_map<ContactKey, CachedImpulse, ContactKeyHash> cache{}, remapped{};
+    std::vector<ContactKey> cachedKeys{}, keptKeys{}; //every key in the cache
+    uint32_t tick{};
+
+    static ContactKey key(const Contact &contact) {
+        return {contact.a, contact.b, contact.feature};
+    }
+
+    static glm::vec3 velocity(const BodyStore &store, uint32_t i) {
+        return {store.vX[i], store.vY[i], store.vZ[i]};
+    }
+
+    static glm::vec3 angularVelocity(const BodyStore &store, uint32_t i) {
+        return {store.rotVX[i], store.rotVY[i], store.rotVZ[i]};
+    }
+
+    //spheres are treated as solid, anything without a radius as a point that cannot spin
+    static float inverseInertia(const BodyStore &store, uint32_t i) {
+        return store.r[i] > 0.0f ? 2.5f * store.invM[i] / (store.r[i] * store.r[i]) : 0.0f;
+    }
+
+    void setUp(const BodyStore &store, const Contact &contact, Constraint &c, float dt) const {
+        c.a = contact.a;
+        c.b = contact.b;
+        c.normal = contact.normal;
+        //a fixed basis around the normal, so that cached friction can be projected back onto it
+        c.tangent1 = std::abs(c.normal.x) >= 0.57735f ? glm::normalize(glm::vec3(c.normal.y, -c.normal.x, 0.0f)) : glm::normalize(glm::vec3(0.0f, c.normal.z, -c.normal.y));
+        c.tangent2 = glm::cross(c.normal, c.tangent1);
+        //spheres touch along the normal, while contacts between other shapes say where they touch
+        glm::vec3 posA(store.posX[c.a], store.posY[c.a], store.posZ[c.a]), posB(store.posX[c.b], store.posY[c.b], store.posZ[c.b]);
+        bool spheres = std::isnan(contact.separation);
+        c.armA = spheres ? c.normal * store.r[c.a] : contact.point - posA;
+        c.armB = spheres ? -c.normal * store.r[c.b] : contact.point - posB;
+        c.invMassA = store.invM[c.a];
+        c.invMassB = store.invM[c.b];
+        c.invInertiaA = inverseInertia(store, c.a);
+        c.invInertiaB = inverseInertia(store, c.b);
+        c.normalMass = effectiveMass(c, c.normal);
+        c.tangentMass1 = effectiveMass(c, c.tangent1);
+        c.tangentMass2 = effectiveMass(c, c.tangent2);
+        //contacts that have not closed yet may approach until they touch by the end of the tick. Contacts that have closed push out part of their penetration, and bounce if they hit hard enough.
+        float separation = spheres ? glm::dot(posB - posA, c.normal) - store.r[c.a] - store.r[c.b] : contact.separation;
+        float closingSpeed = glm::dot(relativeVelocity(store, c), c.normal);
+        if (separation > 0.0f) { c.bias = -separation / dt; }
+        else {
+            c.bias = baumgarte * std::max(-separation - slop, 0.0f) / dt;
+            if (closingSpeed < -restitutionThreshold) { c.bias = std::max(c.bias, -restitution * closingSpeed); }
+        }
+        auto cached = cache.find(key(contact));
+        if (cached == cache.end()) {
+            c.normalImpulse = c.tangentImpulse1 = c.tangentImpulse2 = 0.0f;
+            return;
+        }
+        c.normalImpulse = cached->second.normal;
+        c.tangentImpulse1 = glm::dot(cached->second.tangent, c.tangent1);
+        c.tangentImpulse2 = glm::dot(cached->second.tangent, c.tangent2);
+    }
+
+    static float effectiveMass(const Constraint &c, glm::vec3 axis) {
+        glm::vec3 turnA = glm::cross(c.armA, axis), turnB = glm::cross(c.armB, axis);
+        float k = c.invMassA + c.invMassB + c.invInertiaA * glm::dot(turnA, turnA) + c.invInertiaB * glm::dot(turnB, turnB);
+        return k > 0.0f ? 1.0f / k : 0.0f;
+    }
+
+    //the velocity of b's contact point relative to a's
+    static glm::vec3 relativeVelocity(const BodyStore &store, const Constraint &c) {
+        glm::vec3 pointA = velocity(store, c.a) + glm::cross(angularVelocity(store, c.a), c.armA);
+        glm::vec3 pointB = velocity(store, c.b) + glm::cross(angularVelocity(store, c.b), c.armB);
+        return pointB - pointA;
+    }
+
+    //push b by impulse and a by its opposite. Static bodies are never written, since islands solved at the same time may share them.
+    static void applyImpulse(BodyStore &store, const Constraint &c, glm::vec3 impulse) {
+        if (c.invMassA > 0.0f) {
+            glm::vec3 va = velocity(store, c.a) - impulse * c.invMassA, wa = angularVelocity(store, c.a) - glm::cross(c.armA, impulse) * c.invInertiaA;
+            store.vX[c.a] = va.x; store.vY[c.a] = va.y; store.vZ[c.a] = va.z;
+            store.rotVX[c.a] = wa.x; store.rotVY[c.a] = wa.y; store.rotVZ[c.a] = wa.z;
+        }
+        if (c.invMassB > 0.0f) {
+            glm::vec3 vb = velocity(store, c.b) + impulse * c.invMassB, wb = angularVelocity(store, c.b) + glm::cross(c.armB, impulse) * c.invInertiaB;
+            store.vX[c.b] = vb.x; store.vY[c.b] = vb.y; store.vZ[c.b] = vb.z;
+            store.rotVX[c.b] = wb.x; store.rotVY[c.b] = wb.y; store.rotVZ[c.b] = wb.z;
+        }
+    }
+
+    void solveConstraint(BodyStore &store, Constraint &c) const {
+        //friction first, limited by the normal impulse from the last pass, and clamped as a disc rather than a box so that it does not depend on the tangent axes
+        glm::vec3 v = relativeVelocity(store, c);
+        float old1 = c.tangentImpulse1, old2 = c.tangentImpulse2;
+        float t1 = old1 - glm::dot(v, c.tangent1) * c.tangentMass1;
+        float t2 = old2 - glm::dot(v, c.tangent2) * c.tangentMass2;
+        float limit = friction * c.normalImpulse, length = std::sqrt(t1 * t1 + t2 * t2);
+        if (length > limit) {
+            float scale = length > 0.0f ? limit / length : 0.0f;
+            t1 *= scale;
+            t2 *= scale;
+        }
+        c.tangentImpulse1 = t1;
+        c.tangentImpulse2 = t2;
+        applyImpulse(store, c, c.tangent1 * (t1 - old1) + c.tangent2 * (t2 - old2));
+        //then the normal, which may only ever push
+        float closingSpeed = glm::dot(relativeVelocity(store, c), c.normal);
+        float old = c.normalImpulse;
+        c.normalImpulse = std::max(old + (c.bias - closingSpeed) * c.normalMass, 0.0f);
+        applyImpulse(store, c, c.normal * (c.normalImpulse - old));
+    }
+};
@@ -0,0 +1,60 @@
+! kernels to run over the bodies of a world, as examples of what FortranScriptCaller can register
+
+! pull every body towards a point by a spring of its own stiffness along each axis.
+! parameters: the point's x, y and z, then the stiffness along x, y and z per unit of mass
+subroutine crystal_spring_field(bodies) bind(C, name="crystal_spring_field")
+    use crystal_bodies
+    implicit none
+    type(body_arrays), intent(in) :: bodies
+    real(c_float), pointer :: p(:), x(:), y(:), z(:), v_x(:), v_y(:), v_z(:), inv_m(:)
+    integer(c_int8_t), pointer :: asleep(:)
+    integer(c_int64_t) :: i
+    if (bodies%parameter_count < 6) return
+    p => kernel_parameters(bodies)
+    x => body_array(bodies%pos_x, bodies%count)
+    y => body_array(bodies%pos_y, bodies%count)
+    z => body_array(bodies%pos_z, bodies%count)
+    v_x => body_array(bodies%v_x, bodies%count)
+    v_y => body_array(bodies%v_y, bodies%count)
+    v_z => body_array(bodies%v_z, bodies%count)
+    inv_m => body_array(bodies%inv_m, bodies%count)
+    asleep => asleep_array(bodies)
+    do i = 1, bodies%count
+        if (asleep(i) /= 0 .or. inv_m(i) <= 0) cycle
+        v_x(i) = v_x(i) + p(4) * (p(1) - x(i)) * bodies%dt
+        v_y(i) = v_y(i) + p(5) * (p(2) - y(i)) * bodies%dt
+        v_z(i) = v_z(i) + p(6) * (p(3) - z(i)) * bodies%dt
+    end do
+end subroutine crystal_spring_field
+
+! slow every body as though moving through air, losing a fraction of its velocity every second.
+! parameters: the fraction lost per second, along and around every axis
+subroutine crystal_linear_drag(bodies) bind(C, name="crystal_linear_drag")
+    use crystal_bodies
+    implicit none
+    type(body_arrays), intent(in) :: bodies
+    real(c_float), pointer :: p(:), v_x(:), v_y(:), v_z(:), rot_v_x(:), rot_v_y(:), rot_v_z(:), inv_m(:)
+    integer(c_int8_t), pointer :: asleep(:)
+    integer(c_int64_t) :: i
+    real(c_float) :: keep
+    if (bodies%parameter_count < 1) return
+    p => kernel_parameters(bodies)
+    keep = max(1.0 - p(1) * bodies%dt, 0.0)
+    v_x => body_array(bodies%v_x, bodies%count)
+    v_y => body_array(bodies%v_y, bodies%count)
+    v_z => body_array(bodies%v_z, bodies%count)
+    rot_v_x => body_array(bodies%rot_v_x, bodies%count)
+    rot_v_y => body_array(bodies%rot_v_y, bodies%count)
+    rot_v_z => body_array(bodies%rot_v_z, bodies%count)
+    inv_m => body_array(bodies%inv_m, bodies%count)
+    asleep => asleep_array(bodies)
+    do i = 1, bodies%count
+        if (asleep(i) /= 0 .or. inv_m(i) <= 0) cycle
+        v_x(i) = v_x(i) * keep
+        v_y(i) = v_y(i) * keep
+        v_z(i) = v_z(i) * keep
+        rot_v_x(i) = rot_v_x(i) * keep
+        rot_v_y(i) = rot_v_y(i) * keep
+        rot_v_z(i) = rot_v_z(i) * keep
+    end do
+end subroutine crystal_linear_drag
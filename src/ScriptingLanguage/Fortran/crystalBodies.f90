@@ -0,0 +1,51 @@
+! the bodies of a world as FortranScriptCaller hands them to a kernel. The arrays are the body store's own,
+! so a kernel reads and writes every body in place. Kernels take a body_arrays and nothing else:
+!
+!     subroutine my_kernel(bodies) bind(C, name="my_kernel")
+!         use crystal_bodies
+!         type(body_arrays), intent(in) :: bodies
+!
+! Bodies with asleep set must be left alone, and bodies with no inverse mass do not move.
+module crystal_bodies
+    use, intrinsic :: iso_c_binding
+    implicit none
+
+    ! laid out to match FortranBodies in fortranScriptCaller.hpp
+    type, bind(C) :: body_arrays
+        integer(c_int64_t) :: count
+        real(c_float) :: dt
+        integer(c_int32_t) :: parameter_count
+        type(c_ptr) :: parameters
+        type(c_ptr) :: pos_x, pos_y, pos_z
+        type(c_ptr) :: v_x, v_y, v_z
+        type(c_ptr) :: rot_x, rot_y, rot_z
+        type(c_ptr) :: rot_v_x, rot_v_y, rot_v_z
+        type(c_ptr) :: m, inv_m, r
+        type(c_ptr) :: asleep
+    end type body_arrays
+
+contains
+
+    ! one of the body arrays as a Fortran array of count elements, without copying it
+    function body_array(array, count) result(view)
+        type(c_ptr), intent(in) :: array
+        integer(c_int64_t), intent(in) :: count
+        real(c_float), pointer :: view(:)
+        call c_f_pointer(array, view, [count])
+    end function body_array
+
+    ! whether each body is asleep, nonzero for sleeping bodies
+    function asleep_array(bodies) result(view)
+        type(body_arrays), intent(in) :: bodies
+        integer(c_int8_t), pointer :: view(:)
+        call c_f_pointer(bodies%asleep, view, [bodies%count])
+    end function asleep_array
+
+    ! the parameters the kernel was registered with
+    function kernel_parameters(bodies) result(view)
+        type(body_arrays), intent(in) :: bodies
+        real(c_float), pointer :: view(:)
+        call c_f_pointer(bodies%parameters, view, [int(bodies%parameter_count, c_int64_t)])
+    end function kernel_parameters
+
+end module crystal_bodies
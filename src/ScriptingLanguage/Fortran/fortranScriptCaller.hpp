@@ -1,14 +1,53 @@
 #pragma once
 
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "../../PhysicsEngine/physics.hpp"
+
+//the bodies of a world as a Fortran kernel sees them, laid out to match type(body_arrays) in crystalBodies.f90. The arrays are the body store's own, so kernels read and write bodies in place without anything being copied.
+struct FortranBodies {
+    int64_t count;
+    float dt;
+    int32_t parameterCount;
+    const float *parameters;
+    float *posX, *posY, *posZ;
+    float *vX, *vY, *vZ;
+    float *rotX, *rotY, *rotZ;
+    float *rotVX, *rotVY, *rotVZ;
+    const float *m, *invM, *r;
+    const uint8_t *asleep;
+};
+
+//a subroutine compiled from Fortran with bind(C) that takes a type(body_arrays)
+using FortranKernel = void (*)(const FortranBodies *bodies);
+
+#ifdef CRYSTAL_ENGINE_FORTRAN
+//the kernels in bodyKernels.f90
+extern "C" {
+    void crystal_spring_field(const FortranBodies *bodies);
+    void crystal_linear_drag(const FortranBodies *bodies);
+}
+#endif
+
+//runs kernels written in Fortran over every body of a world, one call per kernel per tick
 class FortranScriptCaller {
-    extern "C" {
-        void fortfunc(int *ii, float *ff);
+public:
+    //view the arrays of store, which stay valid until a body is added to or removed from it
+    static FortranBodies bodiesOf(BodyStore &store, float dt, const std::vector<float> &parameters) {
+        return {(int64_t)store.size(), dt, (int32_t)parameters.size(), parameters.data(), store.posX.data(), store.posY.data(), store.posZ.data(), store.vX.data(), store.vY.data(), store.vZ.data(), store.rotX.data(), store.rotY.data(), store.rotZ.data(), store.rotVX.data(), store.rotVY.data(), store.rotVZ.data(), store.m.data(), store.invM.data(), store.r.data(), store.asleep.data()};
+    }
+
+    //call kernel once over every body of store
+    static void run(FortranKernel kernel, BodyStore &store, float dt, const std::vector<float> &parameters = {}) {
+        if (store.size() == 0) { return; }
+        FortranBodies bodies = bodiesOf(store, dt, parameters);
+        kernel(&bodies);
     }
 
-    main() {
-        int ii = 5;
-        float ff = 5.5;
-        fortfunc(&ii, &ff);
-        return 0;
+    //call kernel over every body of world at when in every tick, with a copy of parameters
+    static void addStage(World &world, World::TickStage when, FortranKernel kernel, std::vector<float> parameters = {}) {
+        world.addStage(when, [kernel, parameters = std::move(parameters)](World &stepped, float dt) { run(kernel, stepped.store, dt, parameters); });
     }
-};
\ No newline at end of file
+};
@@ -0,0 +1,28 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+//one position and size per instance slot for every frame in flight, packed into a vec4. gl_InstanceIndex already includes the frame's offset, which is passed as the first instance of each draw.
+layout(std430, binding = 2) readonly buffer PackedInstances {
+    vec4 positionSize[];
+} instances;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+layout(location = 3) in vec3 inNormal;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+void main() {
+    //the model matrix of an instance only scales by its size and moves to its position
+    vec4 instance = instances.positionSize[gl_InstanceIndex];
+    gl_Position = ubo.proj * ubo.view * vec4(inPosition * instance.w + instance.xyz, 1.0);
+    fragColor = inColor;
+    fragTexCoord = inTexCoord;
+}
@@ -1,4 +1,9 @@
+#include <chrono>
 #include <iostream>
+#include <thread>
+
+#include "PhysicsEngine/physics.hpp"
+#include "ScriptingLanguage/Fortran/fortranScriptCaller.hpp"
 
 #ifdef CRYSTAL_ENGINE_VULKAN
 #include "GraphicsEngine/Vulkan/asset.hpp"
@@ -47,16 +52,104 @@ int main(int argc, char **argv) {
             VulkanRenderEngineRasterizer renderEngine = VulkanRenderEngineRasterizer();
             glfwSetWindowPosCallback(renderEngine.window, windowPositionCallback);
             renderEngine.camera.position = {0, 0, 2};
-            Asset cube = Asset("Models/cube.obj", {"Models/cube.png"}, {"Shaders/vertexShader.vert", "Shaders/fragmentShader.frag"}, {0, 0, 0}, {0, 0, 0});
-            Asset quad = Asset("Models/quad.obj", {"Models/quad_Color.png"}, {"Shaders/vertexShader.vert", "Shaders/fragmentShader.frag"}, {0, 0, 0}, {90,  0,  0}, {100, 100, 0});
-            Asset vikingRoom = Asset("Models/vikingRoom.obj", {"Models/vikingRoom.png"}, {"Shaders/vertexShader.vert", "Shaders/fragmentShader.frag"}, {0, 0, 0}, {0, 0, 0}, {5, 5, 5});
-            Asset statue = Asset("Models/ancientStatue.obj", {"Models/ancientStatue.png"}, {"Shaders/vertexShader.vert", "Shaders/fragmentShader.frag"}, {7, 2, 0}, {0, 0, 0});
-            Asset ball = Asset("Models/sphere.obj", {"Models/sphere_diffuse.png"}, {"Shaders/vertexShader.vert", "Shaders/fragmentShader.frag"});
+            //every asset's files load at once on the pool, each model also being parsed across it, and each asset is drawn from the first frame after it has loaded
+            ThreadPool loadingPool{};
+            Asset cube = Asset(loadingPool, "Models/cube.obj", {"Models/cube.png"}, {"Shaders/vertexShader.vert", "Shaders/fragmentShader.frag"}, {0, 0, 0}, {0, 0, 0});
+            Asset quad = Asset(loadingPool, "Models/quad.obj", {"Models/quad_Color.png"}, {"Shaders/vertexShader.vert", "Shaders/fragmentShader.frag"}, {0, 0, 0}, {90,  0,  0}, {100, 100, 0});
+            Asset vikingRoom = Asset(loadingPool, "Models/vikingRoom.obj", {"Models/vikingRoom.png"}, {"Shaders/vertexShader.vert", "Shaders/fragmentShader.frag"}, {0, 0, 0}, {0, 0, 0}, {5, 5, 5});
+            Asset statue = Asset(loadingPool, "Models/ancientStatue.obj", {"Models/ancientStatue.png"}, {"Shaders/vertexShader.vert", "Shaders/fragmentShader.frag"}, {7, 2, 0}, {0, 0, 0});
+            Asset ball = Asset(loadingPool, "Models/sphere.obj", {"Models/sphere_diffuse.png"}, {"Shaders/vertexShader.vert", "Shaders/fragmentShader.frag"});
+            Asset banner = Asset(loadingPool, "Models/quad.obj", {"Models/quad_Color.png"}, {"Shaders/vertexShader.vert", "Shaders/fragmentShader.frag"});
+            Asset drops = Asset(loadingPool, "Models/cube.obj", {"Models/cube.png"}, {"Shaders/vertexShader.vert", "Shaders/fragmentShader.frag"});
+            Asset sparkCubes = Asset(loadingPool, "Models/cube.obj", {"Models/cube.png"}, {"Shaders/particleShader.vert", "Shaders/fragmentShader.frag"});
+            //the banner is the quad split into 64 by 64 squares, whose vertices are moved by the physics thread
+            banner.wait();
+            banner.subdivide(6);
+            banner.dynamicVertices = true;
+            //the tank holds a column of liquid that collapses across its floor, drawn as a small cube at every particle whose vertices are moved by the physics thread
+            Fluid tank(0.1f);
+            tank.container = {{12, -2, 0}, {16, 2, 4}};
+            tank.fill({{12.05f, -1.95f, 0.05f}, {13.55f, -0.45f, 3.15f}});
+            drops.wait();
+            std::vector<glm::vec3> dropCorners{}, dropNormals{};
+            for (const Vertex &vertex : drops.vertices) {
+                dropCorners.push_back(vertex.pos * 0.03f);
+                dropNormals.push_back(vertex.normal);
+            }
+            drops.repeat(static_cast<uint32_t>(tank.particleCount()));
+            drops.dynamicVertices = true;
+            //sparks rain onto the cube's side of the orbit and bounce off whatever passes through them, drawn as one small cube per living spark with a single instanced call
+            ParticleEmitter sparks(8192);
+            sparks.origin = {10, 0, 4};
+            sparks.velocity = {0, 0, -2};
+            sparks.spread = {1.5f, 1.5f, 1};
+            sparks.rate = 4000;
+            sparks.lifetime = 1.5f;
+            sparks.lifetimeSpread = 0.5f;
+            sparks.collide = true;
+            sparkCubes.instanceCount = static_cast<uint32_t>(sparks.capacity());
+            sparkCubes.drawnInstances = 0;
+            sparkCubes.packedInstances = true;
+            cube.externalTransforms = true;
+            ball.externalTransforms = true;
             renderEngine.uploadAsset(&cube, true);
             renderEngine.uploadAsset(&quad, true);
             renderEngine.uploadAsset(&vikingRoom, true);
             renderEngine.uploadAsset(&statue, true);
             renderEngine.uploadAsset(&ball, true);
+            renderEngine.uploadAsset(&banner, true);
+            renderEngine.uploadAsset(&drops, true);
+            renderEngine.uploadAsset(&sparkCubes, true);
+            //the cube and ball orbit each other at 3 radians per second on a circle of radius 10, simulated at a fixed tick rate on a thread of its own and interpolated to the frame rate
+            //the viking room is level geometry for the spheres to collide with, placed where it is drawn
+            vikingRoom.wait();
+            MeshCollider roomCollider(&vikingRoom.vertices[0].pos, sizeof(Vertex), vikingRoom.vertices.size(), vikingRoom.indices.data(), vikingRoom.indices.size(), glm::scale(glm::mat4(1.0f), vikingRoom.scale));
+            //the cube collides as the hull of its own vertices
+            cube.wait();
+            ConvexCollider cubeCollider = ConvexCollider::hull(&cube.vertices[0].pos, sizeof(Vertex), cube.vertices.size(), cube.scale);
+            //the floor's displacement map is terrain just under it, for spheres to roll over and rays to hit. The map only uses the bottom fortieth of its range, so the full range is stretched over 40 meters to give about one meter of relief.
+            int terrainWidth{}, terrainHeight{}, terrainChannels{};
+            stbi_us *terrainSamples = stbi_load_16("Models/quad_Displacement.png", &terrainWidth, &terrainHeight, &terrainChannels, 1);
+            if (terrainSamples == nullptr) { throw std::runtime_error("failed to load terrain heights!"); }
+            HeightfieldCollider terrain(terrainSamples, (uint32_t)terrainWidth, (uint32_t)terrainHeight, {-100, -100, -3}, {200, 200, 40});
+            stbi_image_free(terrainSamples);
+            //the banner hangs from its top edge, four meters across and to one side of the orbit
+            Cloth bannerCloth(&banner.vertices[0].pos, sizeof(Vertex), banner.vertices.size(), banner.indices.data(), banner.indices.size(), 1.0f, glm::scale(glm::translate(glm::mat4(1.0f), {0, -14, 4}), {2, 2, 2}));
+            for (uint32_t i = 0; i < bannerCloth.particleCount(); ++i) { if (bannerCloth.position(i).z >= 5.99f) { bannerCloth.pin(i); } }
+            World world{};
+            world.addMesh(&roomCollider);
+            world.addHeightfield(&terrain);
+            world.addCloth(&bannerCloth);
+            world.addFluid(&tank);
+            world.addEmitter(&sparks);
+            ConvexBody cubeBody = ConvexBody(10, 0, 1, 1, &cubeCollider);
+            SphereBody ballBody = SphereBody(-10, 0, 1, 1, 1);
+            cubeBody.setVelocity({0, 30, 0});
+            ballBody.setVelocity({0, -30, 0});
+            world.addBody(&cubeBody);
+            world.addBody(&ballBody);
+            //the cube and ball are pulled towards the middle by a Fortran kernel run over every body at once when there is a Fortran compiler, and through their views otherwise
+#ifdef CRYSTAL_ENGINE_FORTRAN
+            FortranScriptCaller::addStage(world, World::TickStage::beforeCollisions, crystal_spring_field, {0, 0, 0, 9, 9, 0});
+#else
+            world.preTick = [&](World &, float dt) {
+                for (RigidBody *body : {&cubeBody, &ballBody}) {
+                    glm::vec3 pos = body->getPosition();
+                    body->setVelocity(body->getVelocity() - 9.0f * glm::vec3(pos.x, pos.y, 0) * dt);
+                }
+            };
+#endif
+            //the render loop below only ever reads what the physics thread publishes, so neither waits on the other
+            world.publishState = true;
+            std::jthread physicsThread([&](const std::stop_token &stop) {
+                auto lastUpdate = std::chrono::steady_clock::now();
+                while (!stop.stop_requested()) {
+                    auto now = std::chrono::steady_clock::now();
+                    world.update(std::chrono::duration<double>(now - lastUpdate).count());
+                    lastUpdate = now;
+                    std::this_thread::sleep_for(std::chrono::duration<double>(0.5 / world.tickRate));
+                }
+            });
             double lastTab{0};
             double lastF2{0};
             double lastEsc{0};
@@ -71,7 +164,7 @@ int main(int argc, char **argv) {
                 glfwPollEvents();
                 float velocity = renderEngine.frameTime * renderEngine.settings.movementSpeed;
                 if ((bool)glfwGetKey(renderEngine.window, GLFW_KEY_F1)) {
-                    for (Asset *asset : renderEngine.assets) { asset->reloadAsset(); }
+                    for (Asset *asset : renderEngine.assets) { renderEngine.reloadAsset(asset); }
                     renderEngine.updateSettings(false);
                 } if ((bool)glfwGetKey(renderEngine.window, GLFW_KEY_F2) & (glfwGetTime() - lastF2 > .2)) {
                     renderEngine.settings.fullscreen = !renderEngine.settings.fullscreen;
@@ -124,8 +217,24 @@ int main(int argc, char **argv) {
                     lastEsc = glfwGetTime();
                 }
                 //move assets
-                cube.position = {10 * cos(3 * glfwGetTime()), 10 * sin(3 * glfwGetTime()), 1};
-                ball.position = {10 * -cos(3 * glfwGetTime()), 10 * -sin(3 * glfwGetTime()), 1};
+                const PublishedBodies &bodies = world.published.acquire();
+                if (bodies.size() != 0) {
+                    glm::mat4 *transforms = renderEngine.instanceTransforms();
+                    bodies.writeTransforms(cubeBody.getIndex(), 1, transforms + cube.instanceIndex);
+                    bodies.writeTransforms(ballBody.getIndex(), 1, transforms + ball.instanceIndex);
+                }
+                const PublishedCloth &bannerShape = bannerCloth.published.acquire();
+                if (bannerShape.size() != 0) {
+                    Vertex *vertices = renderEngine.dynamicVertices(&banner);
+                    bannerShape.writeVertices(&vertices[0].pos, &vertices[0].normal, sizeof(Vertex));
+                }
+                const PublishedFluid &tankShape = tank.published.acquire();
+                if (tankShape.size() != 0) {
+                    Vertex *vertices = renderEngine.dynamicVertices(&drops);
+                    tankShape.writeVertices(&vertices[0].pos, &vertices[0].normal, sizeof(Vertex), dropCorners.data(), dropNormals.data(), dropCorners.size());
+                }
+                const PublishedParticles &sparkState = sparks.published.acquire();
+                sparkCubes.drawnInstances = static_cast<uint32_t>(sparkState.writeInstances(renderEngine.packedInstances(&sparkCubes), sparkCubes.instanceCount));
                 statue.position = {5, 5 * std::max(std::min(sin(3 * glfwGetTime()), -2.5), 2.5), 0};
                 //update framerate gathered over past 'recordedFPSCount' frames
                 recordedFPS[(size_t)std::fmod((float)renderEngine.frameNumber, recordedFPSCount)] = 1 / renderEngine.frameTime;
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdio>
+
+//the number of checks that failed, which every test executable returns from main so that ctest sees them
+inline int failedChecks{};
+
+//report a failed condition with where it is, and carry on so that one run shows every failure
+#define CHECK(condition) do { if (!(condition)) { std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); ++failedChecks; } } while (false)
@@ -0,0 +1,92 @@
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/GraphicsEngine/Vulkan/objParser.hpp"
+#include "check.hpp"
+
+//checks that the chunked OBJ parser reads files exactly as tinyobjloader, the loader it replaced, did, serially and across a thread pool
+//usage: ObjParserTests [folder of models to compare too]
+
+//whether the parser gives the same positions, texture coordinates, normals, and triangulated corners as tinyobjloader, bit for bit
+bool matchesTinyObj(const std::filesystem::path &fileName, ThreadPool *threadPool) {
+    tinyobj::attrib_t attributes;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warning, error;
+    if (!tinyobj::LoadObj(&attributes, &shapes, &materials, &warning, &error, fileName.string().c_str())) { return false; }
+    ObjParser parser;
+    parser.parse(fileName.string().c_str(), threadPool);
+    if (attributes.vertices != parser.positions || attributes.texcoords != parser.texCoords || attributes.normals != parser.normals) { return false; }
+    size_t corner = 0;
+    for (const tinyobj::shape_t &shape : shapes) {
+        for (const tinyobj::index_t &index : shape.mesh.indices) {
+            if (corner == parser.corners.size()) { return false; }
+            const ObjParser::Corner &parsed = parser.corners[corner++];
+            if (parsed.position != index.vertex_index || parsed.texCoord != index.texcoord_index || parsed.normal != index.normal_index) { return false; }
+        }
+    }
+    return corner == parser.corners.size();
+}
+
+void write(const std::filesystem::path &fileName, const std::string &text) {
+    std::ofstream(fileName, std::ios::binary) << text;
+}
+
+//a grid of quads with every kind of face and number the parser has to get right, large enough to be split into many chunks
+std::string gridModel(int side) {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> height(-1.0f, 1.0f);
+    std::string text = "# generated grid\r\ng grid\r\nusemtl none\r\n";
+    for (int y = 0; y <= side; ++y) {
+        for (int x = 0; x <= side; ++x) {
+            text += "v " + std::to_string(x) + " " + std::to_string(y) + " " + std::to_string(height(rng)) + "e-1\r\n";
+            text += "vt " + std::to_string((float)x / (float)side) + " " + std::to_string((float)y / (float)side) + "\r\n";
+            text += "vn 0 0 1\r\n";
+        }
+    }
+    for (int y = 0; y < side; ++y) {
+        for (int x = 0; x < side; ++x) {
+            int a = y * (side + 1) + x + 1, b = a + 1, c = a + side + 2, d = a + side + 1;
+            if ((x + y) % 3 == 0) { text += "f " + std::to_string(a) + "/" + std::to_string(a) + "/" + std::to_string(a) + " " + std::to_string(b) + "/" + std::to_string(b) + "/" + std::to_string(b) + " " + std::to_string(c) + "/" + std::to_string(c) + "/" + std::to_string(c) + " " + std::to_string(d) + "/" + std::to_string(d) + "/" + std::to_string(d) + "\r\n"; }
+            else if ((x + y) % 3 == 1) { text += "f " + std::to_string(a) + "//" + std::to_string(a) + " " + std::to_string(b) + "//" + std::to_string(b) + " " + std::to_string(c) + "//" + std::to_string(c) + "\n"; }
+            else { text += "f " + std::to_string(a) + " " + std::to_string(c) + " " + std::to_string(d) + "\n"; }
+        }
+    }
+    return text;
+}
+
+int main(int argc, char **argv) {
+    ThreadPool threadPool(3);
+    std::filesystem::path folder = std::filesystem::temp_directory_path() / "CrystalEngineObjParserTests";
+    std::filesystem::create_directories(folder);
+    std::vector<std::filesystem::path> models{folder / "edgeCases.obj", folder / "grid.obj"};
+    write(models[0], "# comment\nv 1 0 0\n  v\t0 1 0  \nv -1.5e+0 -.5 +0.25E1 0.2 0.3 0.4\nv 1.234567891234 1e-3 -7.\nvt 0.5 0.25 0.0\nvt .1 1e2\nvn 0 0 1\nvn 1 0 0\n"
+                     "v 0 0 0\nv 3 0 0\nv 3 3 0\nv 1.5 1 0\nv 0 3 0\nf 1 2 3\nf -1/-1/-1 -2/-2/-2 -3/-1/-2\nf 1//1 2//2 4//1\nf 1/1 2/2 3/1 4/2\nf 5 6 7 8 9\n"
+                     "g group\nusemtl whatever\nf 9/1/1 8/2/2 7/1/1 6/2/2 5/1/1\nv 5 5 5\nf 10 -1 1\t\nf 2 3 4 5 6 7 8 9 10");
+    write(models[1], gridModel(300));
+    if (argc > 1 && std::filesystem::is_directory(argv[1])) {
+        for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(argv[1])) {
+            if (entry.path().extension() == ".obj") { models.push_back(entry.path()); }
+        }
+    }
+    for (const std::filesystem::path &model : models) {
+        CHECK(matchesTinyObj(model, nullptr));
+        CHECK(matchesTinyObj(model, &threadPool));
+    }
+    //a face pointing past the last vertex is an error rather than a read out of bounds
+    write(folder / "missingVertex.obj", "v 0 0 0\nf 1 1 7\n");
+    bool threw = false;
+    try {
+        ObjParser parser;
+        parser.parse((folder / "missingVertex.obj").string().c_str());
+    } catch (const std::runtime_error &) { threw = true; }
+    CHECK(threw);
+    std::filesystem::remove_all(folder);
+    return failedChecks == 0 ? 0 : 1;
+}
@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "../src/PhysicsEngine/physics.hpp"
+#include "check.hpp"
+
+//checks the physics engine's guarantees that the rest of the engine leans on: steps that do not depend on threading, and snapshots that round trip and are rejected when damaged
+
+//a world and the bodies it views. The bodies must not move in memory once added, so they are reserved up front.
+struct TestScene {
+    World world;
+    std::vector<SphereBody> spheres;
+};
+
+//spheres dropped in a heap onto a static sphere large enough to be nearly flat, so that there are contacts, cached impulses, and bodies falling asleep
+std::unique_ptr<TestScene> buildPile(size_t count) {
+    auto scene = std::make_unique<TestScene>();
+    scene->spheres.reserve(count + 1);
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> across(0.0f, 4.0f), up(0.5f, 4.5f);
+    for (size_t i = 0; i < count; ++i) { scene->spheres.emplace_back(across(rng), across(rng), up(rng), 1.0f, 0.5f); }
+    scene->spheres.emplace_back(0.0f, 0.0f, -10000.0f, 0.0f, 10000.0f);
+    scene->world.gravity = {0.0f, 0.0f, -9.81f};
+    for (SphereBody &sphere : scene->spheres) { scene->world.addBody(&sphere); }
+    return scene;
+}
+
+//where the body store's part of a snapshot starts, found by writing the store on its own
+size_t storeOffset(World &world, const WorldSnapshot &snapshot) {
+    std::vector<uint8_t> bytes(world.store.serializedSize());
+    world.store.write(bytes.data());
+    return (size_t)(std::search(snapshot.data.begin(), snapshot.data.end(), bytes.begin(), bytes.end()) - snapshot.data.begin());
+}
+
+//stepping on a thread pool, split into far more tasks than usual, gives the same bits as stepping without one
+void testParallelStep() {
+    std::unique_ptr<TestScene> serial = buildPile(500);
+    WorldSnapshot expected, result;
+    for (int i = 0; i < 60; ++i) { serial->world.step(); }
+    serial->world.saveSnapshot(expected);
+    for (unsigned threads : {1u, 3u}) {
+        std::unique_ptr<TestScene> parallel = buildPile(500);
+        ThreadPool pool(threads);
+        parallel->world.threadPool = &pool;
+        parallel->world.bodiesPerTask = 64;
+        parallel->world.pairsPerTask = 16;
+        for (int i = 0; i < 60; ++i) { parallel->world.step(); }
+        parallel->world.saveSnapshot(result);
+        CHECK(result.data == expected.data);
+    }
+}
+
+//stepping on from a restored snapshot repeats the ticks that followed it bit for bit
+void testSnapshotRoundTrip() {
+    std::unique_ptr<TestScene> scene = buildPile(200);
+    World &world = scene->world;
+    for (int i = 0; i < 30; ++i) { world.step(); }
+    WorldSnapshot start, first, second;
+    world.saveSnapshot(start);
+    for (int i = 0; i < 30; ++i) { world.step(); }
+    world.saveSnapshot(first);
+    CHECK(world.restoreSnapshot(start));
+    for (int i = 0; i < 30; ++i) { world.step(); }
+    world.saveSnapshot(second);
+    CHECK(first.data == second.data);
+}
+
+//a snapshot cut short or padded out is rejected without touching the world
+void testTruncatedSnapshots() {
+    std::unique_ptr<TestScene> scene = buildPile(50);
+    World &world = scene->world;
+    for (int i = 0; i < 10; ++i) { world.step(); }
+    WorldSnapshot good, before, after;
+    world.saveSnapshot(good);
+    world.step();
+    world.saveSnapshot(before);
+    for (size_t size = 0; size < good.data.size(); ++size) {
+        WorldSnapshot cut = good;
+        cut.data.resize(size);
+        CHECK(!world.restoreSnapshot(cut));
+    }
+    WorldSnapshot padded = good;
+    padded.data.push_back(0);
+    CHECK(!world.restoreSnapshot(padded));
+    world.saveSnapshot(after);
+    CHECK(before.data == after.data);
+}
+
+//sleep rings that wake or remove would walk forever, or that mix sleeping and awake bodies, are rejected, and waking a body afterwards returns
+void testMalformedSleepRings() {
+    std::unique_ptr<TestScene> scene = buildPile(4);
+    World &world = scene->world;
+    WorldSnapshot good, after;
+    world.saveSnapshot(good);
+    size_t bodies = world.store.size(), offset = storeOffset(world, good);
+    CHECK(offset < good.data.size());
+    size_t floatBytes = (world.store.serializedSize() - sizeof(uint32_t)) / bodies - sizeof(uint8_t) - sizeof(uint32_t);
+    size_t flags = offset + sizeof(uint32_t) + bodies * floatBytes, rings = flags + bodies;
+    auto damaged = [&](std::vector<uint8_t> asleep, std::vector<uint32_t> next) {
+        WorldSnapshot snapshot = good;
+        std::memcpy(snapshot.data.data() + flags, asleep.data(), bodies);
+        std::memcpy(snapshot.data.data() + rings, next.data(), bodies * sizeof(uint32_t));
+        return snapshot;
+    };
+    //a sleeping body whose ring runs into an awake body that points at itself
+    CHECK(!world.restoreSnapshot(damaged({1, 0, 0, 0, 0}, {1, 1, 2, 3, 4})));
+    //a ring that loops back into itself without reaching where it started
+    CHECK(!world.restoreSnapshot(damaged({1, 1, 1, 0, 0}, {1, 2, 1, 3, 4})));
+    //an awake body pointing at another
+    CHECK(!world.restoreSnapshot(damaged({0, 0, 0, 0, 0}, {1, 0, 2, 3, 4})));
+    //an asleep flag that is neither set nor clear
+    CHECK(!world.restoreSnapshot(damaged({2, 0, 0, 0, 0}, {0, 1, 2, 3, 4})));
+    //two sleeping rings are fine
+    CHECK(world.restoreSnapshot(damaged({1, 1, 1, 1, 0}, {1, 0, 3, 2, 4})));
+    scene->spheres[0].setPosition({0.0f, 0.0f, 5.0f});
+    CHECK(!scene->spheres[1].isAsleep() && scene->spheres[2].isAsleep());
+    CHECK(world.restoreSnapshot(good));
+    world.saveSnapshot(after);
+    CHECK(good.data == after.data);
+}
+
+int main() {
+    testParallelStep();
+    testSnapshotRoundTrip();
+    testTruncatedSnapshots();
+    testMalformedSleepRings();
+    return failedChecks == 0 ? 0 : 1;
+}
@@ -0,0 +1,51 @@
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include "../src/Core/threadPool.hpp"
+#include "check.hpp"
+
+//checks that the thread pool runs every item exactly once, including from nested tasks, and hands exceptions back to the caller
+
+//every item of a parallelFor is run once, also when each chunk runs a parallelFor of its own from a worker
+void testParallelFor(ThreadPool &pool) {
+    std::vector<std::atomic<int>> runs(10000);
+    pool.parallelFor(100, 1, [&](size_t begin, size_t end) {
+        for (size_t outer = begin; outer < end; ++outer) {
+            pool.parallelFor(100, 7, [&](size_t innerBegin, size_t innerEnd) {
+                for (size_t inner = innerBegin; inner < innerEnd; ++inner) { ++runs[outer * 100 + inner]; }
+            });
+        }
+    });
+    bool once = true;
+    for (const std::atomic<int> &count : runs) { once &= count == 1; }
+    CHECK(once);
+}
+
+//a chunk that throws is rethrown once every chunk has finished, and the pool keeps working
+void testExceptions(ThreadPool &pool) {
+    int caught = 0;
+    for (int i = 0; i < 100; ++i) {
+        try {
+            pool.parallelFor(1000, 10, [](size_t begin, size_t) { if (begin == 20 || begin == 500) { throw std::runtime_error("chunk failed"); } });
+        } catch (const std::runtime_error &) { ++caught; }
+    }
+    CHECK(caught == (pool.concurrency() > 1 ? 100 : 0));
+    std::future<int> failed = pool.submit([]() -> int { throw std::logic_error("task failed"); });
+    pool.wait(failed);
+    bool thrown = false;
+    try { failed.get(); } catch (const std::logic_error &) { thrown = true; }
+    CHECK(thrown);
+    std::atomic<size_t> items{};
+    pool.parallelFor(1000, 10, [&](size_t begin, size_t end) { items += end - begin; });
+    CHECK(items == 1000);
+}
+
+int main() {
+    for (unsigned threads : {0u, 1u, 3u}) {
+        ThreadPool pool(threads);
+        testParallelFor(pool);
+        testExceptions(pool);
+    }
+    return failedChecks == 0 ? 0 : 1;
+}